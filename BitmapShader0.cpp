@@ -62,6 +62,11 @@ public:
     }
 }
 
+  // Copies share the bitmap's pixels, which are only read.
+  std::unique_ptr<GShader> clone() const {
+      return std::unique_ptr<GShader>(new BitmapShader(*this));
+  }
+
 private:
     GBitmap fBitmap;
     GMatrix fInverse;
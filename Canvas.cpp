@@ -0,0 +1,91 @@
+#include "GCanvas.h"
+#include "GColor.h"
+#include "GPaint.h"
+#include "GPath.h"
+#include "GPoint.h"
+#include "GRect.h"
+#include "rrect.h"
+
+/*
+ *  Default batched draws: one single-item call per item.
+ */
+
+void GCanvas::drawRects(const GRect rects[], int count, const GPaint& paint,
+                        const GColor colors[]) {
+    GPaint itemPaint(paint);
+    for (int i = 0; i < count; ++i) {
+        if (colors) {
+            itemPaint.setColor(colors[i]);
+        }
+        this->drawRect(rects[i], itemPaint);
+    }
+}
+
+void GCanvas::drawConvexPolygons(const GPoint pts[], const int counts[], int polyCount,
+                                 const GPaint& paint, const GColor colors[]) {
+    GPaint itemPaint(paint);
+    for (int i = 0; i < polyCount; ++i) {
+        if (colors) {
+            itemPaint.setColor(colors[i]);
+        }
+        const int count = std::max(counts[i], 0);
+        this->drawConvexPolygon(pts, count, itemPaint);
+        pts += count;
+    }
+}
+
+void GCanvas::drawPoints(const GPoint pts[], int count, float size, const GPaint& paint,
+                         const GColor colors[]) {
+    const float half = size * 0.5f;
+    GPaint itemPaint(paint);
+    for (int i = 0; i < count; ++i) {
+        if (colors) {
+            itemPaint.setColor(colors[i]);
+        }
+        this->drawRect(GRect::MakeLTRB(pts[i].x() - half, pts[i].y() - half,
+                                       pts[i].x() + half, pts[i].y() + half), itemPaint);
+    }
+}
+
+/*
+ *  Each corner is a cubic: k is how far along the tangent its control points sit, per unit of
+ *  radius, for the closest fit to a quarter ellipse.
+ */
+void GCanvas::drawRoundRect(const GRect& rect, float rx, float ry, const GPaint& paint) {
+    const GRect r = pinRoundRect(rect, &rx, &ry);
+    if (rx == 0 || ry == 0) {
+        this->drawRect(r, paint);
+        return;
+    }
+    const float k = 0.5522848f;
+    const float L = r.left(), T = r.top(), R = r.right(), B = r.bottom();
+    const float kx = rx * (1 - k), ky = ry * (1 - k);
+    GPath path;
+    path.moveTo(L + rx, T).lineTo(R - rx, T)
+        .cubicTo(R - kx, T, R, T + ky, R, T + ry).lineTo(R, B - ry)
+        .cubicTo(R, B - ky, R - kx, B, R - rx, B).lineTo(L + rx, B)
+        .cubicTo(L + kx, B, L, B - ky, L, B - ry).lineTo(L, T + ry)
+        .cubicTo(L, T + ky, L + kx, T, L + rx, T);
+    this->drawPath(path, paint);
+}
+
+void GCanvas::drawLine(GPoint p0, GPoint p1, float width, const GPaint& paint) {
+    GVector norm = { p1.y() - p0.y(), p0.x() - p1.x() };
+    const float length = norm.length();
+    if (!(length > 0)) {
+        return;
+    }
+    // Hairlines (width 0) fill 1 wide; every other width, however thin, is kept.
+    const float scale = (width > 0 ? width : 1) / 2 / length;
+    norm.fX *= scale;
+    norm.fY *= scale;
+
+    GPoint quad[4] = { p0 + norm, p1 + norm, p1 - norm, p0 - norm };
+    this->drawConvexPolygon(quad, 4, paint);
+}
+
+void GCanvas::drawPolyline(const GPoint pts[], int count, float width, const GPaint& paint) {
+    for (int i = 0; i + 1 < count; ++i) {
+        this->drawLine(pts[i], pts[i + 1], width, paint);
+    }
+}
@@ -58,7 +58,8 @@ public:
            }
 
            float trueIndex = t * (fCount - 1);
-           int index = floor(trueIndex);
+           //t == 1 blends the last two colors all the way, rather than reading past the end
+           int index = std::min((int)floor(trueIndex), fCount - 2);
            float c2Ratio = trueIndex - index;
 
            GColor c1 = fColors[index];
@@ -74,6 +75,11 @@ public:
      return;
    }
 
+   // Copies share the color table, which never changes after construction.
+   virtual std::unique_ptr<GShader> clone() const {
+       return std::unique_ptr<GShader>(new LinearGradientShader(*this));
+   }
+
 private:
   GColor* fColors;
   int fCount;
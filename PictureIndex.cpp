@@ -0,0 +1,325 @@
+#include "GPictureIndex.h"
+#include "GCanvas.h"
+#include "GFilter.h"
+#include "GPath.h"
+#include "GShader.h"
+#include "GTrace.h"
+#include "pictureUtils.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+GPictureIndex::GPictureIndex(const GPicture& picture, GISize deviceSize, int cellSize)
+    : fPicture(picture), fDeviceSize(deviceSize), fCellSize(std::max(cellSize, 1)) {
+    // A draw covering more cells than this goes in fLargeOps instead.
+    const int kMaxCellsPerOp = 64;
+
+    const int count = picture.countOps();
+    const GIRect device = GIRect::MakeWH(deviceSize.fWidth, deviceSize.fHeight);
+    fCellsX = (deviceSize.fWidth + fCellSize - 1) / fCellSize;
+    fCellsY = (deviceSize.fHeight + fCellSize - 1) / fCellSize;
+
+    fTouched.assign(count, GIRect::MakeWH(0, 0));
+    fParent.assign(count, -1);
+    fPrevConcat.assign(count, -1);
+    fMatch.assign(count, -1);
+
+    struct Level {
+        int     fSave;          // -1 for the root
+        bool    fInLayer;
+        int     fLastConcat;    // or clip
+        GMatrix fCTM;
+        GIRect  fClip;
+    };
+    std::vector<Level> levels(1, Level{ -1, false, -1, GMatrix(), device });
+    for (int i = 0; i < count; ++i) {
+        const GPicture::Op& op = picture.op(i);
+        Level& level = levels.back();
+        fParent[i] = level.fSave;
+        fPrevConcat[i] = level.fLastConcat;
+
+        switch (op.verb()) {
+            case GPicture::kSave:
+            case GPicture::kSaveLayer: {
+                const bool isLayer = op.verb() == GPicture::kSaveLayer;
+                if (isLayer && !empty_layer_is_noop(picture.paint(op))) {
+                    fForcedLayers.push_back(i);
+                }
+                levels.push_back(Level{ i, level.fInLayer || isLayer, -1, level.fCTM,
+                                        level.fClip });
+            } break;
+            case GPicture::kRestore:
+                if (levels.size() > 1) {
+                    fMatch[i] = level.fSave;
+                    fMatch[level.fSave] = i;
+                    levels.pop_back();
+                }
+                break;
+            case GPicture::kConcat:
+                level.fCTM.preConcat(op.matrix());
+                level.fLastConcat = i;
+                break;
+            case GPicture::kClipRect:
+            case GPicture::kClipPath:
+                if (!level.fClip.intersect(GPicture::ClipPixels(op, level.fCTM, device,
+                                                                nullptr))) {
+                    level.fClip = GIRect::MakeWH(0, 0);
+                }
+                level.fLastConcat = i;
+                break;
+            default:
+                // Filters work pixel by pixel, so even inside a layer a draw can only change the
+                // device where it was clipped to.
+                if (level.fInLayer) {
+                    fTouched[i] = device;
+                } else {
+                    fTouched[i] = GPicture::TouchedPixels(op, level.fCTM, device);
+                }
+                if (!fTouched[i].intersect(level.fClip)) {
+                    fTouched[i] = GIRect::MakeWH(0, 0);
+                }
+                break;
+        }
+    }
+
+    // Bucket the remaining draws into cells, in two passes: count, then fill.
+    auto cell_range = [this](const GIRect& r, int* l, int* t, int* rt, int* b) {
+        *l = r.left() / fCellSize;
+        *t = r.top() / fCellSize;
+        *rt = (r.right() - 1) / fCellSize;
+        *b = (r.bottom() - 1) / fCellSize;
+    };
+    std::vector<int> cellCounts(fCellsX * fCellsY + 1, 0);
+    std::vector<bool> large(count, false);
+    for (int i = 0; i < count; ++i) {
+        if (fTouched[i].isEmpty()) {
+            continue;
+        }
+        int l, t, r, b;
+        cell_range(fTouched[i], &l, &t, &r, &b);
+        if ((r - l + 1) * (b - t + 1) > kMaxCellsPerOp) {
+            large[i] = true;
+            fLargeOps.push_back(i);
+            continue;
+        }
+        for (int y = t; y <= b; ++y) {
+            for (int x = l; x <= r; ++x) {
+                cellCounts[y * fCellsX + x] += 1;
+            }
+        }
+    }
+
+    fCellStart.assign(fCellsX * fCellsY + 1, 0);
+    for (int c = 0; c < fCellsX * fCellsY; ++c) {
+        fCellStart[c + 1] = fCellStart[c] + cellCounts[c];
+    }
+    fCellOps.resize(fCellStart.back());
+    std::vector<int> fill(fCellStart.begin(), fCellStart.end() - 1);
+    for (int i = 0; i < count; ++i) {
+        if (fTouched[i].isEmpty() || large[i]) {
+            continue;
+        }
+        int l, t, r, b;
+        cell_range(fTouched[i], &l, &t, &r, &b);
+        for (int y = t; y <= b; ++y) {
+            for (int x = l; x <= r; ++x) {
+                fCellOps[fill[y * fCellsX + x]++] = i;
+            }
+        }
+    }
+}
+
+void GPictureIndex::query(const GIRect& area, std::vector<int>* drawOps) const {
+    drawOps->clear();
+    GIRect r = area;
+    if (!r.intersect(GIRect::MakeWH(fDeviceSize.fWidth, fDeviceSize.fHeight))) {
+        return;
+    }
+
+    const int l = r.left() / fCellSize;
+    const int t = r.top() / fCellSize;
+    const int rt = (r.right() - 1) / fCellSize;
+    const int b = (r.bottom() - 1) / fCellSize;
+    for (int y = t; y <= b; ++y) {
+        for (int x = l; x <= rt; ++x) {
+            const int c = y * fCellsX + x;
+            for (int k = fCellStart[c]; k < fCellStart[c + 1]; ++k) {
+                if (fTouched[fCellOps[k]].intersects(r)) {
+                    drawOps->push_back(fCellOps[k]);
+                }
+            }
+        }
+    }
+    for (int i : fLargeOps) {
+        if (fTouched[i].intersects(r)) {
+            drawOps->push_back(i);
+        }
+    }
+
+    // An op spanning several of the cells was found once per cell.
+    std::sort(drawOps->begin(), drawOps->end());
+    drawOps->erase(std::unique(drawOps->begin(), drawOps->end()), drawOps->end());
+}
+
+void GPictureIndex::resolve(const std::vector<int>& drawOps, std::vector<int>* ops) const {
+    ops->clear();
+
+    std::vector<int> roots;
+    std::merge(drawOps.begin(), drawOps.end(), fForcedLayers.begin(), fForcedLayers.end(),
+               std::back_inserter(roots));
+
+    // For each level (keyed by its save, -1 for the root), the latest op in it whose earlier
+    // concats have already been added. Roots are visited in order, so a later root only has to
+    // add the concats between that op and itself, and can stop climbing at a level already seen.
+    std::unordered_map<int, int> covered;
+
+    for (int root : roots) {
+        ops->push_back(root);
+        if (fPicture.op(root).verb() == GPicture::kSaveLayer && fMatch[root] >= 0) {
+            ops->push_back(fMatch[root]);
+        }
+        for (int node = root; ; ) {
+            const int level = fParent[node];
+            auto found = covered.find(level);
+            const bool seen = found != covered.end();
+            const int bound = seen ? found->second : -1;
+
+            for (int c = fPrevConcat[node]; c > bound; c = fPrevConcat[c]) {
+                ops->push_back(c);
+            }
+            covered[level] = std::max(bound, node);
+            if (seen || level < 0) {
+                break;
+            }
+            ops->push_back(level);
+            if (fMatch[level] >= 0) {
+                ops->push_back(fMatch[level]);
+            }
+            node = level;
+        }
+    }
+
+    std::sort(ops->begin(), ops->end());
+    ops->erase(std::unique(ops->begin(), ops->end()), ops->end());
+}
+
+void GPictureIndex::playback(GCanvas* canvas, const std::vector<int>& drawOps,
+                             const GPicture::ShaderMap* shaders) const {
+    std::vector<int> ops;
+    this->resolve(drawOps, &ops);
+
+    // resolve() only adds restores that match an added save, so the ops are balanced except
+    // for saves the picture itself never restored.
+    GPath scratch;
+    int depth = 0;
+    for (int i : ops) {
+        switch (fPicture.op(i).verb()) {
+            case GPicture::kSave:
+            case GPicture::kSaveLayer:
+                depth += 1;
+                break;
+            case GPicture::kRestore:
+                depth -= 1;
+                break;
+            default:
+                break;
+        }
+        fPicture.playbackOp(canvas, i, &scratch, shaders);
+    }
+    while (depth-- > 0) {
+        canvas->restore();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ *  Map every shader the picture uses to a new clone, kept alive by owned. Returns false if any
+ *  shader can't be cloned.
+ */
+static bool clone_shaders(const GPicture& picture, GPicture::ShaderMap* shaders,
+                          std::vector<std::unique_ptr<GShader>>* owned) {
+    for (int i = 0; i < picture.countOps(); ++i) {
+        const GPicture::Op& op = picture.op(i);
+        GShader* shader = op.fPaint >= 0 ? picture.paint(op).getShader() : nullptr;
+        if (!shader || shaders->count(shader)) {
+            continue;
+        }
+        std::unique_ptr<GShader> clone = shader->clone();
+        if (!clone) {
+            return false;
+        }
+        (*shaders)[shader] = clone.get();
+        owned->push_back(std::move(clone));
+    }
+    return true;
+}
+
+void GPlaybackTiled(const GPictureIndex& index, const GBitmap& device, int tileSize,
+                    int threadCount) {
+    if (device.width() != index.deviceSize().fWidth ||
+        device.height() != index.deviceSize().fHeight || !device.pixels()) {
+        GASSERT(false);
+        return;
+    }
+    tileSize = std::max(tileSize, 1);
+    const int tilesX = (device.width() + tileSize - 1) / tileSize;
+    const int tilesY = (device.height() + tileSize - 1) / tileSize;
+    const int tileCount = tilesX * tilesY;
+
+    if (threadCount <= 0) {
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    threadCount = std::min(threadCount, tileCount);
+
+    // The calling thread draws with the recorded shaders, every other thread with its own clones.
+    std::vector<GPicture::ShaderMap> shaders(threadCount);
+    std::vector<std::unique_ptr<GShader>> owned;
+    for (int i = 1; i < threadCount; ++i) {
+        if (!clone_shaders(index.picture(), &shaders[i], &owned)) {
+            threadCount = 1;
+            break;
+        }
+    }
+
+    // Threads take the next undrawn tile until there are none left.
+    std::atomic<int> nextTile(0);
+    auto drawTiles = [&](const GPicture::ShaderMap* clones) {
+        std::vector<int> ops;
+        for (int t = nextTile++; t < tileCount; t = nextTile++) {
+            G_TRACE_EVENT("playback", "tile");
+            const int x = (t % tilesX) * tileSize;
+            const int y = (t / tilesX) * tileSize;
+            const GIRect tile = GIRect::MakeLTRB(x, y, std::min(x + tileSize, device.width()),
+                                                 std::min(y + tileSize, device.height()));
+            index.query(tile, &ops);
+            auto canvas = GCreateClippedCanvas(device, tile);
+            index.playback(canvas.get(), ops, clones);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; ++i) {
+        threads.emplace_back(drawTiles, &shaders[i]);
+    }
+    drawTiles(nullptr);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void GPlaybackArea(const GPictureIndex& index, const GBitmap& device, const GIRect& area,
+                   const GColor& background) {
+    if (device.width() != index.deviceSize().fWidth ||
+        device.height() != index.deviceSize().fHeight || !device.pixels()) {
+        GASSERT(false);
+        return;
+    }
+    auto canvas = GCreateClippedCanvas(device, area);
+    canvas->drawPaint(GPaint(background).setBlendMode(GBlendMode::kSrc));
+
+    std::vector<int> ops;
+    index.query(area, &ops);
+    index.playback(canvas.get(), ops);
+}
@@ -0,0 +1,334 @@
+#include "GPicture.h"
+#include "GFilter.h"
+#include "GShader.h"
+#include "pictureUtils.h"
+#include <vector>
+
+typedef GPicture::Op Op;
+
+static bool is_identity(const GMatrix& m) {
+    return m[GMatrix::SX] == 1 && m[GMatrix::KX] == 0 && m[GMatrix::TX] == 0 &&
+           m[GMatrix::KY] == 0 && m[GMatrix::SY] == 1 && m[GMatrix::TY] == 0;
+}
+
+static bool is_axis_aligned(const GMatrix& m) {
+    return m[GMatrix::KX] == 0 && m[GMatrix::KY] == 0;
+}
+
+static bool same_matrix(const Op& a, const Op& b) {
+    return !memcmp(&a + 1, &b + 1, 6 * sizeof(float));
+}
+
+/*
+ *  True if every pixel this paint covers ends up independent of what was there before.
+ */
+static bool paint_replaces_dst(const GPaint& paint) {
+    switch (paint.getBlendMode()) {
+        case GBlendMode::kClear:
+        case GBlendMode::kSrc:
+            return true;
+        case GBlendMode::kSrcOver:
+            if (paint.getFilter()) {
+                return false;
+            }
+            if (paint.getShader()) {
+                return paint.getShader()->isOpaque();
+            }
+            return paint.getColor().fA >= 1;
+        default:
+            return false;
+    }
+}
+
+static int64_t area(const GIRect& r) {
+    return r.isEmpty() ? 0 : (int64_t)r.width() * r.height();
+}
+
+static void add_occluder(std::vector<GIRect>* occluders, const GIRect& cover) {
+    const int kMaxOccluders = 32;
+
+    for (const GIRect& r : *occluders) {
+        if (r.contains(cover)) {
+            return;
+        }
+    }
+    occluders->erase(std::remove_if(occluders->begin(), occluders->end(),
+                                    [&cover](const GIRect& r) { return cover.contains(r); }),
+                     occluders->end());
+    if ((int)occluders->size() == kMaxOccluders) {
+        auto smallest = std::min_element(occluders->begin(), occluders->end(),
+                            [](const GIRect& a, const GIRect& b) { return area(a) < area(b); });
+        if (area(*smallest) >= area(cover)) {
+            return;
+        }
+        occluders->erase(smallest);
+    }
+    occluders->push_back(cover);
+}
+
+std::unique_ptr<GPicture> GOptimizePicture(const GPicture& picture, GISize size,
+                                           GPictureOptimizeStats* stats) {
+    const int count = picture.countOps();
+    const GIRect device = GIRect::MakeWH(size.fWidth, size.fHeight);
+    const GRect deviceBounds = GRect::Make(device);
+
+    GPictureOptimizeStats local;
+    std::vector<bool> keep(count, true);
+
+    // Pass 1: track the CTM, clip and layer of each op, drop identity concats, reject draws that
+    // miss the device or clip, and find the root-layer draws that will overwrite whatever is
+    // under them.
+    std::vector<GRect>  bounds(count);
+    std::vector<GIRect> touched(count, GIRect::MakeWH(0, 0));
+    std::vector<bool>   onRoot(count, false);
+    std::vector<GIRect> covers(count, GIRect::MakeWH(0, 0));
+    {
+        struct Clip {
+            GIRect fBounds;     // every pixel draws may touch is inside
+            bool   fIsRect;     // and all of them are
+        };
+        std::vector<GMatrix> ctmStack(1);
+        std::vector<bool> layerStack(1, false);
+        std::vector<Clip> clipStack(1, Clip{ device, true });
+        for (int i = 0; i < count; ++i) {
+            const Op& op = picture.op(i);
+            switch (op.verb()) {
+                case GPicture::kSave:
+                case GPicture::kSaveLayer:
+                    ctmStack.push_back(ctmStack.back());
+                    layerStack.push_back(layerStack.back() || op.verb() == GPicture::kSaveLayer);
+                    clipStack.push_back(clipStack.back());
+                    break;
+                case GPicture::kRestore:
+                    if (ctmStack.size() > 1) {
+                        ctmStack.pop_back();
+                        layerStack.pop_back();
+                        clipStack.pop_back();
+                    } else {
+                        keep[i] = false;    // unbalanced, playback would ignore it anyway
+                    }
+                    break;
+                case GPicture::kConcat:
+                    if (is_identity(op.matrix())) {
+                        keep[i] = false;
+                    } else {
+                        ctmStack.back().preConcat(op.matrix());
+                    }
+                    break;
+                case GPicture::kClipRect:
+                case GPicture::kClipPath: {
+                    Clip& clip = clipStack.back();
+                    bool isRect;
+                    GIRect r = GPicture::ClipPixels(op, ctmStack.back(), device, &isRect);
+                    if (!clip.fBounds.intersect(r)) {
+                        clip.fBounds = GIRect::MakeWH(0, 0);
+                    }
+                    clip.fIsRect = clip.fIsRect && isRect;
+                } break;
+                default: {
+                    const GMatrix& ctm = ctmStack.back();
+                    const Clip& clip = clipStack.back();
+                    bounds[i] = GPicture::DrawBounds(op, ctm);
+                    touched[i] = GPicture::TouchedPixels(op, ctm, device);
+                    if (!touched[i].intersect(clip.fBounds)) {
+                        touched[i] = GIRect::MakeWH(0, 0);
+                    }
+                    onRoot[i] = !layerStack.back();
+                    if (!bounds[i].intersects(deviceBounds) ||
+                        (onRoot[i] && touched[i].isEmpty())) {
+                        keep[i] = false;
+                        local.fDrawsRejected += 1;
+                        break;
+                    }
+                    if (!onRoot[i] || !clip.fIsRect || !paint_replaces_dst(picture.paint(op))) {
+                        break;
+                    }
+                    if (op.verb() == GPicture::kDrawPaint) {
+                        covers[i] = clip.fBounds;
+                    } else if (op.verb() == GPicture::kDrawRect && is_axis_aligned(ctm)) {
+                        GIRect cover = bounds[i].round();
+                        if (cover.intersect(clip.fBounds)) {
+                            covers[i] = cover;
+                        }
+                    }
+                } break;
+            }
+        }
+    }
+
+    // Pass 2: walking backwards, drop root-layer draws that a later occluder fully covers.
+    {
+        std::vector<GIRect> occluders;
+        for (int i = count - 1; i >= 0; --i) {
+            if (!keep[i] || !onRoot[i] || !picture.op(i).isDraw()) {
+                continue;
+            }
+            for (const GIRect& r : occluders) {
+                if (r.contains(touched[i])) {
+                    keep[i] = false;
+                    local.fDrawsOccluded += 1;
+                    local.fPixelsRemoved += area(touched[i]);
+                    break;
+                }
+            }
+            if (keep[i] && !covers[i].isEmpty()) {
+                add_occluder(&occluders, covers[i]);
+            }
+        }
+    }
+
+    // Pass 3: drop concats and clips no draw sees, save/restore pairs with nothing drawn inside,
+    // and save/restore pairs that never change the CTM or clip. Clips are tracked just like
+    // concats: both are state that the restore undoes.
+    {
+        struct Frame {
+            int              fSave;
+            bool             fLayer;
+            bool             fHasDraw;
+            int              fConcatCount;
+            std::vector<int> fPendingConcats;   // not yet seen by any draw
+        };
+        std::vector<Frame> frames(1, Frame{ -1, false, false, 0, {} });
+
+        auto concats_seen = [&frames]() {   // and clips
+            for (Frame& f : frames) {
+                f.fPendingConcats.clear();
+            }
+        };
+
+        for (int i = 0; i < count; ++i) {
+            if (!keep[i]) {
+                continue;
+            }
+            const Op& op = picture.op(i);
+            switch (op.verb()) {
+                case GPicture::kSave:
+                    frames.push_back(Frame{ i, false, false, 0, {} });
+                    break;
+                case GPicture::kSaveLayer:
+                    concats_seen();     // the layer bounds are mapped by the CTM, and clipped
+                    frames.push_back(Frame{ i, true, false, 0, {} });
+                    break;
+                case GPicture::kConcat:
+                case GPicture::kClipRect:
+                case GPicture::kClipPath:
+                    frames.back().fConcatCount += 1;
+                    frames.back().fPendingConcats.push_back(i);
+                    break;
+                case GPicture::kRestore: {
+                    Frame f = frames.back();
+                    frames.pop_back();
+                    for (int c : f.fPendingConcats) {
+                        keep[c] = false;
+                        f.fConcatCount -= 1;
+                    }
+                    if (!f.fHasDraw && (!f.fLayer || empty_layer_is_noop(picture.paint(
+                                                                    picture.op(f.fSave))))) {
+                        for (int j = f.fSave; j <= i; ++j) {
+                            keep[j] = false;
+                        }
+                        break;
+                    }
+                    if (!f.fLayer && f.fConcatCount == 0) {
+                        keep[f.fSave] = false;
+                        keep[i] = false;
+                    }
+                    frames.back().fHasDraw = true;
+                } break;
+                default:
+                    frames.back().fHasDraw = true;
+                    concats_seen();
+                    break;
+            }
+        }
+    }
+
+    // Pass 4: merge "restore, save" when the new level re-applies exactly the concats that the
+    // level just closed applied up front, e.g. save concat(M) A restore save concat(M) B restore.
+    {
+        std::vector<int> live;
+        for (int i = 0; i < count; ++i) {
+            if (keep[i]) {
+                live.push_back(i);
+            }
+        }
+
+        struct Level {
+            bool             fLayer;
+            bool             fSawContent;
+            bool             fTrailingConcat;
+            bool             fClipped;          // the restore is needed to undo a clip
+            std::vector<int> fLeadConcats;
+        };
+        std::vector<Level> levels(1, Level{ false, false, false, false, {} });
+        Level closed;
+        int closedRestore = -1;
+
+        for (size_t k = 0; k < live.size(); ++k) {
+            const int i = live[k];
+            const Op& op = picture.op(i);
+            const bool justClosed = closedRestore >= 0 && closedRestore == live[k - 1];
+
+            switch (op.verb()) {
+                case GPicture::kSave: {
+                    const size_t n = closed.fLeadConcats.size();
+                    bool merge = justClosed && k + n < live.size();
+                    for (size_t j = 0; merge && j < n; ++j) {
+                        const Op& next = picture.op(live[k + 1 + j]);
+                        merge = next.verb() == GPicture::kConcat &&
+                                same_matrix(next, picture.op(closed.fLeadConcats[j]));
+                    }
+                    if (merge) {
+                        keep[closedRestore] = false;
+                        keep[i] = false;
+                        for (size_t j = 0; j < n; ++j) {
+                            keep[live[k + 1 + j]] = false;
+                        }
+                        levels.push_back(closed);
+                        k += n;
+                        break;
+                    }
+                    levels.back().fSawContent = true;
+                    levels.push_back(Level{ false, false, false, false, {} });
+                } break;
+                case GPicture::kSaveLayer:
+                    levels.back().fSawContent = true;
+                    levels.push_back(Level{ true, false, false, false, {} });
+                    break;
+                case GPicture::kConcat:
+                    if (levels.back().fSawContent) {
+                        levels.back().fTrailingConcat = true;
+                    } else {
+                        levels.back().fLeadConcats.push_back(i);
+                    }
+                    break;
+                case GPicture::kClipRect:
+                case GPicture::kClipPath:
+                    levels.back().fClipped = true;
+                    break;
+                case GPicture::kRestore:
+                    if (levels.size() > 1) {
+                        closed = levels.back();
+                        levels.pop_back();
+                        closedRestore = (closed.fLayer || closed.fTrailingConcat ||
+                                         closed.fClipped) ? -1 : i;
+                    }
+                    break;
+                default:
+                    levels.back().fSawContent = true;
+                    break;
+            }
+        }
+    }
+
+    int kept = 0;
+    for (int i = 0; i < count; ++i) {
+        kept += keep[i];
+    }
+    local.fOpsRemoved = count - kept;
+    local.fStateOpsRemoved = local.fOpsRemoved - local.fDrawsRejected - local.fDrawsOccluded;
+    if (stats) {
+        *stats = local;
+    }
+    return picture.makeSubset(keep);
+}
@@ -0,0 +1,140 @@
+#include "GPicturePlayer.h"
+#include "GCanvas.h"
+#include "GPath.h"
+#include <algorithm>
+
+static void copy_pixels(GPixel* dst, const GBitmap& src) {
+    for (int y = 0; y < src.height(); ++y) {
+        memcpy(dst + y * src.width(), src.getAddr(0, y), src.width() * sizeof(GPixel));
+    }
+}
+
+static void copy_pixels(const GBitmap& dst, const GPixel* src) {
+    for (int y = 0; y < dst.height(); ++y) {
+        memcpy(dst.getAddr(0, y), src + y * dst.width(), dst.width() * sizeof(GPixel));
+    }
+}
+
+GPicturePlayer::GPicturePlayer(const GPicture* picture, int interval, size_t budgetBytes)
+    : fPicture(picture), fInterval(std::max(interval, 1)), fBudget(budgetBytes) {}
+
+void GPicturePlayer::reset(const GBitmap& base) {
+    fSnapshots.clear();
+    fBytesUsed = 0;
+    fWidth = base.width();
+    fHeight = base.height();
+    this->addSnapshot(base, 0, std::vector<int>());
+}
+
+void GPicturePlayer::addSnapshot(const GBitmap& device, int op, const std::vector<int>& stateOps) {
+    Snapshot snap;
+    snap.fOp = op;
+    snap.fPixels.resize(fWidth * fHeight);
+    snap.fStateOps = stateOps;
+    copy_pixels(snap.fPixels.data(), device);
+
+    fBytesUsed += snap.fPixels.size() * sizeof(GPixel) + snap.fStateOps.size() * sizeof(int);
+    auto pos = std::upper_bound(fSnapshots.begin(), fSnapshots.end(), op,
+                                [](int op, const Snapshot& s) { return op < s.fOp; });
+    fSnapshots.insert(pos, std::move(snap));
+
+    while (fBytesUsed > fBudget && fSnapshots.size() > 1) {
+        this->thinSnapshots();
+    }
+}
+
+/*
+ *  Double the interval, dropping the snapshots that are no longer on it. The base is never
+ *  dropped.
+ */
+void GPicturePlayer::thinSnapshots() {
+    fInterval *= 2;
+    std::vector<Snapshot> kept;
+    fBytesUsed = 0;
+    for (size_t i = 0; i < fSnapshots.size(); ++i) {
+        Snapshot& s = fSnapshots[i];
+        if (i == 0 || s.fOp % fInterval == 0) {
+            fBytesUsed += s.fPixels.size() * sizeof(GPixel) + s.fStateOps.size() * sizeof(int);
+            kept.push_back(std::move(s));
+        }
+    }
+    fSnapshots.swap(kept);
+}
+
+void GPicturePlayer::draw(const GBitmap& device, int opCount) {
+    if (fSnapshots.empty() || device.width() != fWidth || device.height() != fHeight) {
+        return;
+    }
+    opCount = std::max(0, std::min(opCount, fPicture->countOps()));
+
+    auto after = std::upper_bound(fSnapshots.begin(), fSnapshots.end(), opCount,
+                                  [](int op, const Snapshot& s) { return op < s.fOp; });
+    const Snapshot& start = *(after - 1);
+    const int startOp = start.fOp;
+    copy_pixels(device, start.fPixels.data());
+
+    auto canvas = GCreateCanvas(device);
+    if (!canvas) {
+        return;
+    }
+
+    // Each level holds the save that opened it (if any) followed by the concats and clips made
+    // in it.
+    struct Level {
+        bool             fLayer;
+        std::vector<int> fOps;
+    };
+    std::vector<Level> levels(1, Level{ false, std::vector<int>() });
+    int openLayers = 0;
+    GPath scratch;
+
+    for (int index : start.fStateOps) {
+        if (fPicture->op(index).verb() == GPicture::kSave) {
+            levels.push_back(Level{ false, std::vector<int>() });
+        }
+        levels.back().fOps.push_back(index);
+        fPicture->playbackOp(canvas.get(), index, &scratch);
+    }
+
+    // Adding a snapshot may move the others, so start is not used past this point.
+    for (int i = startOp; ; ++i) {
+        if (i > startOp && i % fInterval == 0 && openLayers == 0) {
+            std::vector<int> stateOps;
+            for (const Level& level : levels) {
+                stateOps.insert(stateOps.end(), level.fOps.begin(), level.fOps.end());
+            }
+            this->addSnapshot(device, i, stateOps);
+        }
+        if (i == opCount) {
+            break;
+        }
+
+        const GPicture::Op& op = fPicture->op(i);
+        switch (op.verb()) {
+            case GPicture::kSave:
+            case GPicture::kSaveLayer:
+                levels.push_back(Level{ op.verb() == GPicture::kSaveLayer, { i } });
+                openLayers += levels.back().fLayer;
+                break;
+            case GPicture::kRestore:
+                if (levels.size() == 1) {
+                    continue;   // unbalanced, as in GPicture::playback()
+                }
+                openLayers -= levels.back().fLayer;
+                levels.pop_back();
+                break;
+            case GPicture::kConcat:
+            case GPicture::kClipRect:
+            case GPicture::kClipPath:
+                levels.back().fOps.push_back(i);
+                break;
+            default:
+                break;
+        }
+        fPicture->playbackOp(canvas.get(), i, &scratch);
+    }
+
+    for (size_t i = 1; i < levels.size(); ++i) {
+        canvas->restore();
+    }
+}
@@ -62,6 +62,11 @@ public:
      return;
    }
 
+   // Copies share the color table, which never changes after construction.
+   virtual std::unique_ptr<GShader> clone() const {
+       return std::unique_ptr<GShader>(new RadialGradientShader(*this));
+   }
+
 private:
   GColor* fColors;
   int fCount;
@@ -0,0 +1,493 @@
+#include "GPicture.h"
+#include "GCanvas.h"
+#include "GMatrix.h"
+#include "GPaint.h"
+#include "GPath.h"
+#include "GPoint.h"
+#include "GRect.h"
+#include "GStroker.h"
+#include "RadialGradientShader.h"
+#include "TriangleGradientShader.h"
+#include <algorithm>
+
+static uint32_t float_bits(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static size_t align4(size_t bytes) {
+    return (bytes + 3) & ~(size_t)3;
+}
+
+size_t GRecordingCanvas::PaintHash::operator()(const GPaint& paint) const {
+    const GColor& c = paint.getColor();
+    size_t hash = float_bits(c.fA);
+    hash = hash * 31 + float_bits(c.fR);
+    hash = hash * 31 + float_bits(c.fG);
+    hash = hash * 31 + float_bits(c.fB);
+    hash = hash * 31 + (size_t)paint.getBlendMode();
+    hash = hash * 31 + (size_t)paint.getShader();
+    hash = hash * 31 + (size_t)paint.getFilter();
+    hash = hash * 31 + (size_t)paint.isAntiAlias();
+    return hash;
+}
+
+bool GRecordingCanvas::PaintEq::operator()(const GPaint& a, const GPaint& b) const {
+    const GColor& ca = a.getColor();
+    const GColor& cb = b.getColor();
+    return ca.fA == cb.fA && ca.fR == cb.fR && ca.fG == cb.fG && ca.fB == cb.fB &&
+           a.getBlendMode() == b.getBlendMode() &&
+           a.getShader() == b.getShader() &&
+           a.getFilter() == b.getFilter() &&
+           a.isAntiAlias() == b.isAntiAlias();
+}
+
+GRecordingCanvas::GRecordingCanvas() : fPicture(new GPicture) {}
+
+// The shader factories don't depend on the canvas, so hand out the same shaders a raster canvas
+// would. As with any shader, the caller must keep it alive as long as the picture is used.
+std::unique_ptr<GShader> GRecordingCanvas::final_createRadialGradient(GPoint center, float radius,
+                                                                      const GColor colors[],
+                                                                      int count) {
+    if (count < 2) {
+        return nullptr;
+    }
+    return std::unique_ptr<GShader>(new RadialGradientShader(center, radius, colors, count));
+}
+
+// Likewise the stroked line is only geometry, the same path any canvas would build.
+void GRecordingCanvas::final_addStrokedLine(GPath* path, GPoint p0, GPoint p1, float width,
+                                            bool roundCap) {
+    GStroker::StrokeLine(p0, p1, width, roundCap, path);
+}
+
+std::unique_ptr<GShader> GRecordingCanvas::final_createTriangleGradient(const GPoint pts[3],
+                                                                        const GColor colors[3]) {
+    return std::unique_ptr<GShader>(new TriangleGradientShader(pts, colors));
+}
+
+int GRecordingCanvas::addPaint(const GPaint& paint) {
+    auto found = fPaintIndex.find(paint);
+    if (found != fPaintIndex.end()) {
+        return found->second;
+    }
+    int index = (int)fPicture->fPaints.size();
+    fPicture->fPaints.push_back(paint);
+    fPaintIndex[paint] = index;
+    return index;
+}
+
+/*
+ *  Append a new op (header + payloadBytes) to the end of the command buffer. The returned
+ *  pointer is only valid until the next call, since the buffer may grow.
+ */
+GPicture::Op* GRecordingCanvas::appendOp(GPicture::Verb verb, size_t payloadBytes,
+                                         const GPaint* paint) {
+    std::vector<uint32_t>& storage = fPicture->fStorage;
+    const size_t offset = storage.size() * sizeof(uint32_t);
+    const size_t size = sizeof(GPicture::Op) + align4(payloadBytes);
+
+    storage.resize(storage.size() + size / sizeof(uint32_t), 0);
+    fPicture->fOffsets.push_back((uint32_t)offset);
+
+    GPicture::Op* op = reinterpret_cast<GPicture::Op*>((char*)storage.data() + offset);
+    op->fVerb = verb;
+    op->fFlags = 0;
+    op->fReserved = 0;
+    op->fPaint = paint ? this->addPaint(*paint) : -1;
+    op->fSize = (uint32_t)size;
+    op->fPtCount = 0;
+    op->fVerbCount = 0;
+    return op;
+}
+
+void GRecordingCanvas::save() {
+    this->appendOp(GPicture::kSave, 0);
+}
+
+void GRecordingCanvas::onSaveLayer(const GRect* bounds, const GPaint& paint) {
+    GPicture::Op* op = this->appendOp(GPicture::kSaveLayer, bounds ? sizeof(GRect) : 0, &paint);
+    if (bounds) {
+        op->fFlags |= GPicture::kHasBounds_Flag;
+        memcpy(op + 1, bounds, sizeof(GRect));
+    }
+}
+
+void GRecordingCanvas::restore() {
+    this->appendOp(GPicture::kRestore, 0);
+}
+
+void GRecordingCanvas::concat(const GMatrix& matrix) {
+    GPicture::Op* op = this->appendOp(GPicture::kConcat, 6 * sizeof(float));
+    float* m = reinterpret_cast<float*>(op + 1);
+    for (int i = 0; i < 6; ++i) {
+        m[i] = matrix[i];
+    }
+}
+
+void GRecordingCanvas::drawPaint(const GPaint& paint) {
+    this->appendOp(GPicture::kDrawPaint, 0, &paint);
+}
+
+void GRecordingCanvas::drawRect(const GRect& rect, const GPaint& paint) {
+    GPicture::Op* op = this->appendOp(GPicture::kDrawRect, sizeof(GRect), &paint);
+    memcpy(op + 1, &rect, sizeof(GRect));
+}
+
+void GRecordingCanvas::drawConvexPolygon(const GPoint pts[], int count, const GPaint& paint) {
+    if (count < 0) {
+        return;
+    }
+    GPicture::Op* op = this->appendOp(GPicture::kDrawConvexPolygon, count * sizeof(GPoint),
+                                      &paint);
+    op->fPtCount = count;
+    memcpy(op + 1, pts, count * sizeof(GPoint));
+}
+
+/*
+ *  Append a drawPath or clipPath op, writing the path straight into the command buffer.
+ */
+void GRecordingCanvas::appendPath(GPicture::Verb verb, const GPath& path, const GPaint* paint) {
+    // First pass sizes the op.
+    int verbCount = 0;
+    GPoint pts[4];
+    GPath::Iter iter(path);
+    for (GPath::Verb v = iter.next(pts); v != GPath::kDone; v = iter.next(pts)) {
+        verbCount += 1;
+    }
+    const int ptCount = path.countPoints();
+
+    GPicture::Op* op = this->appendOp(verb, ptCount * sizeof(GPoint) + verbCount, paint);
+    op->fPtCount = ptCount;
+    op->fVerbCount = verbCount;
+
+    GPoint* dstPts = reinterpret_cast<GPoint*>(op + 1);
+    uint8_t* dstVbs = reinterpret_cast<uint8_t*>(dstPts + ptCount);
+
+    GPath::Iter iter2(path);
+    for (GPath::Verb v = iter2.next(pts); v != GPath::kDone; v = iter2.next(pts)) {
+        *dstVbs++ = (uint8_t)v;
+        switch (v) {
+            case GPath::kMove:  *dstPts++ = pts[0]; break;
+            case GPath::kLine:  *dstPts++ = pts[1]; break;
+            case GPath::kQuad:  *dstPts++ = pts[1]; *dstPts++ = pts[2]; break;
+            case GPath::kCubic: *dstPts++ = pts[1]; *dstPts++ = pts[2]; *dstPts++ = pts[3]; break;
+            case GPath::kDone:  break;
+        }
+    }
+}
+
+void GRecordingCanvas::drawPath(const GPath& path, const GPaint& paint) {
+    this->appendPath(GPicture::kDrawPath, path, &paint);
+}
+
+/*
+ *  Only the vertices that the triangles use are stored: verts[0 .. highest index].
+ */
+void GRecordingCanvas::drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                                const int indices[], int triangleCount, const GPaint& paint) {
+    if (triangleCount <= 0) {
+        return;
+    }
+    int vertCount = 3 * triangleCount;
+    if (indices) {
+        vertCount = 1 + *std::max_element(indices, indices + 3 * triangleCount);
+    }
+    const size_t vertBytes = vertCount * sizeof(GPoint);
+    const size_t texBytes = texs ? vertCount * sizeof(GPoint) : 0;
+    const size_t colorBytes = colors ? vertCount * sizeof(GColor) : 0;
+    const size_t indexBytes = indices ? 3 * triangleCount * sizeof(int32_t) : 0;
+
+    GPicture::Op* op = this->appendOp(GPicture::kDrawMesh,
+                                      vertBytes + texBytes + colorBytes + indexBytes, &paint);
+    op->fPtCount = vertCount;
+    op->fVerbCount = triangleCount;
+    op->fFlags = (texs ? GPicture::kHasTexs_Flag : 0) |
+                 (colors ? GPicture::kHasColors_Flag : 0) |
+                 (indices ? GPicture::kHasIndices_Flag : 0);
+
+    char* dst = reinterpret_cast<char*>(op + 1);
+    memcpy(dst, verts, vertBytes);
+    dst += vertBytes;
+    if (texs) {
+        memcpy(dst, texs, texBytes);
+        dst += texBytes;
+    }
+    if (colors) {
+        memcpy(dst, colors, colorBytes);
+        dst += colorBytes;
+    }
+    if (indices) {
+        memcpy(dst, indices, indexBytes);
+    }
+}
+
+void GRecordingCanvas::clipRect(const GRect& rect) {
+    GPicture::Op* op = this->appendOp(GPicture::kClipRect, sizeof(GRect));
+    memcpy(op + 1, &rect, sizeof(GRect));
+}
+
+void GRecordingCanvas::clipPath(const GPath& path) {
+    this->appendPath(GPicture::kClipPath, path, nullptr);
+}
+
+std::unique_ptr<GPicture> GRecordingCanvas::finishRecording() {
+    std::unique_ptr<GPicture> picture(new GPicture);
+    std::swap(picture, fPicture);
+    fPaintIndex.clear();
+    return picture;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t GPicture::approximateBytesUsed() const {
+    return fStorage.size() * sizeof(uint32_t) +
+           fOffsets.size() * sizeof(uint32_t) +
+           fPaints.size() * sizeof(GPaint);
+}
+
+bool GPicture::hasExternalRefs() const {
+    for (const GPaint& paint : fPaints) {
+        if (paint.getShader() || paint.getFilter()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static GRect map_bounds(const GMatrix& ctm, const GPoint pts[], int count) {
+    if (count <= 0) {
+        return GRect::MakeLTRB(0, 0, 0, 0);
+    }
+    GPoint p = ctm.mapPt(pts[0]);
+    GRect bounds = GRect::MakeLTRB(p.fX, p.fY, p.fX, p.fY);
+    for (int i = 1; i < count; ++i) {
+        p = ctm.mapPt(pts[i]);
+        bounds.fLeft   = std::min(bounds.fLeft, p.fX);
+        bounds.fTop    = std::min(bounds.fTop, p.fY);
+        bounds.fRight  = std::max(bounds.fRight, p.fX);
+        bounds.fBottom = std::max(bounds.fBottom, p.fY);
+    }
+    return bounds;
+}
+
+GRect GPicture::DrawBounds(const Op& op, const GMatrix& ctm) {
+    switch (op.verb()) {
+        case kDrawPaint:
+            return GRect::MakeLTRB(-FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX);
+        case kDrawRect: {
+            const GRect& r = op.rect();
+            const GPoint corners[4] = {
+                { r.left(), r.top() }, { r.right(), r.top() },
+                { r.right(), r.bottom() }, { r.left(), r.bottom() },
+            };
+            return map_bounds(ctm, corners, 4);
+        }
+        case kDrawConvexPolygon:
+        case kDrawPath:
+        case kDrawMesh:
+            return map_bounds(ctm, op.points(), op.fPtCount);
+        default:
+            return GRect::MakeLTRB(0, 0, 0, 0);
+    }
+}
+
+GIRect GPicture::ClipPixels(const Op& op, const GMatrix& ctm, const GIRect& device,
+                            bool* isRect) {
+    const bool axisAligned = ctm[GMatrix::KX] == 0 && ctm[GMatrix::KY] == 0;
+    GIRect r;
+    if (op.verb() == kClipRect) {
+        const GRect& rect = op.rect();
+        const GPoint corners[4] = {
+            { rect.left(), rect.top() }, { rect.right(), rect.top() },
+            { rect.right(), rect.bottom() }, { rect.left(), rect.bottom() },
+        };
+        GRect bounds = map_bounds(ctm, corners, 4);
+        // the canvas keeps the pixels whose centers are inside, as drawRect() would fill
+        r = axisAligned ? bounds.round() : bounds.roundOut();
+    } else {
+        r = map_bounds(ctm, op.points(), op.fPtCount).roundOut();
+    }
+    if (isRect) {
+        *isRect = op.verb() == kClipRect && axisAligned;
+    }
+    if (!r.intersect(device)) {
+        return GIRect::MakeWH(0, 0);
+    }
+    return r;
+}
+
+GIRect GPicture::TouchedPixels(const Op& op, const GMatrix& ctm, const GIRect& device) {
+    GRect bounds = DrawBounds(op, ctm);
+    if (!bounds.intersect(GRect::Make(device))) {
+        return GIRect::MakeWH(0, 0);
+    }
+    GIRect r = bounds.roundOut();
+    if (!r.intersect(device)) {
+        return GIRect::MakeWH(0, 0);
+    }
+    return r;
+}
+
+void GPicture::computeDeviceBounds(std::vector<GRect>* bounds) const {
+    bounds->resize(this->countOps());
+
+    std::vector<GMatrix> ctmStack(1);
+    for (int i = 0; i < this->countOps(); ++i) {
+        const Op& op = this->op(i);
+        switch (op.verb()) {
+            case kSave:
+            case kSaveLayer:
+                ctmStack.push_back(ctmStack.back());
+                break;
+            case kRestore:
+                if (ctmStack.size() > 1) {
+                    ctmStack.pop_back();
+                }
+                break;
+            case kConcat:
+                ctmStack.back().preConcat(op.matrix());
+                break;
+            default:
+                break;
+        }
+        (*bounds)[i] = DrawBounds(op, ctmStack.back());
+    }
+}
+
+std::unique_ptr<GPicture> GPicture::makeSubset(const std::vector<bool>& keep) const {
+    GASSERT((int)keep.size() == this->countOps());
+
+    std::unique_ptr<GPicture> subset(new GPicture);
+    std::vector<int> paintRemap(fPaints.size(), -1);
+    for (int i = 0; i < this->countOps(); ++i) {
+        if (!keep[i]) {
+            continue;
+        }
+        const Op& src = this->op(i);
+        const uint32_t* begin = reinterpret_cast<const uint32_t*>(&src);
+
+        subset->fOffsets.push_back((uint32_t)(subset->fStorage.size() * sizeof(uint32_t)));
+        subset->fStorage.insert(subset->fStorage.end(), begin, begin + src.fSize / 4);
+
+        if (src.fPaint >= 0) {
+            int& remapped = paintRemap[src.fPaint];
+            if (remapped < 0) {
+                remapped = (int)subset->fPaints.size();
+                subset->fPaints.push_back(fPaints[src.fPaint]);
+            }
+            Op* dst = reinterpret_cast<Op*>((char*)subset->fStorage.data() +
+                                            subset->fOffsets.back());
+            dst->fPaint = remapped;
+        }
+    }
+    return subset;
+}
+
+static void rebuild_path(const GPicture::Op& op, GPath* path) {
+    const GPoint* pts = op.points();
+    const uint8_t* vbs = op.verbs();
+
+    path->reset();
+    for (uint32_t i = 0; i < op.fVerbCount; ++i) {
+        switch ((GPath::Verb)vbs[i]) {
+            case GPath::kMove:  path->moveTo(pts[0]); pts += 1; break;
+            case GPath::kLine:  path->lineTo(pts[0]); pts += 1; break;
+            case GPath::kQuad:  path->quadTo(pts[0], pts[1]); pts += 2; break;
+            case GPath::kCubic: path->cubicTo(pts[0], pts[1], pts[2]); pts += 3; break;
+            case GPath::kDone:  break;
+        }
+    }
+}
+
+void GPicture::playbackOp(GCanvas* canvas, int index, GPath* scratch,
+                          const ShaderMap* shaders) const {
+    const Op& op = this->op(index);
+    const GPaint* paint = op.fPaint >= 0 ? &this->paint(op) : nullptr;
+    GPaint swapped;
+    if (paint && paint->getShader() && shaders) {
+        auto found = shaders->find(paint->getShader());
+        if (found != shaders->end()) {
+            swapped = *paint;
+            swapped.setShader(found->second);
+            paint = &swapped;
+        }
+    }
+    switch (op.verb()) {
+        case kSave:
+            canvas->save();
+            break;
+        case kSaveLayer:
+            canvas->saveLayer((op.fFlags & kHasBounds_Flag) ? &op.rect() : nullptr,
+                              *paint);
+            break;
+        case kRestore:
+            canvas->restore();
+            break;
+        case kConcat:
+            canvas->concat(op.matrix());
+            break;
+        case kDrawPaint:
+            canvas->drawPaint(*paint);
+            break;
+        case kDrawRect:
+            canvas->drawRect(op.rect(), *paint);
+            break;
+        case kDrawConvexPolygon:
+            canvas->drawConvexPolygon(op.points(), op.fPtCount, *paint);
+            break;
+        case kDrawPath:
+            rebuild_path(op, scratch);
+            canvas->drawPath(*scratch, *paint);
+            break;
+        case kDrawMesh:
+            canvas->drawMesh(op.points(), op.meshColors(), op.meshTexs(), op.meshIndices(),
+                             op.fVerbCount, *paint);
+            break;
+        case kClipRect:
+            canvas->clipRect(op.rect());
+            break;
+        case kClipPath:
+            rebuild_path(op, scratch);
+            canvas->clipPath(*scratch);
+            break;
+    }
+}
+
+void GPicture::playback(GCanvas* canvas, int firstOp, int lastOp) const {
+    firstOp = std::max(firstOp, 0);
+    lastOp = std::min(lastOp, this->countOps());
+
+    GPath scratch;
+    int depth = 0;
+    for (int i = 0; i < lastOp; ++i) {
+        const Op& op = this->op(i);
+        switch (op.verb()) {
+            case kSave:
+            case kSaveLayer:
+                depth += 1;
+                break;
+            case kRestore:
+                // never pop state that the caller pushed before calling us
+                if (depth == 0) {
+                    continue;
+                }
+                depth -= 1;
+                break;
+            case kConcat:
+            case kClipRect:
+            case kClipPath:
+                break;
+            default:
+                if (i < firstOp) {
+                    continue;
+                }
+                break;
+        }
+        this->playbackOp(canvas, i, &scratch);
+    }
+    while (depth-- > 0) {
+        canvas->restore();
+    }
+}
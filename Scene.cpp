@@ -0,0 +1,349 @@
+#include "GScene.h"
+#include "GCanvas.h"
+#include "GPaint.h"
+#include "GPath.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t align4(size_t bytes) {
+    return (bytes + 3) & ~(size_t)3;
+}
+
+// Number of points each path verb consumes from the pool.
+static int verb_point_count(uint8_t verb) {
+    switch ((GPath::Verb)verb) {
+        case GPath::kMove:  return 1;
+        case GPath::kLine:  return 1;
+        case GPath::kQuad:  return 2;
+        case GPath::kCubic: return 3;
+        default:            return -1;
+    }
+}
+
+static bool has_paint(uint8_t verb) {
+    return verb == GScene::kSaveLayer || (verb >= GScene::kDrawPaint && verb <= GScene::kDrawPath);
+}
+
+bool GScene::Encode(const GPicture& picture, std::vector<uint8_t>* dst) {
+    dst->clear();
+    if (picture.hasExternalRefs()) {
+        return false;
+    }
+
+    std::vector<Op>      ops(picture.countOps());
+    std::vector<GPoint>  points;
+    std::vector<uint8_t> verbs;
+
+    // The picture already deduplicates its paints, so its paint table becomes the color pool
+    // (the blend mode lives in each op).
+    std::vector<GColor> colors;
+    std::vector<int> colorIndex(picture.countPaints(), -1);
+
+    for (int i = 0; i < picture.countOps(); ++i) {
+        const GPicture::Op& src = picture.op(i);
+        Op& op = ops[i];
+        memset(&op, 0, sizeof(Op));
+        op.fVerb = (uint8_t)src.verb();     // GScene::Verb mirrors GPicture::Verb
+        op.fPoint = (uint32_t)points.size();
+
+        if (src.fPaint >= 0) {
+            const GPaint& paint = picture.paint(src);
+            int& index = colorIndex[src.fPaint];
+            if (index < 0) {
+                index = (int)colors.size();
+                colors.push_back(paint.getColor());
+            }
+            op.fColor = index;
+            op.fBlendMode = (uint8_t)paint.getBlendMode();
+        }
+
+        switch (src.verb()) {
+            case GPicture::kSaveLayer:
+                if (!(src.fFlags & GPicture::kHasBounds_Flag)) {
+                    break;
+                }
+                op.fFlags |= kHasBounds_Flag;
+                // fall through
+            case GPicture::kDrawRect:
+            case GPicture::kClipRect: {
+                const GRect& r = src.rect();
+                points.push_back({ r.left(), r.top() });
+                points.push_back({ r.right(), r.bottom() });
+                op.fPointCount = 2;
+            } break;
+            case GPicture::kConcat: {
+                const GMatrix m = src.matrix();
+                points.push_back({ m[GMatrix::SX], m[GMatrix::KX] });
+                points.push_back({ m[GMatrix::TX], m[GMatrix::KY] });
+                points.push_back({ m[GMatrix::SY], m[GMatrix::TY] });
+                op.fPointCount = 3;
+            } break;
+            case GPicture::kDrawPath:
+            case GPicture::kClipPath:
+                op.fVerbStart = (uint32_t)verbs.size();
+                op.fVerbCount = src.fVerbCount;
+                verbs.insert(verbs.end(), src.verbs(), src.verbs() + src.fVerbCount);
+                // fall through
+            case GPicture::kDrawConvexPolygon:
+                points.insert(points.end(), src.points(), src.points() + src.fPtCount);
+                op.fPointCount = src.fPtCount;
+                break;
+            case GPicture::kDrawMesh:
+                return false;   // no scene verb for meshes
+            default:
+                break;
+        }
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    header.fMagic = kMagic;
+    header.fVersion = kVersion;
+    header.fHeaderSize = sizeof(Header);
+    header.fOpCount = (uint32_t)ops.size();
+    header.fOpOffset = (uint32_t)align4(sizeof(Header));
+    header.fPointCount = (uint32_t)points.size();
+    header.fPointOffset = header.fOpOffset + (uint32_t)(ops.size() * sizeof(Op));
+    header.fColorCount = (uint32_t)colors.size();
+    header.fColorOffset = header.fPointOffset + (uint32_t)(points.size() * sizeof(GPoint));
+    header.fVerbCount = (uint32_t)verbs.size();
+    header.fVerbOffset = header.fColorOffset + (uint32_t)(colors.size() * sizeof(GColor));
+
+    dst->resize(align4(header.fVerbOffset + verbs.size()), 0);
+    uint8_t* base = dst->data();
+    memcpy(base, &header, sizeof(Header));
+    memcpy(base + header.fOpOffset, ops.data(), ops.size() * sizeof(Op));
+    memcpy(base + header.fPointOffset, points.data(), points.size() * sizeof(GPoint));
+    memcpy(base + header.fColorOffset, colors.data(), colors.size() * sizeof(GColor));
+    memcpy(base + header.fVerbOffset, verbs.data(), verbs.size());
+    return true;
+}
+
+bool GScene::WriteFile(const GPicture& picture, const char path[]) {
+    std::vector<uint8_t> data;
+    if (!Encode(picture, &data)) {
+        return false;
+    }
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        return false;
+    }
+    bool success = fwrite(data.data(), 1, data.size(), f) == data.size();
+    success &= fclose(f) == 0;
+    return success;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+GScene::GScene(const void* data, size_t length, bool mapped)
+    : fData(data), fLength(length), fMapped(mapped) {
+    const uint8_t* base = static_cast<const uint8_t*>(data);
+    fHeader = reinterpret_cast<const Header*>(base);
+    fOps    = reinterpret_cast<const Op*>(base + fHeader->fOpOffset);
+    fPoints = reinterpret_cast<const GPoint*>(base + fHeader->fPointOffset);
+    fColors = reinterpret_cast<const GColor*>(base + fHeader->fColorOffset);
+    fVerbs  = base + fHeader->fVerbOffset;
+}
+
+GScene::~GScene() {
+    if (fMapped) {
+        munmap(const_cast<void*>(fData), fLength);
+    }
+}
+
+/*
+ *  Check that a section of count elements of elemSize bytes, at offset, fits in length.
+ */
+static bool section_fits(uint32_t offset, uint32_t count, size_t elemSize, size_t length) {
+    return (offset & 3) == 0 && (uint64_t)offset + (uint64_t)count * elemSize <= length;
+}
+
+static bool range_fits(uint32_t start, uint32_t count, uint32_t total) {
+    return (uint64_t)start + count <= total;
+}
+
+bool GScene::validate() const {
+    const Header& h = *fHeader;
+    // Version 2 only added the clip verbs, so version 1 scenes are still read.
+    const uint8_t lastVerb = h.fVersion == 1 ? (uint8_t)kDrawPath : (uint8_t)kClipPath;
+    if (h.fMagic != kMagic || h.fVersion < 1 || h.fVersion > kVersion ||
+        h.fHeaderSize != sizeof(Header) ||
+        !section_fits(h.fOpOffset, h.fOpCount, sizeof(Op), fLength) ||
+        !section_fits(h.fPointOffset, h.fPointCount, sizeof(GPoint), fLength) ||
+        !section_fits(h.fColorOffset, h.fColorCount, sizeof(GColor), fLength) ||
+        !section_fits(h.fVerbOffset, h.fVerbCount, 1, fLength)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < h.fOpCount; ++i) {
+        const Op& op = fOps[i];
+        if (op.fVerb > lastVerb || op.fBlendMode > (uint8_t)GBlendMode::kXor ||
+            !range_fits(op.fPoint, op.fPointCount, h.fPointCount)) {
+            return false;
+        }
+        if (has_paint(op.fVerb) && op.fColor >= h.fColorCount) {
+            return false;
+        }
+
+        uint32_t needPoints = 0;
+        switch (op.verb()) {
+            case kSaveLayer:
+                needPoints = (op.fFlags & kHasBounds_Flag) ? 2 : 0;
+                break;
+            case kConcat:
+                needPoints = 3;
+                break;
+            case kDrawRect:
+            case kClipRect:
+                needPoints = 2;
+                break;
+            case kDrawConvexPolygon:
+                needPoints = op.fPointCount;
+                break;
+            case kDrawPath:
+            case kClipPath: {
+                if (!range_fits(op.fVerbStart, op.fVerbCount, h.fVerbCount)) {
+                    return false;
+                }
+                // GPath requires every contour to start with a move
+                const uint8_t* verbs = fVerbs + op.fVerbStart;
+                if (op.fVerbCount > 0 && verbs[0] != GPath::kMove) {
+                    return false;
+                }
+                for (uint32_t v = 0; v < op.fVerbCount; ++v) {
+                    int n = verb_point_count(verbs[v]);
+                    if (n < 0) {
+                        return false;
+                    }
+                    needPoints += n;
+                }
+            } break;
+            default:
+                break;
+        }
+        if (op.fPointCount != needPoints) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<GScene> GScene::MakeFromData(const void* data, size_t length) {
+    if (!data || ((uintptr_t)data & 3) || length < sizeof(Header)) {
+        return nullptr;
+    }
+    std::unique_ptr<GScene> scene(new GScene(data, length, false));
+    if (!scene->validate()) {
+        return nullptr;
+    }
+    return scene;
+}
+
+std::unique_ptr<GScene> GScene::MakeFromFile(const char path[]) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat status;
+    if (fstat(fd, &status) || (size_t)status.st_size < sizeof(Header)) {
+        close(fd);
+        return nullptr;
+    }
+    const size_t length = status.st_size;
+    void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);      // the mapping keeps the file alive
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::unique_ptr<GScene> scene(new GScene(data, length, true));
+    if (!scene->validate()) {
+        return nullptr;     // the destructor unmaps
+    }
+    return scene;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GScene::rebuildPath(const Op& op, GPath* path) const {
+    const GPoint* pts = fPoints + op.fPoint;
+    const uint8_t* verbs = fVerbs + op.fVerbStart;
+    path->reset();
+    for (uint32_t v = 0; v < op.fVerbCount; ++v) {
+        switch ((GPath::Verb)verbs[v]) {
+            case GPath::kMove:  path->moveTo(pts[0]); pts += 1; break;
+            case GPath::kLine:  path->lineTo(pts[0]); pts += 1; break;
+            case GPath::kQuad:  path->quadTo(pts[0], pts[1]); pts += 2; break;
+            case GPath::kCubic: path->cubicTo(pts[0], pts[1], pts[2]); pts += 3; break;
+            case GPath::kDone:  break;
+        }
+    }
+}
+
+void GScene::playback(GCanvas* canvas, GPath* scratch) const {
+    int depth = 0;
+    for (int i = 0; i < this->countOps(); ++i) {
+        const Op& op = fOps[i];
+        const GPoint* pts = fPoints + op.fPoint;
+
+        GPaint paint;
+        if (has_paint(op.fVerb)) {
+            paint.setColor(fColors[op.fColor]);
+            paint.setBlendMode((GBlendMode)op.fBlendMode);
+        }
+
+        switch (op.verb()) {
+            case kSave:
+                canvas->save();
+                depth += 1;
+                break;
+            case kSaveLayer:
+                if (op.fFlags & kHasBounds_Flag) {
+                    const GRect bounds = GRect::MakeLTRB(pts[0].fX, pts[0].fY,
+                                                         pts[1].fX, pts[1].fY);
+                    canvas->saveLayer(&bounds, paint);
+                } else {
+                    canvas->saveLayer(nullptr, paint);
+                }
+                depth += 1;
+                break;
+            case kRestore:
+                // never pop state that the caller pushed before calling us
+                if (depth > 0) {
+                    canvas->restore();
+                    depth -= 1;
+                }
+                break;
+            case kConcat:
+                canvas->concat(GMatrix(pts[0].fX, pts[0].fY, pts[1].fX,
+                                       pts[1].fY, pts[2].fX, pts[2].fY));
+                break;
+            case kDrawPaint:
+                canvas->drawPaint(paint);
+                break;
+            case kDrawRect:
+                canvas->drawRect(GRect::MakeLTRB(pts[0].fX, pts[0].fY, pts[1].fX, pts[1].fY),
+                                 paint);
+                break;
+            case kDrawConvexPolygon:
+                canvas->drawConvexPolygon(pts, op.fPointCount, paint);
+                break;
+            case kDrawPath:
+                this->rebuildPath(op, scratch);
+                canvas->drawPath(*scratch, paint);
+                break;
+            case kClipRect:
+                canvas->clipRect(GRect::MakeLTRB(pts[0].fX, pts[0].fY, pts[1].fX, pts[1].fY));
+                break;
+            case kClipPath:
+                this->rebuildPath(op, scratch);
+                canvas->clipPath(*scratch);
+                break;
+        }
+    }
+    while (depth-- > 0) {
+        canvas->restore();
+    }
+}
@@ -0,0 +1,552 @@
+#include "GSceneParser.h"
+#include "GMatrix.h"
+#include "GRect.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static bool is_ident(char c) {
+    return is_digit(c) || c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/*
+ *  Parse a decimal float literal (optional sign, digits, fraction, exponent and 'f' suffix) at
+ *  [p, end). Returns the end of the literal, or nullptr if there isn't one.
+ *
+ *  The value is rounded the way the compiler rounds the same text when it is #included as C++:
+ *  an 'f'-suffixed literal once, straight to float, and a plain literal to a double and then to
+ *  a float. Short mantissas with a small power of ten are computed directly (both operands are
+ *  exact in the target type, so the one operation rounds correctly); anything longer falls back
+ *  to strtof or strtod.
+ */
+static const char* parse_float(const char* p, const char* end, float* value) {
+    static const double kPow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    const int kMaxPow10 = 22;
+    const int kMaxExactDigits = 15;
+    const int kMaxFloatPow10 = 10;
+    const int kMaxFloatExactDigits = 7;
+
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;         // significant digits in mantissa
+    int scale = 0;          // value = mantissa * 10^scale
+    bool sawDigit = false;
+    for (; p < end && is_digit(*p); ++p) {
+        sawDigit = true;
+        if (digits > 0 || *p != '0') {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+            } else {
+                scale += 1;
+            }
+            digits += 1;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && is_digit(*p); ++p) {
+            sawDigit = true;
+            if (digits > 0 || *p != '0') {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    scale -= 1;
+                }
+                digits += 1;
+            } else {
+                scale -= 1;
+            }
+        }
+    }
+    if (!sawDigit) {
+        return nullptr;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negExp = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            negExp = *q == '-';
+            ++q;
+        }
+        if (q < end && is_digit(*q)) {
+            int exp = 0;
+            for (; q < end && is_digit(*q); ++q) {
+                exp = std::min(exp * 10 + (*q - '0'), 100000);
+            }
+            scale += negExp ? -exp : exp;
+            p = q;
+        }
+    }
+    const char* stop = p;
+    const bool isFloat = p < end && (*p == 'f' || *p == 'F');
+    if (isFloat) {
+        ++p;
+    }
+
+    float f;
+    if (mantissa == 0) {
+        f = 0;
+    } else if (isFloat && digits <= kMaxFloatExactDigits &&
+               scale >= -kMaxFloatPow10 && scale <= kMaxFloatPow10) {
+        const float m = (float)mantissa;
+        f = scale < 0 ? m / (float)kPow10[-scale] : m * (float)kPow10[scale];
+    } else if (!isFloat && digits <= kMaxExactDigits &&
+               scale >= -kMaxPow10 && scale <= kMaxPow10) {
+        f = (float)(scale < 0 ? mantissa / kPow10[-scale] : mantissa * kPow10[scale]);
+    } else {
+        char buffer[64];
+        const size_t length = std::min<size_t>(stop - start, sizeof(buffer) - 1);
+        memcpy(buffer, start, length);
+        buffer[length] = 0;
+        f = isFloat ? fabsf(strtof(buffer, nullptr)) : (float)fabs(strtod(buffer, nullptr));
+    }
+    *value = negative ? -f : f;
+    return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ *  Reads the tokens of one statement. Every method skips leading whitespace and comments.
+ */
+struct GSceneParser::Cursor {
+    const char* fCurr;
+    const char* fEnd;
+
+    void skip() {
+        while (fCurr < fEnd) {
+            if (is_space(*fCurr)) {
+                ++fCurr;
+            } else if (fCurr + 1 < fEnd && fCurr[0] == '/' && fCurr[1] == '/') {
+                while (fCurr < fEnd && *fCurr != '\n') {
+                    ++fCurr;
+                }
+            } else if (fCurr + 1 < fEnd && fCurr[0] == '/' && fCurr[1] == '*') {
+                fCurr += 2;
+                while (fCurr + 1 < fEnd && !(fCurr[0] == '*' && fCurr[1] == '/')) {
+                    ++fCurr;
+                }
+                fCurr = std::min(fCurr + 2, fEnd);
+            } else {
+                break;
+            }
+        }
+    }
+
+    bool atEnd() {
+        this->skip();
+        return fCurr == fEnd;
+    }
+
+    // Consume the punctuation str if it is next.
+    bool match(const char str[]) {
+        this->skip();
+        const size_t n = strlen(str);
+        if ((size_t)(fEnd - fCurr) < n || memcmp(fCurr, str, n)) {
+            return false;
+        }
+        fCurr += n;
+        return true;
+    }
+
+    // Consume the identifier name if it is next (and not just a prefix of the next identifier).
+    bool word(const char name[]) {
+        this->skip();
+        const size_t n = strlen(name);
+        if ((size_t)(fEnd - fCurr) < n || memcmp(fCurr, name, n) ||
+            (fCurr + n < fEnd && is_ident(fCurr[n]))) {
+            return false;
+        }
+        fCurr += n;
+        return true;
+    }
+
+    // Consume count comma-separated numbers.
+    bool numbers(float values[], int count) {
+        for (int i = 0; i < count; ++i) {
+            if (i > 0 && !this->match(",")) {
+                return false;
+            }
+            this->skip();
+            const char* next = parse_float(fCurr, fEnd, &values[i]);
+            if (!next) {
+                return false;
+            }
+            fCurr = next;
+        }
+        return true;
+    }
+
+    // Consume "(" count numbers ")".
+    bool args(float values[], int count) {
+        return this->match("(") && this->numbers(values, count) && this->match(")");
+    }
+
+    bool color(GColor* c) {
+        float v[4];
+        if (!this->match("{") || !this->numbers(v, 4) || !this->match("}")) {
+            return false;
+        }
+        *c = GColor::MakeARGB(v[0], v[1], v[2], v[3]);
+        return true;
+    }
+
+    bool rect(GRect* r) {
+        float v[4];
+        if (!this->word("GRect") || !this->match("::")) {
+            return false;
+        }
+        if (this->word("MakeLTRB") && this->args(v, 4)) {
+            *r = GRect::MakeLTRB(v[0], v[1], v[2], v[3]);
+            return true;
+        }
+        if (this->word("MakeXYWH") && this->args(v, 4)) {
+            *r = GRect::MakeXYWH(v[0], v[1], v[2], v[3]);
+            return true;
+        }
+        return false;
+    }
+};
+
+void GSceneParser::reset(GCanvas* canvas) {
+    fCanvas = canvas;
+    fPaint = GPaint();
+    fPath.reset();
+    fPending.clear();
+    fState = kCode;
+    fLine = 1;
+    fStatementLine = 0;
+    fSaveDepth = 0;
+    fErrorLine = 0;
+    fError[0] = 0;
+}
+
+bool GSceneParser::fail(const char msg[]) {
+    if (!fErrorLine) {
+        fErrorLine = fStatementLine ? fStatementLine : fLine;
+        snprintf(fError, sizeof(fError), "%s", msg);
+    }
+    return false;
+}
+
+bool GSceneParser::write(const char text[], size_t length) {
+    if (fErrorLine) {
+        return false;
+    }
+
+    const char* start = text;     // start of the current statement's text within this chunk
+    const char* end = text + length;
+    for (const char* p = text; p < end; ++p) {
+        const char c = *p;
+        fLine += c == '\n';
+
+        if (fState == kSlash) {
+            if (c == '/') {
+                fState = kLineComment;
+                continue;
+            }
+            if (c == '*') {
+                fState = kBlockComment;
+                continue;
+            }
+            fState = kCode;     // the '/' was code, and so is c
+            if (!fStatementLine) {
+                fStatementLine = fLine;
+            }
+        }
+
+        switch (fState) {
+            case kCode:
+                if (c == '/') {
+                    fState = kSlash;
+                } else if (c == ';') {
+                    bool ok;
+                    if (fPending.empty()) {
+                        ok = this->execute(start, p);
+                    } else {
+                        fPending.insert(fPending.end(), start, p);
+                        ok = this->execute(fPending.data(), fPending.data() + fPending.size());
+                        fPending.clear();
+                    }
+                    if (!ok) {
+                        return false;
+                    }
+                    start = p + 1;
+                    fStatementLine = 0;
+                } else if (!fStatementLine && !is_space(c)) {
+                    fStatementLine = fLine;
+                }
+                break;
+            case kLineComment:
+                if (c == '\n') {
+                    fState = kCode;
+                }
+                break;
+            case kBlockComment:
+                if (c == '*') {
+                    fState = kBlockStar;
+                }
+                break;
+            case kBlockStar:
+                fState = c == '/' ? kCode : (c == '*' ? kBlockStar : kBlockComment);
+                break;
+            case kSlash:
+                break;
+        }
+    }
+    fPending.insert(fPending.end(), start, end);
+    return true;
+}
+
+bool GSceneParser::finish() {
+    if (fErrorLine) {
+        return false;
+    }
+    Cursor rest = { fPending.data(), fPending.data() + fPending.size() };
+    if (!rest.atEnd() || fState == kSlash) {
+        return this->fail("missing ';' at end of text");
+    }
+    while (fSaveDepth > 0) {
+        fCanvas->restore();
+        fSaveDepth -= 1;
+    }
+    fPending.clear();
+    fState = kCode;
+    return true;
+}
+
+bool GSceneParser::parseFile(const char path[]) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return this->fail("can't open file");
+    }
+    char buffer[16 * 1024];
+    bool ok = true;
+    size_t n;
+    while (ok && (n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        ok = this->write(buffer, n);
+    }
+    if (ok && ferror(f)) {
+        ok = this->fail("error reading file");
+    }
+    fclose(f);
+    return ok && this->finish();
+}
+
+bool GSceneParser::execute(const char* text, const char* end) {
+    Cursor c = { text, end };
+    if (c.atEnd()) {
+        return true;    // empty statement
+    }
+
+    bool ok;
+    if (c.word("canvas")) {
+        ok = c.match("->") && this->canvasCall(&c);
+    } else if (c.word("paint")) {
+        ok = c.match(".") && this->paintCall(&c);
+        while (ok && c.match(".")) {
+            ok = this->paintCall(&c);
+        }
+    } else if (c.word("path")) {
+        ok = c.match(".") && this->pathCall(&c);
+        while (ok && c.match(".")) {
+            ok = this->pathCall(&c);
+        }
+    } else {
+        return this->fail("statement must start with canvas, paint or path");
+    }
+    if (fErrorLine) {
+        return false;
+    }
+    if (!ok || !c.atEnd()) {
+        return this->fail("syntax error");
+    }
+    return true;
+}
+
+bool GSceneParser::canvasCall(Cursor* c) {
+    float v[6];
+    GRect r;
+    GColor color;
+
+    if (c->word("drawPath")) {
+        if (!c->match("(") || !c->word("path") || !c->match(",") || !c->word("paint") ||
+            !c->match(")")) {
+            return false;
+        }
+        fCanvas->drawPath(fPath, fPaint);
+    } else if (c->word("drawRect")) {
+        if (!c->match("(") || !c->rect(&r) || !c->match(",") || !c->word("paint") ||
+            !c->match(")")) {
+            return false;
+        }
+        fCanvas->drawRect(r, fPaint);
+    } else if (c->word("fillRect")) {
+        if (!c->match("(") || !c->rect(&r) || !c->match(",") || !c->color(&color) ||
+            !c->match(")")) {
+            return false;
+        }
+        fCanvas->fillRect(r, color);
+    } else if (c->word("drawPaint")) {
+        if (!c->match("(") || !c->word("paint") || !c->match(")")) {
+            return false;
+        }
+        fCanvas->drawPaint(fPaint);
+    } else if (c->word("clear")) {
+        if (!c->match("(") || !c->color(&color) || !c->match(")")) {
+            return false;
+        }
+        fCanvas->clear(color);
+    } else if (c->word("save")) {
+        if (!c->match("(") || !c->match(")")) {
+            return false;
+        }
+        fCanvas->save();
+        fSaveDepth += 1;
+    } else if (c->word("saveLayer")) {
+        if (!c->match("(") || !c->word("paint") || !c->match(")")) {
+            return false;
+        }
+        fCanvas->saveLayer(fPaint);
+        fSaveDepth += 1;
+    } else if (c->word("restore")) {
+        if (!c->match("(") || !c->match(")")) {
+            return false;
+        }
+        if (fSaveDepth == 0) {
+            return this->fail("restore without a matching save");
+        }
+        fCanvas->restore();
+        fSaveDepth -= 1;
+    } else if (c->word("translate")) {
+        if (!c->args(v, 2)) {
+            return false;
+        }
+        fCanvas->translate(v[0], v[1]);
+    } else if (c->word("scale")) {
+        if (!c->args(v, 2)) {
+            return false;
+        }
+        fCanvas->scale(v[0], v[1]);
+    } else if (c->word("rotate")) {
+        if (!c->args(v, 1)) {
+            return false;
+        }
+        fCanvas->rotate(v[0]);
+    } else if (c->word("concat")) {
+        if (!c->match("(") || !c->word("GMatrix") || !c->args(v, 6) || !c->match(")")) {
+            return false;
+        }
+        fCanvas->concat(GMatrix(v[0], v[1], v[2], v[3], v[4], v[5]));
+    } else if (c->word("clipRect")) {
+        if (!c->match("(") || !c->rect(&r) || !c->match(")")) {
+            return false;
+        }
+        fCanvas->clipRect(r);
+    } else if (c->word("clipPath")) {
+        if (!c->match("(") || !c->word("path") || !c->match(")")) {
+            return false;
+        }
+        fCanvas->clipPath(fPath);
+    } else {
+        return this->fail("unknown canvas method");
+    }
+    return true;
+}
+
+bool GSceneParser::paintCall(Cursor* c) {
+    static const char* const kModeNames[] = {
+        "kClear", "kSrc", "kDst", "kSrcOver", "kDstOver", "kSrcIn", "kDstIn",
+        "kSrcOut", "kDstOut", "kSrcATop", "kDstATop", "kXor",
+    };
+
+    if (c->word("setColor")) {
+        GColor color;
+        if (!c->match("(") || !c->color(&color) || !c->match(")")) {
+            return false;
+        }
+        fPaint.setColor(color);
+    } else if (c->word("setAlpha")) {
+        float alpha;
+        if (!c->args(&alpha, 1)) {
+            return false;
+        }
+        fPaint.setAlpha(alpha);
+    } else if (c->word("setBlendMode")) {
+        if (!c->match("(") || !c->word("GBlendMode") || !c->match("::")) {
+            return false;
+        }
+        int mode = -1;
+        for (int i = 0; i < (int)GARRAY_COUNT(kModeNames) && mode < 0; ++i) {
+            if (c->word(kModeNames[i])) {
+                mode = i;
+            }
+        }
+        if (mode < 0) {
+            return this->fail("unknown blend mode");
+        }
+        if (!c->match(")")) {
+            return false;
+        }
+        fPaint.setBlendMode((GBlendMode)mode);
+    } else {
+        return this->fail("unknown paint method");
+    }
+    return true;
+}
+
+bool GSceneParser::pathCall(Cursor* c) {
+    float v[6];
+    if (c->word("reset")) {
+        if (!c->match("(") || !c->match(")")) {
+            return false;
+        }
+        fPath.reset();
+    } else if (c->word("moveTo")) {
+        if (!c->args(v, 2)) {
+            return false;
+        }
+        fPath.moveTo(v[0], v[1]);
+    } else if (c->word("lineTo")) {
+        if (!c->args(v, 2)) {
+            return false;
+        }
+        if (fPath.countPoints() == 0) {
+            return this->fail("path must start with moveTo");
+        }
+        fPath.lineTo(v[0], v[1]);
+    } else if (c->word("quadTo")) {
+        if (!c->args(v, 4)) {
+            return false;
+        }
+        if (fPath.countPoints() == 0) {
+            return this->fail("path must start with moveTo");
+        }
+        fPath.quadTo({v[0], v[1]}, {v[2], v[3]});
+    } else if (c->word("cubicTo")) {
+        if (!c->args(v, 6)) {
+            return false;
+        }
+        if (fPath.countPoints() == 0) {
+            return this->fail("path must start with moveTo");
+        }
+        fPath.cubicTo({v[0], v[1]}, {v[2], v[3]}, {v[4], v[5]});
+    } else {
+        return this->fail("unknown path method");
+    }
+    return true;
+}
@@ -0,0 +1,445 @@
+#include "GStroker.h"
+#include "GPath.h"
+#include "GPoint.h"
+#include <algorithm>
+#include <cmath>
+
+static const int kMaxOffsetDepth = 6;   // curves are offset as at most 2^6 pieces
+
+static float dot(GVector a, GVector b) { return a.fX * b.fX + a.fY * b.fY; }
+static float cross(GVector a, GVector b) { return a.fX * b.fY - a.fY * b.fX; }
+
+/*
+ *  The unit normal of direction d (d turned a quarter, toward +y for d along +x), or false if d
+ *  has no length.
+ */
+static bool unit_normal(GVector d, GVector* normal) {
+    const float length = d.length();
+    if (!(length > 0) || !std::isfinite(length)) {
+        return false;
+    }
+    *normal = { -d.fY / length, d.fX / length };
+    return true;
+}
+
+// The direction the contour moves in, where its normal is n.
+static GVector forward(GVector n) { return { n.fY, -n.fX }; }
+
+static GVector rotate(GVector v, float radians) {
+    const float c = cosf(radians), s = sinf(radians);
+    return { v.fX * c - v.fY * s, v.fX * s + v.fY * c };
+}
+
+/*
+ *  Arc of radius r around center from center + from * r to center + to * r (from and to unit
+ *  vectors), turning the short way, as cubics of at most a quarter circle each.
+ */
+template <typename Sink> void arc_to(Sink* sink, GPoint center, GVector from, GVector to,
+                                     float r) {
+    const float angle = atan2f(cross(from, to), dot(from, to));
+    const int pieces = std::max(1, (int)ceilf(fabsf(angle) / (float)(M_PI / 2) - 0.001f));
+    const float step = angle / pieces;
+    const float k = 4.0f / 3 * tanf(step / 4);     // handle length, per unit of radius
+    GVector u = from;
+    for (int i = 0; i < pieces; ++i) {
+        const GVector v = (i == pieces - 1) ? to : rotate(u, step);
+        const GVector uTangent = { -u.fY, u.fX }, vTangent = { -v.fY, v.fX };
+        sink->cubicTo(center + (u + uTangent * k) * r, center + (v - vTangent * k) * r,
+                      center + v * r);
+        u = v;
+    }
+}
+
+/*
+ *  Cap the end of a contour at end, whose normal there is n: from end + n * r round to
+ *  end - n * r.
+ */
+template <typename Sink> void cap_to(Sink* sink, GStroker::Cap cap, GPoint end, GVector n,
+                                     float r) {
+    const GVector out = forward(n);
+    switch (cap) {
+        case GStroker::kButt_Cap:
+            sink->lineTo(end - n * r);
+            break;
+        case GStroker::kRound_Cap:
+            arc_to(sink, end, n, out, r);
+            arc_to(sink, end, out, n * -1, r);
+            break;
+        case GStroker::kSquare_Cap:
+            sink->lineTo(end + (n + out) * r);
+            sink->lineTo(end + (out - n) * r);
+            sink->lineTo(end - n * r);
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GStroker::Side::reset(GPoint start) {
+    fVerbs.clear();
+    fPts.clear();
+    fPts.push_back(start);
+}
+
+void GStroker::Side::lineTo(GPoint p) {
+    fVerbs.push_back(GPath::kLine);
+    fPts.push_back(p);
+}
+
+void GStroker::Side::quadTo(GPoint p1, GPoint p2) {
+    fVerbs.push_back(GPath::kQuad);
+    fPts.push_back(p1);
+    fPts.push_back(p2);
+}
+
+void GStroker::Side::cubicTo(GPoint p1, GPoint p2, GPoint p3) {
+    fVerbs.push_back(GPath::kCubic);
+    fPts.push_back(p1);
+    fPts.push_back(p2);
+    fPts.push_back(p3);
+}
+
+void GStroker::Side::appendForward(GPath* dst, bool moveTo) const {
+    const GPoint* p = fPts.data();
+    if (moveTo) {
+        dst->moveTo(p[0]);
+    } else {
+        dst->lineTo(p[0]);
+    }
+    p += 1;
+    for (GPath::Verb verb : fVerbs) {
+        switch (verb) {
+            case GPath::kLine:  dst->lineTo(p[0]);              p += 1; break;
+            case GPath::kQuad:  dst->quadTo(p[0], p[1]);        p += 2; break;
+            case GPath::kCubic: dst->cubicTo(p[0], p[1], p[2]); p += 3; break;
+            default: break;
+        }
+    }
+}
+
+void GStroker::Side::appendBackward(GPath* dst, bool moveTo) const {
+    const GPoint* p = fPts.data() + fPts.size() - 1;
+    if (moveTo) {
+        dst->moveTo(p[0]);
+    } else {
+        dst->lineTo(p[0]);
+    }
+    for (auto verb = fVerbs.rbegin(); verb != fVerbs.rend(); ++verb) {
+        switch (*verb) {
+            case GPath::kLine:  dst->lineTo(p[-1]);                 p -= 1; break;
+            case GPath::kQuad:  dst->quadTo(p[-1], p[-2]);          p -= 2; break;
+            case GPath::kCubic: dst->cubicTo(p[-1], p[-2], p[-3]);  p -= 3; break;
+            default: break;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GStroker::StrokeLine(GPoint p0, GPoint p1, float width, bool roundCap, GPath* dst) {
+    GPath line;
+    line.moveTo(p0).lineTo(p1);
+    GStroker stroker(width, kMiter_Join, roundCap ? kRound_Cap : kButt_Cap);
+    stroker.strokePath(line, dst);
+}
+
+void GStroker::strokePath(const GPath& src, GPath* dst) {
+    if (!(fRadius > 0)) {
+        return;
+    }
+    bool inContour = false;
+    GPoint pts[4];
+    GPath::Iter iter(src);
+    for (GPath::Verb v = iter.next(pts); v != GPath::kDone; v = iter.next(pts)) {
+        switch (v) {
+            case GPath::kMove:
+                if (inContour) {
+                    this->finishContour(dst);
+                }
+                inContour = true;
+                fStarted = fHasSegment = false;
+                fFirstPt = fPrevPt = pts[0];
+                break;
+            case GPath::kLine:  this->lineTo(pts[1]); break;
+            case GPath::kQuad:  this->quadTo(pts);    break;
+            case GPath::kCubic: this->cubicTo(pts);   break;
+            case GPath::kDone:  break;
+        }
+    }
+    if (inContour) {
+        this->finishContour(dst);
+    }
+}
+
+/*
+ *  Every contour written to dst ends with a line back to its start, since drawPath only closes
+ *  contours whose last segment is a line.
+ */
+void GStroker::finishContour(GPath* dst) {
+    const float r = fRadius;
+    if (!fStarted) {
+        // Only zero-length segments: round and square caps still draw a dot
+        if (fHasSegment && fCap != kButt_Cap) {
+            const GVector n = { 0, -1 };
+            dst->moveTo(fFirstPt + n * r);
+            cap_to(dst, fCap, fFirstPt, n, r);
+            cap_to(dst, fCap, fFirstPt, n * -1, r);
+            dst->lineTo(fFirstPt + n * r);
+        }
+        return;
+    }
+
+    if (fPrevPt == fFirstPt) {
+        this->join(fFirstPt, fPrevNormal, fFirstNormal);
+        fLeft.appendForward(dst, true);
+        dst->lineTo(fLeft.fPts[0]);
+        fRight.appendBackward(dst, true);
+        dst->lineTo(fRight.last());
+    } else {
+        cap_to(&fLeft, fCap, fPrevPt, fPrevNormal, r);
+        fLeft.appendForward(dst, true);
+        fRight.appendBackward(dst, false);
+        cap_to(dst, fCap, fFirstPt, fFirstNormal * -1, r);
+        dst->lineTo(fLeft.fPts[0]);
+    }
+}
+
+/*
+ *  Called with where each segment starts and its normal there: begins the sides, or joins them
+ *  to the previous segment.
+ */
+void GStroker::startSegment(GPoint p, GVector normal) {
+    if (!fStarted) {
+        fLeft.reset(p + normal * fRadius);
+        fRight.reset(p - normal * fRadius);
+        fFirstNormal = normal;
+        fStarted = true;
+    } else {
+        this->join(p, fPrevNormal, normal);
+    }
+}
+
+/*
+ *  The outer side (the one the contour turns away from) gets the join. The inner side goes
+ *  through the pivot, which keeps it inside the stroke however sharp the turn is.
+ */
+void GStroker::join(GPoint pivot, GVector before, GVector after) {
+    const float r = fRadius;
+    const float turn = cross(before, after);
+    if (dot(before, after) > 0 && fabsf(turn) < 1e-4f) {
+        fLeft.lineTo(pivot + after * r);
+        fRight.lineTo(pivot - after * r);
+        return;
+    }
+    // A positive turn is toward the left side (the way the normal points), leaving the right
+    // side outside
+    Side* outer = &fRight;
+    Side* inner = &fLeft;
+    float sign = -1;
+    if (turn < 0) {
+        std::swap(outer, inner);
+        sign = 1;
+    }
+    const GVector a = before * sign, b = after * sign;
+
+    inner->lineTo(pivot);
+    inner->lineTo(pivot - b * r);
+
+    switch (fJoin) {
+        case kRound_Join:
+            arc_to(outer, pivot, a, b, r);
+            return;
+        case kMiter_Join: {
+            // the miter reaches 1 / cos(half the turn) radii from the pivot
+            const float cosine = dot(a, b);
+            if (1 + cosine > 0 && 2 / (1 + cosine) <= fMiterLimit * fMiterLimit) {
+                outer->lineTo(pivot + (a + b) * (r / (1 + cosine)));
+            }
+            outer->lineTo(pivot + b * r);
+            return;
+        }
+        case kBevel_Join:
+            outer->lineTo(pivot + b * r);
+            return;
+    }
+}
+
+void GStroker::lineTo(GPoint p) {
+    fHasSegment = true;
+    GVector normal;
+    if (!unit_normal(p - fPrevPt, &normal)) {
+        return;
+    }
+    this->startSegment(fPrevPt, normal);
+    fLeft.lineTo(p + normal * fRadius);
+    fRight.lineTo(p - normal * fRadius);
+    fPrevPt = p;
+    fPrevNormal = normal;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+static GPoint lerp(GPoint a, GPoint b, float t) {
+    return a + (b - a) * t;
+}
+
+static GPoint eval_quad(const GPoint pts[3], float t) {
+    return lerp(lerp(pts[0], pts[1], t), lerp(pts[1], pts[2], t), t);
+}
+
+static GPoint eval_cubic(const GPoint pts[4], float t) {
+    const GPoint a = lerp(pts[0], pts[1], t), b = lerp(pts[1], pts[2], t);
+    const GPoint c = lerp(pts[2], pts[3], t);
+    return lerp(lerp(a, b, t), lerp(b, c, t), t);
+}
+
+static void chop_quad(const GPoint src[3], GPoint dst[5]) {
+    dst[0] = src[0];
+    dst[1] = lerp(src[0], src[1], 0.5f);
+    dst[3] = lerp(src[1], src[2], 0.5f);
+    dst[2] = lerp(dst[1], dst[3], 0.5f);
+    dst[4] = src[2];
+}
+
+static void chop_cubic(const GPoint src[4], GPoint dst[7]) {
+    const GPoint ab = lerp(src[0], src[1], 0.5f), bc = lerp(src[1], src[2], 0.5f);
+    const GPoint cd = lerp(src[2], src[3], 0.5f);
+    dst[0] = src[0];
+    dst[1] = ab;
+    dst[2] = lerp(ab, bc, 0.5f);
+    dst[4] = lerp(bc, cd, 0.5f);
+    dst[3] = lerp(dst[2], dst[4], 0.5f);
+    dst[5] = cd;
+    dst[6] = src[3];
+}
+
+/*
+ *  The first of the vectors from a to the later points that has a length: the direction a
+ *  curve leaves a in, even if its first control points are on top of it.
+ */
+static GVector tangent(GPoint a, const GPoint later[], int count) {
+    for (int i = 0; i < count; ++i) {
+        if (later[i] != a) {
+            return later[i] - a;
+        }
+    }
+    return { 0, 0 };
+}
+
+// The unit normal of a curve where its derivative is d, or zero at a cusp.
+static GVector curve_normal(GVector d) {
+    GVector n = { 0, 0 };
+    unit_normal(d, &n);
+    return n;
+}
+
+/*
+ *  Where the line through a in direction u meets the line through b in direction v, or the
+ *  midpoint of a and b if they are parallel.
+ */
+static GPoint intersect(GPoint a, GVector u, GPoint b, GVector v) {
+    const float denom = cross(u, v);
+    if (fabsf(denom) < 1e-6f * u.length() * v.length()) {
+        return lerp(a, b, 0.5f);
+    }
+    return a + u * (cross(b - a, v) / denom);
+}
+
+void GStroker::quadTo(const GPoint pts[3]) {
+    fHasSegment = true;
+    const GPoint fromEnd[2] = { pts[1], pts[0] };
+    GVector startNormal, endNormal;
+    if (!unit_normal(tangent(pts[0], pts + 1, 2), &startNormal) ||
+        !unit_normal(tangent(pts[2], fromEnd, 2) * -1, &endNormal)) {
+        return;
+    }
+    this->startSegment(pts[0], startNormal);
+    this->offsetQuad(pts, 0);
+    fPrevPt = pts[2];
+    fPrevNormal = endNormal;
+}
+
+/*
+ *  Each side is offset as one quad: its end points moved out along the normals, and its control
+ *  point where the moved end tangents cross. If that strays more than kTolerance from the true
+ *  offset at the middle of the curve, on either side, both halves are offset instead.
+ */
+void GStroker::offsetQuad(const GPoint pts[3], int depth) {
+    const GPoint fromEnd[2] = { pts[1], pts[0] };
+    const GVector t0 = tangent(pts[0], pts + 1, 2);
+    const GVector t1 = tangent(pts[2], fromEnd, 2) * -1;
+    const GVector n0 = curve_normal(t0), n1 = curve_normal(t1);
+    const GVector nMid = curve_normal(pts[2] - pts[0]);
+    const GPoint mid = eval_quad(pts, 0.5f);
+
+    GPoint ctrl[2];
+    bool close = true;
+    for (int s = 0; s < 2; ++s) {
+        const float r = s ? -fRadius : fRadius;
+        const GPoint a = pts[0] + n0 * r, c = pts[2] + n1 * r;
+        ctrl[s] = intersect(a, t0, c, t1);
+        const GPoint approx = lerp(lerp(a, ctrl[s], 0.5f), lerp(ctrl[s], c, 0.5f), 0.5f);
+        close &= ((mid + nMid * r) - approx).length() <= kTolerance;
+    }
+    if (!close && depth < kMaxOffsetDepth) {
+        GPoint halves[5];
+        chop_quad(pts, halves);
+        this->offsetQuad(halves, depth + 1);
+        this->offsetQuad(halves + 2, depth + 1);
+        return;
+    }
+    fLeft.quadTo(ctrl[0], pts[2] + n1 * fRadius);
+    fRight.quadTo(ctrl[1], pts[2] - n1 * fRadius);
+}
+
+void GStroker::cubicTo(const GPoint pts[4]) {
+    fHasSegment = true;
+    const GPoint fromEnd[3] = { pts[2], pts[1], pts[0] };
+    GVector startNormal, endNormal;
+    if (!unit_normal(tangent(pts[0], pts + 1, 3), &startNormal) ||
+        !unit_normal(tangent(pts[3], fromEnd, 3) * -1, &endNormal)) {
+        return;
+    }
+    this->startSegment(pts[0], startNormal);
+    this->offsetCubic(pts, 0);
+    fPrevPt = pts[3];
+    fPrevNormal = endNormal;
+}
+
+/*
+ *  As offsetQuad, but the handles are kept as they are, moved with their end points, and the
+ *  result is checked at a quarter, half and three quarters of the way along.
+ */
+void GStroker::offsetCubic(const GPoint pts[4], int depth) {
+    const GPoint fromEnd[3] = { pts[2], pts[1], pts[0] };
+    const GVector n0 = curve_normal(tangent(pts[0], pts + 1, 3));
+    const GVector n3 = curve_normal(tangent(pts[3], fromEnd, 3) * -1);
+
+    GPoint sides[2][4];
+    bool close = true;
+    for (int s = 0; s < 2; ++s) {
+        const float r = s ? -fRadius : fRadius;
+        GPoint* o = sides[s];
+        o[0] = pts[0] + n0 * r;
+        o[3] = pts[3] + n3 * r;
+        o[1] = o[0] + (pts[1] - pts[0]);
+        o[2] = o[3] + (pts[2] - pts[3]);
+        for (float t : { 0.25f, 0.5f, 0.75f }) {
+            // derivative of the curve at t, up to a factor of 3
+            const float u = 1 - t;
+            const GVector d = (pts[1] - pts[0]) * (u * u) + (pts[2] - pts[1]) * (2 * t * u) +
+                              (pts[3] - pts[2]) * (t * t);
+            const GPoint offset = eval_cubic(pts, t) + curve_normal(d) * r;
+            close &= (offset - eval_cubic(o, t)).length() <= kTolerance;
+        }
+    }
+    if (!close && depth < kMaxOffsetDepth) {
+        GPoint halves[7];
+        chop_cubic(pts, halves);
+        this->offsetCubic(halves, depth + 1);
+        this->offsetCubic(halves + 3, depth + 1);
+        return;
+    }
+    fLeft.cubicTo(sides[0][1], sides[0][2], sides[0][3]);
+    fRight.cubicTo(sides[1][1], sides[1][2], sides[1][3]);
+}
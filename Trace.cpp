@@ -0,0 +1,105 @@
+#include "GTrace.h"
+
+#ifdef G_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+namespace {
+
+struct Event {
+    const char* category;
+    const char* name;
+    int64_t     start;      // nanoseconds since gEpoch
+    int64_t     duration;
+};
+
+/*
+ * One thread's events. Only that thread writes them; count is published with release so a
+ * dump (acquire) sees every event it counts.
+ */
+struct ThreadBuffer {
+    int                   tid;
+    std::atomic<uint64_t> count;    // events ever recorded; the last kEventsPerThread are kept
+    std::unique_ptr<Event[]> events;
+
+    ThreadBuffer(int tid) : tid(tid), count(0), events(new Event[GTrace::kEventsPerThread]) {}
+};
+
+const auto gEpoch = std::chrono::steady_clock::now();
+
+// Buffers outlive their threads, so a dump after a worker has finished still has its events.
+std::mutex gBuffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> gBuffers;
+
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - gEpoch).count();
+}
+
+// Taking the lock only happens the first time each thread records.
+ThreadBuffer* this_thread_buffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(gBuffersMutex);
+        gBuffers.emplace_back(new ThreadBuffer((int)gBuffers.size() + 1));
+        buffer = gBuffers.back().get();
+    }
+    return buffer;
+}
+
+}  // namespace
+
+GTrace::Scope::Scope(const char* category, const char* name)
+    : fCategory(category), fName(name), fStart(now_ns()) {}
+
+GTrace::Scope::~Scope() {
+    ThreadBuffer* buffer = this_thread_buffer();
+    const uint64_t n = buffer->count.load(std::memory_order_relaxed);
+    buffer->events[n % kEventsPerThread] = { fCategory, fName, fStart, now_ns() - fStart };
+    buffer->count.store(n + 1, std::memory_order_release);
+}
+
+bool GTrace::WriteJSON(const char path[]) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(gBuffersMutex);
+    fprintf(f, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto& buffer : gBuffers) {
+        const uint64_t count = buffer->count.load(std::memory_order_acquire);
+        const uint64_t begin = count > (uint64_t)kEventsPerThread ? count - kEventsPerThread : 0;
+        for (uint64_t i = begin; i < count; ++i) {
+            const Event& e = buffer->events[i % kEventsPerThread];
+            fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                       "\"pid\":1,\"tid\":%d}", first ? "" : ",\n", e.name, e.category,
+                    e.start * 1e-3, e.duration * 1e-3, buffer->tid);
+            first = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+void GTrace::Reset() {
+    std::lock_guard<std::mutex> lock(gBuffersMutex);
+    for (const auto& buffer : gBuffers) {
+        buffer->count.store(0, std::memory_order_release);
+    }
+}
+
+#else
+
+GTrace::Scope::Scope(const char*, const char*) {}
+GTrace::Scope::~Scope() {}
+
+bool GTrace::WriteJSON(const char[]) { return false; }
+void GTrace::Reset() {}
+
+#endif
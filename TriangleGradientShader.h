@@ -83,6 +83,11 @@ public:
      return;
    }
 
+   // Copies share the colors and points, which never change after construction.
+   virtual std::unique_ptr<GShader> clone() const {
+       return std::unique_ptr<GShader>(new TriangleGradientShader(*this));
+   }
+
 private:
   GColor* fColors;
   GMatrix fLocalMatrix;
@@ -0,0 +1,340 @@
+/*
+ *  Copyright 2017 Mike Reed
+ */
+
+#ifndef GDifferential_DEFINED
+#define GDifferential_DEFINED
+
+#include "GBitmap.h"
+#include "GCanvas.h"
+#include "GPath.h"
+#include "GPixel.h"
+#include "GRandom.h"
+#include "GShader.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdlib.h>
+#include <vector>
+
+/**
+ *  Draws random scenes (from a seed) into a GBackend::kOptimized canvas and a
+ *  GBackend::kReference one, comparing their pixels after every op, to check the fast paths
+ *  against the general code they stand in for.
+ *
+ *  Ops cover every draw (with random blend modes, colors, shaders, anti-aliasing and batch
+ *  colors) and the state calls: save/restore, concat (axis-aligned or not), clips and layers.
+ *  Both canvases get exactly the same calls: each op draws its parameters from a GRandom seeded
+ *  for it, once per canvas.
+ */
+class GDifferential {
+public:
+    struct Result {
+        int         fMaxDiff;       // largest difference in any channel, after any op
+        int         fFirstOp;       // index of the first op that left a pixel over the
+                                    // tolerance, or -1 if none did
+        const char* fFirstOpName;
+        int         fFirstX, fFirstY;           // a pixel that op left over the tolerance
+        GPixel      fOptimized, fReference;     // and its value in each canvas
+    };
+
+    /**
+     *  Scenes are width x height. Pixels match if no channel differs by more than tolerance
+     *  (0 demands exact matches).
+     */
+    GDifferential(int width, int height, int tolerance = 0)
+        : fWidth(width), fHeight(height), fTolerance(tolerance) {
+        fOptimized.alloc(width, height);
+        fReference.alloc(width, height);
+    }
+
+    ~GDifferential() {
+        free(fOptimized.pixels());
+        free(fReference.pixels());
+    }
+
+    const GBitmap& optimized() const { return fOptimized; }
+    const GBitmap& reference() const { return fReference; }
+
+    /**
+     *  Draw the scene for seed, of opCount ops, both ways. Returns true if every pixel matched
+     *  after every op.
+     */
+    bool run(uint32_t seed, int opCount, Result* result) {
+        *result = { 0, -1, nullptr, 0, 0, 0, 0 };
+        clear(fOptimized);
+        clear(fReference);
+        auto optimized = GCreateCanvas(fOptimized, GBackend::kOptimized);
+        auto reference = GCreateCanvas(fReference, GBackend::kReference);
+
+        GRandom rand(seed);
+        int optimizedDepth = 0, referenceDepth = 0;
+        for (int i = 0; i <= opCount; ++i) {
+            // The last op unwinds whatever saves and layers are still open.
+            const uint32_t opSeed = rand.nextU();
+            const char* name = i < opCount ? this->drawOp(opSeed, optimized.get(),
+                                                          &optimizedDepth) : "restore all";
+            if (i < opCount) {
+                this->drawOp(opSeed, reference.get(), &referenceDepth);
+            } else {
+                for (; optimizedDepth > 0; --optimizedDepth) {
+                    optimized->restore();
+                }
+                for (; referenceDepth > 0; --referenceDepth) {
+                    reference->restore();
+                }
+            }
+            this->compare(i, name, result);
+        }
+        return result->fFirstOp < 0;
+    }
+
+private:
+    int     fWidth, fHeight;
+    int     fTolerance;
+    GBitmap fOptimized, fReference;
+
+    static void clear(const GBitmap& bitmap) {
+        for (int y = 0; y < bitmap.height(); ++y) {
+            std::fill_n(bitmap.getAddr(0, y), bitmap.width(), 0);
+        }
+    }
+
+    void compare(int op, const char name[], Result* result) const {
+        for (int y = 0; y < fHeight; ++y) {
+            const GPixel* a = fOptimized.getAddr(0, y);
+            const GPixel* b = fReference.getAddr(0, y);
+            for (int x = 0; x < fWidth; ++x) {
+                if (a[x] == b[x]) {
+                    continue;
+                }
+                const int diff = std::max({ abs(GPixel_GetA(a[x]) - GPixel_GetA(b[x])),
+                                            abs(GPixel_GetR(a[x]) - GPixel_GetR(b[x])),
+                                            abs(GPixel_GetG(a[x]) - GPixel_GetG(b[x])),
+                                            abs(GPixel_GetB(a[x]) - GPixel_GetB(b[x])) });
+                result->fMaxDiff = std::max(result->fMaxDiff, diff);
+                if (diff > fTolerance && result->fFirstOp < 0) {
+                    *result = { result->fMaxDiff, op, name, x, y, a[x], b[x] };
+                }
+            }
+        }
+    }
+
+    // Somewhere in or a little around the device.
+    GPoint randomPoint(GRandom& rand) const {
+        return { (rand.nextF() * 1.4f - 0.2f) * fWidth, (rand.nextF() * 1.4f - 0.2f) * fHeight };
+    }
+
+    GRect randomRect(GRandom& rand) const {
+        const GPoint a = this->randomPoint(rand), b = this->randomPoint(rand);
+        return GRect::MakeLTRB(std::min(a.x(), b.x()), std::min(a.y(), b.y()),
+                               std::max(a.x(), b.x()), std::max(a.y(), b.y()));
+    }
+
+    static GColor randomColor(GRandom& rand) {
+        const float a = rand.nextRange(0, 2) ? 1 : rand.nextF();
+        return GColor::MakeARGB(a, rand.nextF(), rand.nextF(), rand.nextF());
+    }
+
+    // A convex polygon: points at increasing angles around an ellipse.
+    void randomConvex(GRandom& rand, std::vector<GPoint>* pts) const {
+        const GPoint center = this->randomPoint(rand);
+        const float rx = rand.nextF() * fWidth * 0.5f, ry = rand.nextF() * fHeight * 0.5f;
+        const int count = rand.nextRange(3, 8);
+        std::vector<float> angles;
+        for (int i = 0; i < count; ++i) {
+            angles.push_back(rand.nextF() * 6.2831853f);
+        }
+        std::sort(angles.begin(), angles.end());
+        pts->clear();
+        for (float angle : angles) {
+            pts->push_back({ center.x() + rx * cosf(angle), center.y() + ry * sinf(angle) });
+        }
+    }
+
+    void randomPath(GRandom& rand, GPath* path) const {
+        if (rand.nextRange(0, 2) == 0) {
+            std::vector<GPoint> pts;
+            this->randomConvex(rand, &pts);
+            path->addPolygon(pts.data(), (int)pts.size());
+            return;
+        }
+        const int contours = rand.nextRange(1, 3);
+        for (int c = 0; c < contours; ++c) {
+            path->moveTo(this->randomPoint(rand));
+            const int segments = rand.nextRange(1, 5);
+            for (int s = 0; s < segments; ++s) {
+                switch (rand.nextRange(0, 2)) {
+                    case 0:
+                        path->lineTo(this->randomPoint(rand));
+                        break;
+                    case 1: {
+                        const GPoint p1 = this->randomPoint(rand), p2 = this->randomPoint(rand);
+                        path->quadTo(p1, p2);
+                    } break;
+                    default: {
+                        const GPoint p1 = this->randomPoint(rand), p2 = this->randomPoint(rand);
+                        const GPoint p3 = this->randomPoint(rand);
+                        path->cubicTo(p1, p2, p3);
+                    } break;
+                }
+            }
+        }
+    }
+
+    // The paint's shader, if it has one, is kept in shader until the op is done.
+    GPaint randomPaint(GRandom& rand, std::unique_ptr<GShader>* shader) const {
+        GPaint paint(randomColor(rand));
+        paint.setBlendMode((GBlendMode)rand.nextRange(0, (int)GBlendMode::kXor));
+        paint.setAntiAlias(rand.nextRange(0, 1) == 1);
+        if (rand.nextRange(0, 3) == 0) {
+            const GColor colors[3] = { randomColor(rand), randomColor(rand), randomColor(rand) };
+            const GPoint p0 = this->randomPoint(rand), p1 = this->randomPoint(rand);
+            *shader = GCreateLinearGradient(p0, p1, colors, 3,
+                                            (GShader::TileMode)rand.nextRange(0, 2));
+            paint.setShader(shader->get());
+        }
+        return paint;
+    }
+
+    // Draw one op from seed into canvas, keeping depth (the saves it has open) up to date.
+    const char* drawOp(uint32_t seed, GCanvas* canvas, int* depth) const {
+        GRandom rand(seed);
+        std::unique_ptr<GShader> shader;
+        const GPaint paint = this->randomPaint(rand, &shader);
+        std::vector<GPoint> pts;
+        std::vector<GColor> colors;
+
+        switch (rand.nextRange(0, 17)) {
+            case 0:
+                if (paint.getColor().fA < 1 || paint.getShader()) {
+                    canvas->drawPaint(paint);
+                    return "drawPaint";
+                }
+                // An opaque drawPaint hides everything so far: draw a rect instead.
+                // fall through
+            case 1:
+            case 2:
+                canvas->drawRect(this->randomRect(rand), paint);
+                return "drawRect";
+            case 3:
+                this->randomConvex(rand, &pts);
+                canvas->drawConvexPolygon(pts.data(), (int)pts.size(), paint);
+                return "drawConvexPolygon";
+            case 4:
+            case 5: {
+                GPath path;
+                this->randomPath(rand, &path);
+                canvas->drawPath(path, paint);
+                return "drawPath";
+            }
+            case 6: {
+                const GRect r = this->randomRect(rand);
+                canvas->drawRoundRect(r, rand.nextF() * r.width(), rand.nextF() * r.height(),
+                                      paint);
+                return "drawRoundRect";
+            }
+            case 7: {
+                const int count = rand.nextRange(2, 5);
+                for (int i = 0; i < count; ++i) {
+                    pts.push_back(this->randomPoint(rand));
+                }
+                const float widths[] = { 0, 0.5f, 1, 1.5f, 3, 8 };
+                canvas->drawPolyline(pts.data(), count, widths[rand.nextRange(0, 5)], paint);
+                return "drawPolyline";
+            }
+            case 8: {
+                const int count = rand.nextRange(1, 6);
+                std::vector<GRect> rects;
+                for (int i = 0; i < count; ++i) {
+                    rects.push_back(this->randomRect(rand));
+                    colors.push_back(randomColor(rand));
+                }
+                canvas->drawRects(rects.data(), count, paint,
+                                  rand.nextRange(0, 1) ? colors.data() : nullptr);
+                return "drawRects";
+            }
+            case 9: {
+                const int polyCount = rand.nextRange(1, 4);
+                std::vector<GPoint> all;
+                std::vector<int> counts;
+                for (int i = 0; i < polyCount; ++i) {
+                    this->randomConvex(rand, &pts);
+                    all.insert(all.end(), pts.begin(), pts.end());
+                    counts.push_back((int)pts.size());
+                    colors.push_back(randomColor(rand));
+                }
+                canvas->drawConvexPolygons(all.data(), counts.data(), polyCount, paint,
+                                           rand.nextRange(0, 1) ? colors.data() : nullptr);
+                return "drawConvexPolygons";
+            }
+            case 10: {
+                const int count = rand.nextRange(1, 8);
+                for (int i = 0; i < count; ++i) {
+                    pts.push_back(this->randomPoint(rand));
+                    colors.push_back(randomColor(rand));
+                }
+                canvas->drawPoints(pts.data(), count, 1 + rand.nextF() * 10, paint,
+                                   rand.nextRange(0, 1) ? colors.data() : nullptr);
+                return "drawPoints";
+            }
+            case 11: {
+                const int triangles = rand.nextRange(1, 4);
+                for (int i = 0; i < triangles * 3; ++i) {
+                    pts.push_back(this->randomPoint(rand));
+                    colors.push_back(randomColor(rand));
+                }
+                canvas->drawMesh(pts.data(), rand.nextRange(0, 1) ? colors.data() : nullptr,
+                                 nullptr, nullptr, triangles, paint);
+                return "drawMesh";
+            }
+            case 12:
+            case 13: {
+                canvas->save();
+                *depth += 1;
+                const float cx = fWidth * 0.5f, cy = fHeight * 0.5f;
+                canvas->translate(cx, cy);
+                if (rand.nextRange(0, 1)) {
+                    canvas->rotate(rand.nextF() * 6.2831853f);
+                } else if (rand.nextRange(0, 1)) {
+                    canvas->concat(GMatrix(0, 1, 0, 1, 0, 0));   // swap x and y
+                }
+                canvas->scale(0.5f + rand.nextF(), 0.5f + rand.nextF());
+                canvas->translate(-cx, -cy);
+                return "concat";
+            }
+            case 14:
+                if (*depth > 0) {
+                    canvas->restore();
+                    *depth -= 1;
+                    return "restore";
+                }
+                canvas->save();
+                *depth += 1;
+                return "save";
+            case 15:
+                canvas->save();
+                *depth += 1;
+                canvas->clipRect(this->randomRect(rand));
+                return "clipRect";
+            case 16: {
+                GPath path;
+                this->randomPath(rand, &path);
+                canvas->save();
+                *depth += 1;
+                canvas->clipPath(path);
+                return "clipPath";
+            }
+            default: {
+                const GRect bounds = this->randomRect(rand);
+                GPaint layerPaint(GColor::MakeARGB(1, 0, 0, 0));
+                layerPaint.setBlendMode((GBlendMode)rand.nextRange(0, (int)GBlendMode::kXor));
+                canvas->saveLayer(rand.nextRange(0, 1) ? &bounds : nullptr, layerPaint);
+                *depth += 1;
+                return "saveLayer";
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,343 @@
+/*
+ *  Copyright 2017 Mike Reed
+ */
+
+#ifndef GOverdrawCanvas_DEFINED
+#define GOverdrawCanvas_DEFINED
+
+#include "GBitmap.h"
+#include "GPixel.h"
+#include "GProxyCanvas.h"
+#include "GShader.h"
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+/**
+ *  Draws through to another canvas (the real rasterizer), while counting how many times each
+ *  device pixel is written.
+ *
+ *  Every draw is also drawn, with a plain opaque paint, into a private probe bitmap the size of
+ *  the device, so the pixels counted are exactly the ones the rasterizer covers. A pixel is
+ *  hidden once a later draw replaces it (an opaque paint at full coverage, drawn outside any
+ *  layer): whatever was written there before never shows, and is charged to the draw that wrote
+ *  it. Draws inside a layer write the layer, not the device, so the layer's composite on
+ *  restore() counts as one more draw ("saveLayer") and they are counted only there.
+ *
+ *  This is a diagnostic: each draw costs a pass over the whole probe bitmap.
+ */
+class GOverdrawCanvas : public GProxyCanvas {
+public:
+    struct Op {
+        int         fIndex;     // order in the frame, from 0
+        const char* fName;      // the canvas method, e.g. "drawRect"
+        int64_t     fPixels;    // pixels it wrote
+        int64_t     fHidden;    // of those, how many a later draw replaced
+    };
+
+    struct Report {
+        int64_t fPixels;            // width * height
+        int64_t fVisible;           // pixels written at least once
+        int64_t fWrites;            // pixel writes, over every draw
+        int64_t fHidden;            // writes that a later draw replaced
+        int     fMaxOverdraw;       // most writes to one pixel
+        float   fAverageOverdraw;   // writes per device pixel
+        float   fWritesPerVisible;  // writes per pixel written at least once
+        std::vector<Op> fWorst;     // draws with the most hidden pixels, most first
+    };
+
+    /**
+     *  proxy does the real drawing, into a device of width x height.
+     */
+    GOverdrawCanvas(GCanvas* proxy, int width, int height)
+        : GProxyCanvas(proxy), fWidth(width), fHeight(height) {
+        fProbe.alloc(width, height);
+        fProbeCanvas = GCreateCanvas(fProbe);
+        this->reset();
+    }
+
+    ~GOverdrawCanvas() override { free(fProbe.pixels()); }
+
+    /**
+     *  Forget the counts, starting a new frame. The canvas state (CTM, clip) is unchanged.
+     */
+    void reset() {
+        fCounts.assign((size_t)fWidth * fHeight, 0);
+        fTop.assign((size_t)fWidth * fHeight, -1);
+        fWrites.clear();
+        fFree = -1;
+        fOps.clear();
+    }
+
+    /**
+     *  Summarize the frame so far, listing (at most) the worstCount draws that wrote the most
+     *  hidden pixels.
+     */
+    void getReport(Report* report, int worstCount = 10) const {
+        report->fPixels = (int64_t)fWidth * fHeight;
+        report->fVisible = report->fWrites = report->fHidden = 0;
+        report->fMaxOverdraw = 0;
+        for (int count : fCounts) {
+            report->fVisible += count > 0;
+            report->fWrites += count;
+            report->fMaxOverdraw = std::max(report->fMaxOverdraw, count);
+        }
+        for (const Op& op : fOps) {
+            report->fHidden += op.fHidden;
+        }
+        report->fAverageOverdraw = report->fPixels ?
+                                   (float)report->fWrites / report->fPixels : 0;
+        report->fWritesPerVisible = report->fVisible ?
+                                    (float)report->fWrites / report->fVisible : 0;
+
+        report->fWorst.clear();
+        for (const Op& op : fOps) {
+            if (op.fHidden > 0) {
+                report->fWorst.push_back(op);
+            }
+        }
+        std::stable_sort(report->fWorst.begin(), report->fWorst.end(),
+                         [](const Op& a, const Op& b) { return a.fHidden > b.fHidden; });
+        if ((int)report->fWorst.size() > worstCount) {
+            report->fWorst.resize(std::max(0, worstCount));
+        }
+    }
+
+    /**
+     *  Set heatmap to a new opaque bitmap (its pixels allocated with malloc, for the caller to
+     *  free) coloring each pixel by its write count: black for none, then blue, green, yellow,
+     *  orange, and red for 5 or more.
+     */
+    void makeHeatmap(GBitmap* heatmap) const {
+        static const GPixel kRamp[] = {
+            GPixel_PackARGB(0xFF, 0x00, 0x00, 0x00),
+            GPixel_PackARGB(0xFF, 0x20, 0x40, 0xFF),
+            GPixel_PackARGB(0xFF, 0x20, 0xC0, 0x20),
+            GPixel_PackARGB(0xFF, 0xFF, 0xE0, 0x00),
+            GPixel_PackARGB(0xFF, 0xFF, 0x80, 0x00),
+            GPixel_PackARGB(0xFF, 0xFF, 0x00, 0x00),
+        };
+        const int kLast = sizeof(kRamp) / sizeof(kRamp[0]) - 1;
+
+        heatmap->alloc(fWidth, fHeight);
+        heatmap->setIsOpaque(GBitmap::kYes_IsOpaque);
+        for (int y = 0; y < fHeight; ++y) {
+            GPixel* row = heatmap->getAddr(0, y);
+            for (int x = 0; x < fWidth; ++x) {
+                row[x] = kRamp[std::min(fCounts[y * fWidth + x], kLast)];
+            }
+        }
+    }
+
+    void save() override {
+        GProxyCanvas::save();
+        fProbeCanvas->save();
+        fLayers.push_back(LayerRec(false, nullptr));
+    }
+
+    void restore() override {
+        GProxyCanvas::restore();
+        fProbeCanvas->restore();
+        const LayerRec rec = fLayers.back();
+        fLayers.pop_back();
+        if (rec.fIsLayer) {
+            // The probe is back in the saveLayer's state, so its bounds map as they did then.
+            if (rec.fHasBounds) {
+                fProbeCanvas->drawRect(rec.fBounds, probe_paint());
+            } else {
+                fProbeCanvas->drawPaint(probe_paint());
+            }
+            this->countOp("saveLayer", false);
+        }
+    }
+
+    void concat(const GMatrix& m) override {
+        GProxyCanvas::concat(m);
+        fProbeCanvas->concat(m);
+    }
+
+    void clipRect(const GRect& r) override {
+        GProxyCanvas::clipRect(r);
+        fProbeCanvas->clipRect(r);
+    }
+
+    void clipPath(const GPath& p) override {
+        GProxyCanvas::clipPath(p);
+        fProbeCanvas->clipPath(p);
+    }
+
+    void drawPaint(const GPaint& p) override {
+        GProxyCanvas::drawPaint(p);
+        fProbeCanvas->drawPaint(probe_paint());
+        this->countOp("drawPaint", replaces(p));
+    }
+
+    void drawRect(const GRect& r, const GPaint& p) override {
+        GProxyCanvas::drawRect(r, p);
+        fProbeCanvas->drawRect(r, probe_paint());
+        this->countOp("drawRect", replaces(p));
+    }
+
+    void drawConvexPolygon(const GPoint pts[], int count, const GPaint& p) override {
+        GProxyCanvas::drawConvexPolygon(pts, count, p);
+        fProbeCanvas->drawConvexPolygon(pts, count, probe_paint());
+        this->countOp("drawConvexPolygon", replaces(p));
+    }
+
+    void drawPath(const GPath& path, const GPaint& paint) override {
+        GProxyCanvas::drawPath(path, paint);
+        fProbeCanvas->drawPath(path, probe_paint());
+        this->countOp("drawPath", replaces(paint));
+    }
+
+    void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                  const int indices[], int triangleCount, const GPaint& paint) override {
+        GProxyCanvas::drawMesh(verts, colors, texs, indices, triangleCount, paint);
+        fProbeCanvas->drawMesh(verts, nullptr, nullptr, indices, triangleCount, probe_paint());
+        // Per-vertex colors may be translucent, so only a plain mesh replaces what's under it.
+        this->countOp("drawMesh", !colors && replaces(paint));
+    }
+
+    void drawRoundRect(const GRect& r, float rx, float ry, const GPaint& paint) override {
+        GProxyCanvas::drawRoundRect(r, rx, ry, paint);
+        fProbeCanvas->drawRoundRect(r, rx, ry, probe_paint(paint.isAntiAlias()));
+        this->countOp("drawRoundRect", replaces(paint));
+    }
+
+    void drawLine(GPoint p0, GPoint p1, float width, const GPaint& paint) override {
+        GProxyCanvas::drawLine(p0, p1, width, paint);
+        fProbeCanvas->drawLine(p0, p1, width, probe_paint(paint.isAntiAlias()));
+        this->countOp("drawLine", replaces(paint));
+    }
+
+    void drawPolyline(const GPoint pts[], int count, float width, const GPaint& paint) override {
+        GProxyCanvas::drawPolyline(pts, count, width, paint);
+        fProbeCanvas->drawPolyline(pts, count, width, probe_paint(paint.isAntiAlias()));
+        this->countOp("drawPolyline", replaces(paint));
+    }
+
+protected:
+    void onSaveLayer(const GRect* bounds, const GPaint& paint) override {
+        GProxyCanvas::onSaveLayer(bounds, paint);
+        fProbeCanvas->save();
+        fLayers.push_back(LayerRec(true, bounds));
+    }
+
+private:
+    // What a save() or saveLayer() needs at its restore().
+    struct LayerRec {
+        bool  fIsLayer;
+        bool  fHasBounds;
+        GRect fBounds;
+
+        LayerRec(bool isLayer, const GRect* bounds)
+            : fIsLayer(isLayer), fHasBounds(bounds != nullptr)
+            , fBounds(bounds ? *bounds : GRect::MakeWH(0, 0)) {}
+    };
+
+    // One write to a pixel that no later draw has replaced yet. A pixel's writes are a list,
+    // newest first, through below.
+    struct Write {
+        int fOp;
+        int fBelow;     // the write before it, or -1
+    };
+
+    int fWidth, fHeight;
+    GBitmap fProbe;
+    std::unique_ptr<GCanvas> fProbeCanvas;
+    std::vector<LayerRec> fLayers;
+
+    std::vector<int>   fCounts;     // writes per pixel
+    std::vector<int>   fTop;        // each pixel's newest write, or -1
+    std::vector<Write> fWrites;     // replaced writes are reused, through fFree
+    int                fFree;
+    std::vector<Op>    fOps;
+
+    // Writes every pixel the draw covers, so they can be told from the (zero) untouched ones.
+    static GPaint probe_paint(bool antiAlias = false) {
+        GPaint paint({1, 1, 1, 1});
+        paint.setBlendMode(GBlendMode::kSrc);
+        paint.setAntiAlias(antiAlias);
+        return paint;
+    }
+
+    /*
+     *  True if every pixel this paint covers ends up independent of what was there before.
+     */
+    static bool replaces(const GPaint& paint) {
+        switch (paint.getBlendMode()) {
+            case GBlendMode::kClear:
+            case GBlendMode::kSrc:
+                return true;
+            case GBlendMode::kSrcOver:
+                if (paint.getFilter()) {
+                    return false;
+                }
+                if (paint.getShader()) {
+                    return paint.getShader()->isOpaque();
+                }
+                return paint.getColor().fA >= 1;
+            default:
+                return false;
+        }
+    }
+
+    bool inLayer() const {
+        for (const LayerRec& rec : fLayers) {
+            if (rec.fIsLayer) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Record the draw just made into the probe, and clear the probe for the next one.
+    void countOp(const char name[], bool replacesDst) {
+        if (this->inLayer()) {
+            // Only the layer's composite reaches the device.
+            for (int y = 0; y < fHeight; ++y) {
+                std::fill_n(fProbe.getAddr(0, y), fWidth, 0);
+            }
+            return;
+        }
+        const int index = (int)fOps.size();
+        Op op = { index, name, 0, 0 };
+        for (int y = 0; y < fHeight; ++y) {
+            GPixel* row = fProbe.getAddr(0, y);
+            for (int x = 0; x < fWidth; ++x) {
+                if (!row[x]) {
+                    continue;
+                }
+                const int i = y * fWidth + x;
+                const bool covers = replacesDst && GPixel_GetA(row[x]) == 0xFF;
+                row[x] = 0;
+                op.fPixels += 1;
+                fCounts[i] += 1;
+
+                int below = fTop[i];
+                if (covers) {
+                    while (below >= 0) {
+                        Write& w = fWrites[below];
+                        fOps[w.fOp].fHidden += 1;
+                        const int next = w.fBelow;
+                        w.fBelow = fFree;
+                        fFree = below;
+                        below = next;
+                    }
+                }
+                int w = fFree;
+                if (w >= 0) {
+                    fFree = fWrites[w].fBelow;
+                } else {
+                    w = (int)fWrites.size();
+                    fWrites.push_back(Write());
+                }
+                fWrites[w] = { index, below };
+                fTop[i] = w;
+            }
+        }
+        fOps.push_back(op);
+    }
+};
+
+#endif
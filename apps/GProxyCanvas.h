@@ -6,6 +6,7 @@
 #define GProxyCanvas_DEFINED
 
 #include "GCanvas.h"
+#include "GShader.h"
 
 class GProxyCanvas : public GCanvas {
 public:
@@ -16,6 +17,33 @@ public:
     void save() override { if (fProxy) fProxy->save(); }
     void restore() override { if (fProxy) fProxy->restore(); }
     void concat(const GMatrix& m) override { if (fProxy) fProxy->concat(m); }
+    void clipRect(const GRect& r) override { if (fProxy) fProxy->clipRect(r); }
+    void clipPath(const GPath& p) override { if (fProxy) fProxy->clipPath(p); }
+
+    bool getStats(GStats* frame, GStats* lastDraw) const override {
+        return fProxy && fProxy->getStats(frame, lastDraw);
+    }
+    void resetStats() override { if (fProxy) fProxy->resetStats(); }
+
+    bool quickReject(const GRect& r) const override {
+        return fProxy ? fProxy->quickReject(r) : false;
+    }
+
+    // Not draws: scenes use these to build what they draw, so they always reach the proxy.
+    std::unique_ptr<GShader> final_createRadialGradient(GPoint center, float radius,
+                                                        const GColor colors[],
+                                                        int count) override {
+        return fProxy ? fProxy->final_createRadialGradient(center, radius, colors, count)
+                      : nullptr;
+    }
+    void final_addStrokedLine(GPath* path, GPoint p0, GPoint p1, float width,
+                              bool roundCap) override {
+        if (fProxy) fProxy->final_addStrokedLine(path, p0, p1, width, roundCap);
+    }
+    std::unique_ptr<GShader> final_createTriangleGradient(const GPoint pts[3],
+                                                          const GColor colors[3]) override {
+        return fProxy ? fProxy->final_createTriangleGradient(pts, colors) : nullptr;
+    }
 
     void drawPaint(const GPaint& p) override {
         if (this->allowDraw()) {
@@ -41,6 +69,31 @@ public:
         }
     }
 
+    void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                  const int indices[], int triangleCount, const GPaint& paint) override {
+        if (this->allowDraw()) {
+            fProxy->drawMesh(verts, colors, texs, indices, triangleCount, paint);
+        }
+    }
+
+    void drawRoundRect(const GRect& r, float rx, float ry, const GPaint& paint) override {
+        if (this->allowDraw()) {
+            fProxy->drawRoundRect(r, rx, ry, paint);
+        }
+    }
+
+    void drawLine(GPoint p0, GPoint p1, float width, const GPaint& paint) override {
+        if (this->allowDraw()) {
+            fProxy->drawLine(p0, p1, width, paint);
+        }
+    }
+
+    void drawPolyline(const GPoint pts[], int count, float width, const GPaint& paint) override {
+        if (this->allowDraw()) {
+            fProxy->drawPolyline(pts, count, width, paint);
+        }
+    }
+
 protected:
     void onSaveLayer(const GRect* bounds, const GPaint& paint) override {
         if (fProxy) { fProxy->saveLayer(bounds, paint); }
@@ -18,15 +18,24 @@ GWindow::GWindow(int width, int height) {
     fClick = NULL;
     fWidth = width;
     fHeight = height;
-
-    this->setupBitmap(width, height);
-    fCanvas = GCreateCanvas(fBitmap);
+    fNeedDraw = false;
+    fDamage = GIRect::MakeWH(width, height);
+    fRenderer = nullptr;
+    fTexture = nullptr;
 
     uint32_t flags = SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL;
     fWindow = SDL_CreateWindow("An SDL2 window",
                                SDL_WINDOWPOS_UNDEFINED,
                                SDL_WINDOWPOS_UNDEFINED,
                                width, height, flags);
+    if (!fWindow) {
+        // the dummy/offscreen video drivers may not offer GL, but can still present through the
+        // software renderer
+        fWindow = SDL_CreateWindow("An SDL2 window",
+                                   SDL_WINDOWPOS_UNDEFINED,
+                                   SDL_WINDOWPOS_UNDEFINED,
+                                   width, height, flags & ~SDL_WINDOW_OPENGL);
+    }
     if (!fWindow) {
         printf("Can't create window: %s\n", SDL_GetError());
         return;
@@ -42,7 +51,16 @@ GWindow::GWindow(int width, int height) {
 }
 
 GWindow::~GWindow() {
-    free(fBitmap.pixels());
+    fCanvas.reset();
+    if (fTexture) {
+        SDL_DestroyTexture(fTexture);
+    }
+    if (fRenderer) {
+        SDL_DestroyRenderer(fRenderer);
+    }
+    if (fWindow) {
+        SDL_DestroyWindow(fWindow);
+    }
 }
 
 void GWindow::setTitle(const char title[]) {
@@ -59,6 +77,21 @@ void GWindow::pushEvent(int code) const {
 }
 
 void GWindow::requestDraw() {
+    this->invalidate(GIRect::MakeWH(fWidth, fHeight));
+}
+
+void GWindow::invalidate(const GIRect& r) {
+    if (r.isEmpty()) {
+        return;
+    }
+    if (fDamage.isEmpty()) {
+        fDamage = r;
+    } else {
+        fDamage.setLTRB(std::min(fDamage.left(),   r.left()),
+                        std::min(fDamage.top(),    r.top()),
+                        std::max(fDamage.right(),  r.right()),
+                        std::max(fDamage.bottom(), r.bottom()));
+    }
     if (!fNeedDraw) {
         fNeedDraw = true;
         this->pushEvent(42);
@@ -75,14 +108,15 @@ bool GWindow::handleEvent(const SDL_Event& evt) {
                     fHeight = evt.window.data2;
                     this->onResize(fWidth, fHeight);
 
+                    // the canvas points into the old texture, so drop it along with the texture
+                    fCanvas.reset();
+                    fBitmap.reset();
                     SDL_DestroyTexture(fTexture);
                     fTexture = SDL_CreateTexture(fRenderer,
                                                  SDL_PIXELFORMAT_ARGB8888,
                                                  SDL_TEXTUREACCESS_STREAMING,
                                                  fWidth, fHeight);
-
-                    this->setupBitmap(fWidth, fHeight);
-                    fCanvas = GCreateCanvas(fBitmap);
+                    fDamage = GIRect::MakeWH(fWidth, fHeight);
                     fNeedDraw = true;
                     return true;
             }
@@ -136,14 +170,6 @@ bool GWindow::handleEvent(const SDL_Event& evt) {
     return false;
 }
 
-void GWindow::setupBitmap(int w, int h) {
-    if (fBitmap.pixels()) {
-        free(fBitmap.pixels());
-    }
-    size_t rb = w * sizeof(GPixel);
-    fBitmap.reset(w, h, rb, (GPixel*)calloc(h, rb), GBitmap::kNo_IsOpaque);
-}
-
 static SDL_Rect make(const GIRect& r) {
     return { r.x(), r.y(), r.width(), r.height() };
 }
@@ -162,6 +188,58 @@ void GWindow::onUpdate(const GBitmap& bitmap, GCanvas* canvas) {
     this->onDraw(canvas);
 }
 
+/*
+ *  Lock only the damaged part of the texture and draw into it in place: the locked memory is
+ *  the canvas's bitmap, so there is no staging copy, and unlocking uploads just that rect.
+ */
+void GWindow::drawDamage() {
+    GIRect damage = fDamage;
+    fDamage = GIRect::MakeWH(0, 0);
+    if (!damage.intersect(GIRect::MakeWH(fWidth, fHeight))) {
+        return;
+    }
+
+    SDL_Rect rect = make(damage);
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(fTexture, &rect, &pixels, &pitch) != 0) {
+        printf("Can't lock texture: %s\n", SDL_GetError());
+        return;
+    }
+
+    // Streaming textures usually hand back the same memory for the same rect, so keep the
+    // canvas (and its state stacks) until the lock moves.
+    GBitmap bitmap(damage.width(), damage.height(), pitch, (GPixel*)pixels, false);
+    if (!fCanvas || bitmap.pixels() != fBitmap.pixels() || bitmap.rowBytes() != fBitmap.rowBytes()
+            || bitmap.width() != fBitmap.width() || bitmap.height() != fBitmap.height()) {
+        fBitmap = bitmap;
+        fCanvas = GCreateCanvas(fBitmap);
+    }
+
+    fCanvas->save();
+    fCanvas->translate(-(float)damage.left(), -(float)damage.top());
+    this->onUpdate(fBitmap, fCanvas.get());
+    fCanvas->restore();
+
+    SDL_UnlockTexture(fTexture);
+}
+
+bool GWindow::presentFrame() {
+    if (!fWindow) {
+        return false;
+    }
+
+    if (fNeedDraw) {
+        fNeedDraw = false;  // clear this before we call onDraw
+        this->drawDamage();
+    }
+    SDL_RenderCopy(fRenderer, fTexture, nullptr, nullptr);
+    this->onDrawOverlays();
+
+    SDL_RenderPresent(fRenderer);
+    return true;
+}
+
 int GWindow::run() {
     if (!fWindow) {
         return -1;
@@ -172,16 +250,7 @@ int GWindow::run() {
     SDL_Event e;
     while (SDL_WaitEvent(&e) && e.type != SDL_QUIT) {
         this->handleEvent(e);
-
-        if (fNeedDraw) {
-            fNeedDraw = false;  // clear this before we call onDraw
-            this->onUpdate(fBitmap, fCanvas.get());
-            SDL_UpdateTexture(fTexture, nullptr, fBitmap.pixels(), fBitmap.rowBytes());
-        }
-        SDL_RenderCopy(fRenderer, fTexture, nullptr, nullptr);
-        this->onDrawOverlays();
-
-        SDL_RenderPresent(fRenderer);
+        this->presentFrame();
     }
     return 0;
 }
@@ -10,10 +10,10 @@
 
 #include "GBitmap.h"
 #include "GPoint.h"
+#include "GRect.h"
 
 class GCanvas;
 class GClick;
-class GIRect;
 
 class GWindow {
 public:
@@ -21,10 +21,30 @@ public:
 
     void requestDraw();
 
+    /**
+     *  Mark part of the window as needing a redraw. The next frame calls onDraw with the
+     *  canvas clipped to the union of everything invalidated since the last frame, and uploads
+     *  only that area. requestDraw() invalidates the whole window.
+     */
+    void invalidate(const GIRect&);
+
+    /**
+     *  Redraw any pending damage straight into the window's streaming texture and present it.
+     *  Returns false if the window could not be created. run() calls this for every event;
+     *  headless drivers (e.g. SDL_VIDEODRIVER=dummy) can call it directly to step frames.
+     */
+    bool presentFrame();
+
 protected:
     GWindow(int initial_width, int initial_height);
     virtual ~GWindow();
 
+    /**
+     *  The bitmap wraps just the damaged part of the texture being redrawn (its rowBytes is the
+     *  texture's pitch), and the canvas is translated so that window coordinates land on it and
+     *  clipped to the damage. Their previous contents are undefined, so every damaged pixel
+     *  must be drawn.
+     */
     virtual void onUpdate(const GBitmap&, GCanvas*);
     virtual void onDraw(GCanvas*) {}
     virtual void onResize(int w, int h) {}
@@ -42,8 +62,9 @@ protected:
 private:
     GClick*     fClick;
     
-    GBitmap fBitmap;
+    GBitmap fBitmap;    // the texture memory fCanvas was created on, valid only while locked
     std::unique_ptr<GCanvas> fCanvas;
+    GIRect fDamage;     // texture area still to be redrawn and uploaded
     int fWidth;
     int fHeight;
     bool fNeedDraw;
@@ -55,7 +76,7 @@ private:
     uint32_t fInvalEventType;
 
     bool handleEvent(const SDL_Event&);
-    void setupBitmap(int w, int h);
+    void drawDamage();
     void pushEvent(int code) const;
 };
 
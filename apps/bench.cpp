@@ -5,9 +5,18 @@
 #include "bench.h"
 #include "GCanvas.h"
 #include "GBitmap.h"
+#include "GOverdrawCanvas.h"
+#include "GStats.h"
 #include "GTime.h"
+#include "GTrace.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -31,53 +40,54 @@ static bool mk_dir(const char path[]) {
     return true;
 }
 
-static int pixel_diff(GPixel p0, GPixel p1) {
-    int da = abs(GPixel_GetA(p0) - GPixel_GetA(p1));
-    int dr = abs(GPixel_GetR(p0) - GPixel_GetR(p1));
-    int dg = abs(GPixel_GetG(p0) - GPixel_GetG(p1));
-    int db = abs(GPixel_GetB(p0) - GPixel_GetB(p1));
-    return std::max(da, std::max(dr, std::max(dg, db)));
-}
-
-static double compare(const GBitmap& a, const GBitmap& b, int tolerance, bool verbose) {
-    GASSERT(a.width() == b.width());
-    GASSERT(a.height() == b.height());
+/////////////////////////////////////////////////////////////////////////////////////////////////
 
-    const int total = a.width() * a.height() * 255;
+static void setup_bitmap(GBitmap* bitmap, int w, int h) {
+    size_t rb = w * sizeof(GPixel);
+    bitmap->reset(w, h, rb, (GPixel*)calloc(h, rb), GBitmap::kNo_IsOpaque);
+}
 
-    const GPixel* rowA = a.pixels();
-    const GPixel* rowB = b.pixels();
+/*
+ *  Timings of one bench, in milliseconds per draw.
+ */
+struct BenchStats {
+    double fMin, fMedian, fP90, fMean, fStdDev;
+    int    fLoops;      // draws per sample
+    int    fSamples;
+    bool   fCounted;    // fCounts holds the canvas's counters for one draw
+    GStats fCounts;
+};
 
-    int total_diff = 0;
-    int max_diff = 0;
+struct BenchOptions {
+    int    fSamples = 15;
+    int    fWarmups = 2;        // samples run and thrown away before timing
+    double fSampleMS = 5;       // each sample draws for at least this long
+    bool   fForever = false;
+    bool   fStats = false;      // print the canvas's counters for one draw
+    int    fMaxThreads = 0;     // if > 0, time 1 to this many canvases drawing at once instead
+};
 
-    for (int y = 0; y < a.height(); ++y) {
-        for (int x = 0; x < a.width(); ++x) {
-            int diff = pixel_diff(rowA[x], rowB[x]) - tolerance;
-            if (diff > 0) {
-                total_diff += diff;
-                max_diff = std::max(max_diff, diff);
-            }
-        }
-        rowA = (const GPixel*)((const char*)rowA + a.rowBytes());
-        rowB = (const GPixel*)((const char*)rowB + b.rowBytes());
-    }
-    
-    double score = 1.0 * (total - total_diff) / total;
-    if (verbose) {
-        printf("    - score %d, max_diff %d\n", (int)(score * 100), max_diff);
+// Draw loops times, returning the elapsed milliseconds.
+static double time_draws(GBenchmark* bench, GCanvas* canvas, int loops) {
+    const GNSec start = GTime::GetNSec();
+    for (int i = 0; i < loops; ++i) {
+        bench->draw(canvas);
     }
-    return score;
+    return (GTime::GetNSec() - start) * 1e-6;
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
-
-static void setup_bitmap(GBitmap* bitmap, int w, int h) {
-    size_t rb = w * sizeof(GPixel);
-    bitmap->reset(w, h, rb, (GPixel*)calloc(h, rb), GBitmap::kNo_IsOpaque);
+// The value at fraction p of the way through sorted (nearest rank).
+static double percentile(const std::vector<double>& sorted, double p) {
+    const int rank = (int)ceil(p * sorted.size());
+    return sorted[std::max(0, std::min((int)sorted.size() - 1, rank - 1))];
 }
 
-static double handle_proc(GBenchmark* bench, const char path[], GBitmap* bitmap, bool forever) {
+/*
+ *  Calibrate how many draws make up a sample (doubling until one takes opts.fSampleMS), warm
+ *  up, then time opts.fSamples samples.
+ */
+static bool handle_proc(GBenchmark* bench, GBitmap* bitmap, const BenchOptions& opts,
+                        BenchStats* stats) {
     GISize size = bench->size();
     setup_bitmap(bitmap, size.fWidth, size.fHeight);
 
@@ -85,16 +95,195 @@ static double handle_proc(GBenchmark* bench, const char path[], GBitmap* bitmap,
     if (!canvas) {
         fprintf(stderr, "failed to create canvas for [%d %d] %s\n",
                 size.fWidth, size.fHeight, bench->name());
-        return 0;
+        return false;
+    }
+
+    if (opts.fForever) {
+        for (;;) {
+            bench->draw(canvas.get());
+        }
+    }
+
+    int loops = 1;
+    while (time_draws(bench, canvas.get(), loops) < opts.fSampleMS && loops < (1 << 24)) {
+        loops *= 2;
+    }
+    for (int i = 0; i < opts.fWarmups; ++i) {
+        time_draws(bench, canvas.get(), loops);
     }
 
-    const int N = 100;
-    GMSec now = GTime::GetMSec();
-    for (int i = 0; i < N || forever; ++i) {
+    std::vector<double> samples;
+    for (int i = 0; i < opts.fSamples; ++i) {
+        samples.push_back(time_draws(bench, canvas.get(), loops) / loops);
+    }
+    std::sort(samples.begin(), samples.end());
+
+
+    double sum = 0;
+    for (double v : samples) {
+        sum += v;
+    }
+    const double mean = sum / samples.size();
+    double squares = 0;
+    for (double v : samples) {
+        squares += (v - mean) * (v - mean);
+    }
+    stats->fMin = samples.front();
+    stats->fMedian = percentile(samples, 0.5);
+    stats->fP90 = percentile(samples, 0.9);
+    stats->fMean = mean;
+    stats->fStdDev = sqrt(squares / std::max<size_t>(1, samples.size() - 1));
+    stats->fLoops = loops;
+    stats->fSamples = (int)samples.size();
+    stats->fCounted = false;
+    stats->fCounts = GStats();
+    if (opts.fStats) {
+        canvas->resetStats();
         bench->draw(canvas.get());
+        stats->fCounted = canvas->getStats(&stats->fCounts, nullptr);
+    }
+    return true;
+}
+
+/*
+ *  Time threadCount threads each drawing its own instance of the bench into its own canvas, all
+ *  at once, for duration milliseconds. Returns the device pixels drawn per second, over all of
+ *  them.
+ */
+static double time_parallel(GBenchmark::Factory factory, int threadCount, double duration) {
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<double> pixelsPerSec(threadCount);
+
+    auto drawLoop = [&](int index) {
+        std::unique_ptr<GBenchmark> bench(factory());
+        const GISize size = bench->size();
+        GBitmap bitmap;
+        setup_bitmap(&bitmap, size.fWidth, size.fHeight);
+        auto canvas = GCreateCanvas(bitmap);
+        bench->draw(canvas.get());      // warm up (caches, first-use allocations)
+
+        // Start together, so every thread's window overlaps the others'.
+        ready += 1;
+        while (!go) {
+            std::this_thread::yield();
+        }
+        const GNSec start = GTime::GetNSec();
+        const GNSec end = start + (GNSec)(duration * 1e6);
+        long long draws = 0;
+        GNSec now;
+        do {
+            bench->draw(canvas.get());
+            draws += 1;
+        } while ((now = GTime::GetNSec()) < end);
+        pixelsPerSec[index] = (double)draws * size.fWidth * size.fHeight / ((now - start) * 1e-9);
+        free(bitmap.pixels());
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(drawLoop, i);
+    }
+    while (ready < threadCount) {
+        std::this_thread::yield();
+    }
+    go = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    double total = 0;
+    for (double p : pixelsPerSec) {
+        total += p;
+    }
+    return total;
+}
+
+/*
+ *  Print the bench's throughput with 1 to opts.fMaxThreads independent canvases drawing at
+ *  once, one per thread, and its scaling efficiency: the throughput over n times that of one
+ *  thread. Each count draws for the time the normal mode spends sampling.
+ */
+static void report_scaling(GBenchmark::Factory factory, const char name[],
+                           const BenchOptions& opts) {
+    const double duration = std::max(20.0, opts.fSampleMS * opts.fSamples);
+    double single = 0;
+    for (int n = 1; n <= opts.fMaxThreads; ++n) {
+        const double throughput = time_parallel(factory, n, duration);
+        if (n == 1) {
+            single = throughput;
+        }
+        printf("parallel: %s %d %.2f %.2f\n", name, n, throughput * 1e-6,
+               single > 0 ? throughput / (n * single) : 0);
     }
-    GMSec dur = GTime::GetMSec() - now;
-    return dur * 1.0 / N;
+}
+
+/*
+ *  Draw the bench once, counting its overdraw, and print the summary and the draws that wrote
+ *  the most hidden pixels. If dir is not null, write the heatmap there as name.png.
+ */
+static void report_overdraw(GBenchmark* bench, const char dir[]) {
+    GISize size = bench->size();
+    GBitmap bitmap;
+    setup_bitmap(&bitmap, size.fWidth, size.fHeight);
+    auto canvas = GCreateCanvas(bitmap);
+    GOverdrawCanvas overdraw(canvas.get(), size.fWidth, size.fHeight);
+    bench->draw(&overdraw);
+
+    GOverdrawCanvas::Report report;
+    overdraw.getReport(&report, 5);
+    printf("    - overdraw: average %.2f, max %d, %.2f writes per visible pixel, "
+           "%lld of %lld writes hidden\n", report.fAverageOverdraw, report.fMaxOverdraw,
+           report.fWritesPerVisible, (long long)report.fHidden, (long long)report.fWrites);
+    for (const GOverdrawCanvas::Op& op : report.fWorst) {
+        printf("        draw %d %s: %lld of %lld pixels hidden\n", op.fIndex, op.fName,
+               (long long)op.fHidden, (long long)op.fPixels);
+    }
+    if (dir) {
+        GBitmap heatmap;
+        overdraw.makeHeatmap(&heatmap);
+        std::string path = std::string(dir) + "/" + bench->name() + ".png";
+        if (!heatmap.writeToFile(path.c_str())) {
+            printf("----- can't write %s\n", path.c_str());
+        }
+        free(heatmap.pixels());
+    }
+    free(bitmap.pixels());
+}
+
+/*
+ *  Read the medians out of a file written by --json. Each bench is on its own line.
+ */
+static bool read_baseline(const char path[], std::map<std::string, BenchStats>* baseline) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "can't open baseline %s\n", path);
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        char name[256];
+        BenchStats s;
+        if (sscanf(line, " { \"name\": \"%255[^\"]\", \"min_ms\": %lf, \"median_ms\": %lf, "
+                         "\"p90_ms\": %lf, \"mean_ms\": %lf, \"stddev_ms\": %lf, \"loops\": %d, "
+                         "\"samples\": %d", name, &s.fMin, &s.fMedian, &s.fP90, &s.fMean,
+                   &s.fStdDev, &s.fLoops, &s.fSamples) == 8) {
+            (*baseline)[name] = s;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/*
+ *  A bench has regressed if its median grew by more than threshold (a fraction), or by more than
+ *  twice the spread of either run if that is larger, so noisy benches don't trip it.
+ */
+static bool is_regression(const BenchStats& base, const BenchStats& cur, double threshold,
+                          double* change) {
+    *change = cur.fMedian / base.fMedian - 1;
+    const double noise = 2 * std::max(base.fStdDev / base.fMedian, cur.fStdDev / cur.fMedian);
+    return *change > std::max(threshold, noise);
 }
 
 static bool is_arg(const char arg[], const char name[]) {
@@ -111,13 +300,42 @@ static bool is_arg(const char arg[], const char name[]) {
     return !strcmp(arg, shortVers);
 }
 
+/*
+ *  Prints "bench: name median" (milliseconds per draw) for each bench. Options:
+ *
+ *      --match str         only run benches whose names contain str
+ *      --samples n         timed samples per bench (default 15)
+ *      --duration ms       minimum time per sample, which sets the draws per sample (default 5)
+ *      --warmup n          untimed samples before timing (default 2)
+ *      --json file         write every bench's stats as JSON
+ *      --csv file          write every bench's stats as CSV
+ *      --baseline file     compare medians against a file written by --json, and exit with 1 if
+ *                          any bench regressed
+ *      --threshold pct     regressions smaller than this are noise (default 5)
+ *      --verbose           print every bench's stats
+ *      --gstats            print the canvas's counters (GStats) for one draw of each bench, if
+ *                          the library was built with G_STATS
+ *      --events file       write the last draws' trace events as Chrome trace JSON, if the
+ *                          library was built with G_TRACE
+ *      --overdraw dir      print each bench's overdraw (GOverdrawCanvas) for one draw, writing
+ *                          its heatmap into dir as name.png
+ *      --parallel n        instead of timing, print "parallel: name threads Mpixels/s efficiency"
+ *                          for 1 to n canvases drawing on their own threads (0 is every core)
+ *      --forever           draw the first matching bench until killed (for profiling)
+ */
 int main(int argc, char** argv) {
     bool verbose = false;
-    bool forever = false;
     const char* match = NULL;
     const char* report = NULL;
     const char* author = NULL;
     FILE* reportFile = NULL;
+    FILE* jsonFile = NULL;
+    FILE* csvFile = NULL;
+    const char* baselinePath = NULL;
+    const char* eventsPath = NULL;
+    const char* overdrawDir = NULL;
+    double threshold = 0.05;
+    BenchOptions opts;
 
     for (int i = 1; i < argc; ++i) {
         if (is_arg(argv[i], "report") && i+2 < argc) {
@@ -133,10 +351,57 @@ int main(int argc, char** argv) {
         } else if (is_arg(argv[i], "match") && i+1 < argc) {
             match = argv[++i];
         } else if (is_arg(argv[i], "forever")) {
-            forever = true;
+            opts.fForever = true;
+        } else if (is_arg(argv[i], "gstats")) {
+            opts.fStats = true;
+        } else if (is_arg(argv[i], "samples") && i+1 < argc) {
+            opts.fSamples = std::max(1, atoi(argv[++i]));
+        } else if (is_arg(argv[i], "duration") && i+1 < argc) {
+            opts.fSampleMS = std::max(0.0, atof(argv[++i]));
+        } else if (is_arg(argv[i], "warmup") && i+1 < argc) {
+            opts.fWarmups = std::max(0, atoi(argv[++i]));
+        } else if (is_arg(argv[i], "json") && i+1 < argc) {
+            if (!(jsonFile = fopen(argv[++i], "w"))) {
+                printf("----- can't open %s\n", argv[i]);
+                return -1;
+            }
+        } else if (is_arg(argv[i], "csv") && i+1 < argc) {
+            if (!(csvFile = fopen(argv[++i], "w"))) {
+                printf("----- can't open %s\n", argv[i]);
+                return -1;
+            }
+        } else if (is_arg(argv[i], "baseline") && i+1 < argc) {
+            baselinePath = argv[++i];
+        } else if (is_arg(argv[i], "threshold") && i+1 < argc) {
+            threshold = atof(argv[++i]) / 100;
+        } else if (is_arg(argv[i], "events") && i+1 < argc) {
+            eventsPath = argv[++i];
+        } else if (is_arg(argv[i], "parallel") && i+1 < argc) {
+            opts.fMaxThreads = atoi(argv[++i]);
+            if (opts.fMaxThreads <= 0) {
+                opts.fMaxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+            }
+        } else if (is_arg(argv[i], "overdraw") && i+1 < argc) {
+            overdrawDir = argv[++i];
+            if (!mk_dir(overdrawDir)) {
+                return -1;
+            }
         }
     }
 
+    std::map<std::string, BenchStats> baseline;
+    if (baselinePath && !read_baseline(baselinePath, &baseline)) {
+        return -1;
+    }
+    if (jsonFile) {
+        fprintf(jsonFile, "[\n");
+    }
+    if (csvFile) {
+        fprintf(csvFile, "name,min_ms,median_ms,p90_ms,mean_ms,stddev_ms,loops,samples\n");
+    }
+
+    int regressions = 0;
+    bool first = true;
     for (int i = 0; gBenchFactories[i]; ++i) {
         std::unique_ptr<GBenchmark> bench(gBenchFactories[i]());
         const char* name = bench->name();
@@ -147,12 +412,71 @@ int main(int argc, char** argv) {
         if (verbose) {
             printf("image: %s\n", name);
         }
+        if (opts.fMaxThreads > 0) {
+            report_scaling(gBenchFactories[i], name, opts);
+            continue;
+        }
         
         GBitmap testBM;
-        double dur = handle_proc(bench.get(), name, &testBM, forever);
-        printf("bench: %s %g\n", name, dur);
+        BenchStats s;
+        if (handle_proc(bench.get(), &testBM, opts, &s)) {
+            printf("bench: %s %g\n", name, s.fMedian);
+            if (verbose) {
+                printf("    - min %g, median %g, p90 %g, stddev %g (%d x %d draws)\n",
+                       s.fMin, s.fMedian, s.fP90, s.fStdDev, s.fSamples, s.fLoops);
+            }
+            if (s.fCounted) {
+                const GStats& c = s.fCounts;
+                printf("    - %lld draws, %lld edges, %lld spans, %lld pixels blended, "
+                       "%lld shaded, %lld layers (%lld bytes)\n", (long long)c.fDraws,
+                       (long long)c.fEdges, (long long)c.fSpans, (long long)c.fPixelsBlended,
+                       (long long)c.fPixelsShaded, (long long)c.fLayers,
+                       (long long)c.fLayerBytes);
+                printf("    - ms: edges %.3f, sort %.3f, shade %.3f, blend %.3f, "
+                       "composite %.3f\n", c.fEdgeNS * 1e-6, c.fSortNS * 1e-6,
+                       c.fShadeNS * 1e-6, c.fBlendNS * 1e-6, c.fCompositeNS * 1e-6);
+            }
+            if (overdrawDir) {
+                report_overdraw(bench.get(), overdrawDir);
+            }
+            if (jsonFile) {
+                fprintf(jsonFile, "%s  { \"name\": \"%s\", \"min_ms\": %.6g, \"median_ms\": %.6g, "
+                                  "\"p90_ms\": %.6g, \"mean_ms\": %.6g, \"stddev_ms\": %.6g, "
+                                  "\"loops\": %d, \"samples\": %d }",
+                        first ? "" : ",\n", name, s.fMin, s.fMedian, s.fP90, s.fMean, s.fStdDev,
+                        s.fLoops, s.fSamples);
+            }
+            if (csvFile) {
+                fprintf(csvFile, "%s,%.6g,%.6g,%.6g,%.6g,%.6g,%d,%d\n", name, s.fMin, s.fMedian,
+                        s.fP90, s.fMean, s.fStdDev, s.fLoops, s.fSamples);
+            }
+            first = false;
+
+            auto base = baseline.find(name);
+            if (base != baseline.end()) {
+                double change;
+                const bool regressed = is_regression(base->second, s, threshold, &change);
+                regressions += regressed;
+                printf("    - %g -> %g (%+.1f%%)%s\n", base->second.fMedian, s.fMedian,
+                       change * 100, regressed ? " REGRESSION" : "");
+            }
+        }
 
         free(testBM.pixels());
     }
-    return 0;
+
+    if (jsonFile) {
+        fprintf(jsonFile, "\n]\n");
+        fclose(jsonFile);
+    }
+    if (csvFile) {
+        fclose(csvFile);
+    }
+    if (eventsPath && !GTrace::WriteJSON(eventsPath)) {
+        printf("----- can't write trace events to %s (is G_TRACE defined?)\n", eventsPath);
+    }
+    if (baselinePath) {
+        printf("bench: %d regression%s\n", regressions, regressions == 1 ? "" : "s");
+    }
+    return regressions ? 1 : 0;
 }
@@ -6,9 +6,16 @@
 #include "GCanvas.h"
 #include "GBitmap.h"
 #include "GColor.h"
+#include "GFilter.h"
+#include "GMatrix.h"
+#include "GPath.h"
+#include "GPicture.h"
 #include "GRandom.h"
 #include "GRect.h"
+#include "GShader.h"
+#include "GStroker.h"
 #include <string>
+#include <vector>
 
 static GColor rand_color(GRandom& rand, bool forceOpaque = false) {
     GColor c { rand.nextF(), rand.nextF(), rand.nextF(), rand.nextF() };
@@ -119,7 +126,6 @@ public:
         tesselate_circle(circle, 100, 100, 100, fTiny ? 5 : 90);
 
         const int N = 500;
-        const GRect bounds = GRect::MakeLTRB(-10, -10, W + 10, H + 10);
         GRandom rand;
         for (int i = 0; i < N; ++i) {
             canvas->drawConvexPolygon(circle, 100, GPaint(rand_color(rand, true)));
@@ -127,6 +133,139 @@ public:
     }
 };
 
+/*
+ *  The large circle of CirclesBench as a path, which drawPath sees is convex, or the same
+ *  points as a 7-pointed star, which needs the general winding scan.
+ */
+class PathCirclesBench : public GBenchmark {
+    enum { W = 200, H = 200 };
+    const bool fStar;
+    GPath fPath;
+public:
+    PathCirclesBench(bool star) : fStar(star) {
+        GPoint circle[98];
+        tesselate_circle(circle, 98, 100, 100, 90);
+        if (star) {
+            GPoint star[98];
+            for (int i = 0; i < 98; ++i) {
+                star[i] = circle[i * 3 % 98];
+            }
+            fPath.addPolygon(star, 98);
+        } else {
+            fPath.addPolygon(circle, 98);
+        }
+    }
+
+    const char* name() const override { return fStar ? "path_stars" : "path_circles"; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        const int N = 500;
+        GRandom rand;
+        for (int i = 0; i < N; ++i) {
+            canvas->drawPath(fPath, GPaint(rand_color(rand, true)));
+        }
+    }
+};
+
+/*
+ *  Random dots and rounded boxes, as UIs and charts draw them.
+ */
+class RoundRectsBench : public GBenchmark {
+    enum { W = 200, H = 200 };
+    const bool fOval;
+    const bool fAntiAlias;
+public:
+    RoundRectsBench(bool oval, bool aa) : fOval(oval), fAntiAlias(aa) {}
+
+    const char* name() const override {
+        if (fOval) {
+            return fAntiAlias ? "ovals_aa" : "ovals";
+        }
+        return fAntiAlias ? "round_rects_aa" : "round_rects";
+    }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        const int N = 500;
+        const GRect bounds = GRect::MakeLTRB(-10, -10, W + 10, H + 10);
+        GRandom rand;
+        for (int i = 0; i < N; ++i) {
+            GPaint paint(rand_color(rand));
+            paint.setAntiAlias(fAntiAlias);
+            GRect rect = rand_rect(rand, bounds);
+            if (fOval) {
+                canvas->drawOval(rect, paint);
+            } else {
+                canvas->drawRoundRect(rect, 8, 6, paint);
+            }
+        }
+    }
+};
+
+/*
+ *  A chart: a polyline through N random points, as hairlines, anti-aliased hairlines or lines
+ *  1.5 wide.
+ */
+class LinesBench : public GBenchmark {
+    enum { W = 400, H = 200 };
+    const float fWidth;
+    const bool fAntiAlias;
+    const char* fName;
+    std::vector<GPoint> fPts;
+public:
+    LinesBench(float width, bool aa, const char name[])
+        : fWidth(width), fAntiAlias(aa), fName(name) {
+        GRandom rand;
+        const int N = 2000;
+        for (int i = 0; i < N; ++i) {
+            fPts.push_back({ (float)W * i / N, rand.nextF() * H });
+        }
+    }
+
+    const char* name() const override { return fName; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        GPaint paint({1, 0, 0, 1});
+        paint.setAntiAlias(fAntiAlias);
+        for (int i = 0; i < 10; ++i) {
+            canvas->drawPolyline(fPts.data(), (int)fPts.size(), fWidth, paint);
+        }
+    }
+};
+
+/*
+ *  Strokes a path of random lines, quads and cubics into a reused destination, then fills it.
+ */
+class StrokeBench : public GBenchmark {
+    enum { W = 400, H = 400 };
+    const GStroker::Join fJoin;
+    const char* fName;
+    GPath fSrc, fDst;
+public:
+    StrokeBench(GStroker::Join join, const char name[]) : fJoin(join), fName(name) {
+        GRandom rand;
+        auto pt = [&]() { return GPoint{ rand.nextF() * W, rand.nextF() * H }; };
+        fSrc.moveTo(pt());
+        for (int i = 0; i < 60; ++i) {
+            switch (i % 3) {
+                case 0: fSrc.lineTo(pt()); break;
+                case 1: fSrc.quadTo(pt(), pt()); break;
+                case 2: fSrc.cubicTo(pt(), pt(), pt()); break;
+            }
+        }
+    }
+
+    const char* name() const override { return fName; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        GStroker stroker(12, fJoin, GStroker::kRound_Cap);
+        for (int i = 0; i < 20; ++i) {
+            fDst.reset();
+            stroker.strokePath(fSrc, &fDst);
+        }
+        canvas->drawPath(fDst, GPaint({1, 0, 0.5f, 1}));
+    }
+};
+
 class ModesBench : public GBenchmark {
     enum { W = 200, H = 200 };
     const GColor fColor;
@@ -150,11 +289,310 @@ public:
     }
 };
 
+/*
+ *  The same rects as RectsBench, submitted as one drawRects call with per-rect colors.
+ */
+class BatchRectsBench : public GBenchmark {
+    enum { W = 200, H = 200, N = 500 };
+    const bool fForceOpaque;
+    std::vector<GRect>  fRects;
+    std::vector<GColor> fColors;
+public:
+    BatchRectsBench(bool forceOpaque) : fForceOpaque(forceOpaque) {
+        const GRect bounds = GRect::MakeLTRB(-10, -10, W + 10, H + 10);
+        GRandom rand;
+        for (int i = 0; i < N; ++i) {
+            fColors.push_back(rand_color(rand, fForceOpaque));
+            fRects.push_back(rand_rect(rand, bounds));
+        }
+    }
+
+    const char* name() const override {
+        return fForceOpaque ? "rects_opaque_batch" : "rects_blend_batch";
+    }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        canvas->drawRects(fRects.data(), N, GPaint(), fColors.data());
+    }
+};
+
+/*
+ *  Many tiny marks (e.g. a scatter plot), each with its own color.
+ */
+class MarksBench : public GBenchmark {
+    enum { W = 1000, H = 1000, N = 100000 };
+    const bool fBatched;
+    std::vector<GPoint> fPoints;
+    std::vector<GColor> fColors;
+public:
+    MarksBench(bool batched) : fBatched(batched) {
+        GRandom rand;
+        for (int i = 0; i < N; ++i) {
+            fPoints.push_back({ rand.nextF() * W, rand.nextF() * H });
+            fColors.push_back(rand_color(rand));
+        }
+    }
+
+    const char* name() const override { return fBatched ? "marks_batch" : "marks"; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        if (fBatched) {
+            canvas->drawPoints(fPoints.data(), N, 3, GPaint(), fColors.data());
+            return;
+        }
+        for (int i = 0; i < N; ++i) {
+            const GPoint& p = fPoints[i];
+            canvas->fillRect(GRect::MakeXYWH(p.x() - 1.5f, p.y() - 1.5f, 3, 3), fColors[i]);
+        }
+    }
+};
+
+/*
+ *  A jittered grid of small triangles (100k of them), with or without per-vertex colors.
+ */
+class MeshBench : public GBenchmark {
+    enum { W = 1000, H = 1000, COLS = 250, ROWS = 200 };
+    const bool fColored;
+    std::vector<GPoint> fVerts;
+    std::vector<GColor> fColors;
+    std::vector<int> fIndices;
+public:
+    MeshBench(bool colored) : fColored(colored) {
+        GRandom rand;
+        for (int j = 0; j <= ROWS; ++j) {
+            for (int i = 0; i <= COLS; ++i) {
+                fVerts.push_back({ (i + rand.nextF() * 0.5f) * W / COLS,
+                                   (j + rand.nextF() * 0.5f) * H / ROWS });
+                fColors.push_back(rand_color(rand));
+            }
+        }
+        for (int j = 0; j < ROWS; ++j) {
+            for (int i = 0; i < COLS; ++i) {
+                const int v = j * (COLS + 1) + i;
+                fIndices.insert(fIndices.end(), { v, v + 1, v + COLS + 2,
+                                                  v, v + COLS + 2, v + COLS + 1 });
+            }
+        }
+    }
+
+    const char* name() const override { return fColored ? "mesh_colors" : "mesh"; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        canvas->drawMesh(fVerts.data(), fColored ? fColors.data() : nullptr, nullptr,
+                         fIndices.data(), (int)fIndices.size() / 3, GPaint({1, 0, 0.5f, 1}));
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void draw_lion(GCanvas* canvas) {
+#include "lion.inc"
+}
+
+static void draw_cartman(GCanvas* canvas) {
+    GPath path;
+    GPaint paint;
+#include "cartman.475"
+}
+
+/*
+ *  The lion and cartman drawings from the image tests, drawn directly or played back from a
+ *  picture recorded once.
+ */
+class ContentBench : public GBenchmark {
+    enum { W = 512, H = 512 };
+    void (*fDraw)(GCanvas*);
+    const char* fName;
+    std::unique_ptr<GPicture> fPicture;
+public:
+    ContentBench(void (*draw)(GCanvas*), bool recorded, const char name[])
+        : fDraw(draw), fName(name) {
+        if (recorded) {
+            GRecordingCanvas recorder;
+            draw(&recorder);
+            fPicture = recorder.finishRecording();
+        }
+    }
+
+    const char* name() const override { return fName; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        canvas->clear({1, 1, 1, 1});
+        if (fPicture) {
+            fPicture->playback(canvas);
+        } else {
+            fDraw(canvas);
+        }
+    }
+};
+
+/*
+ *  Random closed paths of 20 cubics (or quads) each, which cross themselves.
+ */
+class CurvePathsBench : public GBenchmark {
+    enum { W = 500, H = 500, N = 50 };
+    const bool fCubic;
+    std::vector<GPath> fPaths;
+    std::vector<GColor> fColors;
+public:
+    CurvePathsBench(bool cubic) : fCubic(cubic) {
+        GRandom rand;
+        auto pt = [&]() { return GPoint{ rand.nextF() * W, rand.nextF() * H }; };
+        for (int i = 0; i < N; ++i) {
+            GPath path;
+            const GPoint start = pt();
+            path.moveTo(start);
+            for (int j = 0; j < 20; ++j) {
+                const GPoint end = (j == 19) ? start : pt();
+                if (fCubic) {
+                    path.cubicTo(pt(), pt(), end);
+                } else {
+                    path.quadTo(pt(), end);
+                }
+            }
+            fPaths.push_back(path);
+            fColors.push_back(rand_color(rand));
+        }
+    }
+
+    const char* name() const override { return fCubic ? "paths_cubic" : "paths_quad"; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        for (int i = 0; i < N; ++i) {
+            canvas->drawPath(fPaths[i], GPaint(fColors[i]));
+        }
+    }
+};
+
+/*
+ *  Fills the canvas with each kind of shader, rotated so bitmaps and gradients aren't sampled
+ *  along rows.
+ */
+class ShaderBench : public GBenchmark {
+public:
+    enum Kind { kBitmap, kLinear, kRadial, kTriangle };
+
+private:
+    enum { W = 400, H = 400 };
+    const char* fName;
+    const Kind fKind;
+    GBitmap fBitmap;
+    std::unique_ptr<GShader> fShader;   // made once, except the canvas's final_ gradients
+
+public:
+    ShaderBench(Kind kind, GShader::TileMode tile, const char name[])
+        : fName(name), fKind(kind) {
+        const GMatrix m = GMatrix().postRotate(M_PI / 7).postScale(3, 3);
+        if (kind == kBitmap) {
+            // a 64x64 checkerboard of translucent colors
+            const int S = 64;
+            fBitmap.reset(S, S, S * sizeof(GPixel), (GPixel*)malloc(S * S * sizeof(GPixel)),
+                          GBitmap::kNo_IsOpaque);
+            for (int y = 0; y < S; ++y) {
+                for (int x = 0; x < S; ++x) {
+                    *fBitmap.getAddr(x, y) = ((x ^ y) & 8) ? GPixel_PackARGB(0xFF, 0xFF, 0, 0)
+                                                          : GPixel_PackARGB(0x80, 0, 0x40, 0x80);
+                }
+            }
+            fShader = GCreateBitmapShader(fBitmap, m, tile);
+        } else if (kind == kLinear) {
+            const GColor colors[] = { {1, 1, 0, 0}, {0.5f, 0, 1, 0}, {1, 0, 0, 1} };
+            fShader = GCreateLinearGradient({100, 100}, {180, 160}, colors, 3, tile);
+        }
+    }
+    ~ShaderBench() override { free(fBitmap.pixels()); }
+
+    const char* name() const override { return fName; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        std::unique_ptr<GShader> made;
+        GShader* shader = fShader.get();
+        const GColor colors[] = { {1, 1, 0, 0}, {0.5f, 0, 1, 0}, {1, 0, 0, 1} };
+        if (fKind == kRadial) {
+            made = canvas->final_createRadialGradient({W / 2, H / 2}, W / 3, colors, 3);
+            shader = made.get();
+        } else if (fKind == kTriangle) {
+            const GPoint pts[] = { {-W, -H}, {2 * W, 0}, {0, 2 * H} };
+            made = canvas->final_createTriangleGradient(pts, colors);
+            shader = made.get();
+        }
+        for (int i = 0; i < 10; ++i) {
+            canvas->drawRect(GRect::MakeWH(W, H), GPaint(shader));
+        }
+    }
+};
+
+/*
+ *  Three nested layers, each composited with a filter (or just a blend mode), around some
+ *  translucent rects.
+ */
+class LayersBench : public GBenchmark {
+    enum { W = 400, H = 400 };
+    const bool fFiltered;
+    std::unique_ptr<GFilter> fFilters[3];
+public:
+    LayersBench(bool filtered) : fFiltered(filtered) {
+        if (filtered) {
+            fFilters[0] = GCreateBlendFilter(GBlendMode::kSrcIn, {0.5f, 1, 0, 0});
+            fFilters[1] = GCreateBlendFilter(GBlendMode::kDstOver, {1, 0, 0, 1});
+            fFilters[2] = GCreateBlendFilter(GBlendMode::kXor, {0.75f, 0, 1, 0});
+        }
+    }
+
+    const char* name() const override { return fFiltered ? "layers_filter" : "layers"; }
+    GISize size() const override { return { W, H }; }
+    void draw(GCanvas* canvas) override {
+        GRandom rand;
+        const GRect bounds = GRect::MakeWH(W, H);
+        for (int depth = 0; depth < 3; ++depth) {
+            GPaint paint;
+            paint.setBlendMode(depth == 1 ? GBlendMode::kSrcATop : GBlendMode::kSrcOver);
+            paint.setFilter(fFilters[depth].get());
+            const float inset = depth * 40.0f;
+            const GRect r = GRect::MakeLTRB(inset, inset, W - inset, H - inset);
+            canvas->saveLayer(&r, paint);
+            for (int i = 0; i < 20; ++i) {
+                canvas->fillRect(rand_rect(rand, bounds), rand_color(rand));
+            }
+        }
+        for (int depth = 0; depth < 3; ++depth) {
+            canvas->restore();
+        }
+    }
+};
+
+/*
+ *  The fill benches at display sizes: a background, then random rects across the canvas.
+ */
+class BigFillBench : public GBenchmark {
+    const GISize fSize;
+    const bool fForceOpaque;
+    std::string fName;
+public:
+    BigFillBench(GISize size, bool forceOpaque, const char label[])
+        : fSize(size), fForceOpaque(forceOpaque) {
+        fName = std::string(forceOpaque ? "fill_opaque_" : "fill_blend_") + label;
+    }
+
+    const char* name() const override { return fName.c_str(); }
+    GISize size() const override { return fSize; }
+    void draw(GCanvas* canvas) override {
+        const GRect bounds = GRect::MakeWH(fSize.fWidth, fSize.fHeight);
+        GRandom rand;
+        canvas->drawPaint(GPaint(rand_color(rand, true)));
+        for (int i = 0; i < 20; ++i) {
+            canvas->fillRect(rand_rect(rand, bounds), rand_color(rand, fForceOpaque));
+        }
+    }
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 const GBenchmark::Factory gBenchFactories[] {
     []() -> GBenchmark* { return new RectsBench(false); },
     []() -> GBenchmark* { return new RectsBench(true);  },
+    []() -> GBenchmark* { return new BatchRectsBench(false); },
+    []() -> GBenchmark* { return new BatchRectsBench(true);  },
     []() -> GBenchmark* {
         return new SingleRectBench({2,2}, GRect::MakeLTRB(-1000, -1000, 1002, 1002), "rect_big");
     },
@@ -166,9 +604,64 @@ const GBenchmark::Factory gBenchFactories[] {
     []() -> GBenchmark* { return new PolyRectsBench(true);  },
     []() -> GBenchmark* { return new CirclesBench(false); },
     []() -> GBenchmark* { return new CirclesBench(true);  },
+    []() -> GBenchmark* { return new PathCirclesBench(false); },
+    []() -> GBenchmark* { return new PathCirclesBench(true);  },
+    []() -> GBenchmark* { return new RoundRectsBench(true, false);  },
+    []() -> GBenchmark* { return new RoundRectsBench(true, true);   },
+    []() -> GBenchmark* { return new RoundRectsBench(false, false); },
+    []() -> GBenchmark* { return new RoundRectsBench(false, true);  },
+    []() -> GBenchmark* { return new LinesBench(0, false, "hairlines");      },
+    []() -> GBenchmark* { return new LinesBench(0, true, "hairlines_aa");    },
+    []() -> GBenchmark* { return new LinesBench(1.5f, false, "thin_lines");  },
+    []() -> GBenchmark* { return new LinesBench(2.5f, false, "wide_lines");  },
+    []() -> GBenchmark* { return new StrokeBench(GStroker::kMiter_Join, "stroke_miter"); },
+    []() -> GBenchmark* { return new StrokeBench(GStroker::kRound_Join, "stroke_round"); },
     []() -> GBenchmark* { return new ModesBench({0.0, 1, 0.5, 0.25}, "modes_0"); },
     []() -> GBenchmark* { return new ModesBench({0.5, 1, 0.5, 0.25}, "modes_half"); },
     []() -> GBenchmark* { return new ModesBench({1.0, 1, 0.5, 0.25}, "modes_1"); },
+    []() -> GBenchmark* { return new MarksBench(false); },
+    []() -> GBenchmark* { return new MarksBench(true);  },
+    []() -> GBenchmark* { return new MeshBench(false); },
+    []() -> GBenchmark* { return new MeshBench(true);  },
+
+    []() -> GBenchmark* { return new ContentBench(draw_lion, false, "lion");             },
+    []() -> GBenchmark* { return new ContentBench(draw_lion, true, "lion_picture");      },
+    []() -> GBenchmark* { return new ContentBench(draw_cartman, false, "cartman");       },
+    []() -> GBenchmark* { return new ContentBench(draw_cartman, true, "cartman_picture"); },
+    []() -> GBenchmark* { return new CurvePathsBench(true);  },
+    []() -> GBenchmark* { return new CurvePathsBench(false); },
+    []() -> GBenchmark* {
+        return new ShaderBench(ShaderBench::kBitmap, GShader::kClamp, "shader_bitmap_clamp");
+    },
+    []() -> GBenchmark* {
+        return new ShaderBench(ShaderBench::kBitmap, GShader::kRepeat, "shader_bitmap_repeat");
+    },
+    []() -> GBenchmark* {
+        return new ShaderBench(ShaderBench::kBitmap, GShader::kMirror, "shader_bitmap_mirror");
+    },
+    []() -> GBenchmark* {
+        return new ShaderBench(ShaderBench::kLinear, GShader::kClamp, "shader_linear_clamp");
+    },
+    []() -> GBenchmark* {
+        return new ShaderBench(ShaderBench::kLinear, GShader::kRepeat, "shader_linear_repeat");
+    },
+    []() -> GBenchmark* {
+        return new ShaderBench(ShaderBench::kLinear, GShader::kMirror, "shader_linear_mirror");
+    },
+    []() -> GBenchmark* {
+        return new ShaderBench(ShaderBench::kRadial, GShader::kClamp, "shader_radial");
+    },
+    []() -> GBenchmark* {
+        return new ShaderBench(ShaderBench::kTriangle, GShader::kClamp, "shader_triangle");
+    },
+    []() -> GBenchmark* { return new LayersBench(false); },
+    []() -> GBenchmark* { return new LayersBench(true);  },
+    []() -> GBenchmark* { return new BigFillBench({1920, 1080}, true, "1080p");  },
+    []() -> GBenchmark* { return new BigFillBench({1920, 1080}, false, "1080p"); },
+    []() -> GBenchmark* { return new BigFillBench({3840, 2160}, true, "4k");     },
+    []() -> GBenchmark* { return new BigFillBench({3840, 2160}, false, "4k");    },
+    []() -> GBenchmark* { return new BigFillBench({7680, 4320}, true, "8k");     },
+    []() -> GBenchmark* { return new BigFillBench({7680, 4320}, false, "8k");    },
 
     nullptr,
 };
@@ -2,6 +2,8 @@
  *  Copyright 2017 Mike Reed
  */
 
+#include <stdlib.h>
+#include <string.h>
 #include <vector>
 
 #include "GWindow.h"
@@ -10,6 +12,7 @@
 #include "GColor.h"
 #include "GRandom.h"
 #include "GRect.h"
+#include "GTime.h"
 #include "image.h"
 
 static float bounce(float value, float min, float max, float* dir) {
@@ -60,6 +63,18 @@ struct Shape {
         return GRect::MakeXYWH(fPos.fX - fWidth*0.5, fPos.fY - fHeight*0.5, fWidth, fHeight);
     }
 
+    // pixels the polygon can touch, padded by one for edge rounding
+    GIRect bounds() const {
+        float l = fPts[0].fX, t = fPts[0].fY, r = l, b = t;
+        for (int i = 1; i < fCount; ++i) {
+            l = std::min(l, fPts[i].fX);
+            t = std::min(t, fPts[i].fY);
+            r = std::max(r, fPts[i].fX);
+            b = std::max(b, fPts[i].fY);
+        }
+        return GRect::MakeLTRB(l - 1, t - 1, r + 1, b + 1).roundOut();
+    }
+
     void bounce(const GRect& r, float speed) {
         float nx = ::bounce(fPos.fX + fVec.fX * speed, r.left(), r.right(), &fVec.fX);
         float ny = ::bounce(fPos.fY + fVec.fY * speed, r.top(), r.bottom(), &fVec.fY);
@@ -84,14 +99,46 @@ class ViewerWindow : public GWindow {
     GRandom             fRand;
     float               fSpeed = 0.01f;
     bool                fDoAnim = true;
+    bool                fFullRedraw = false;
 
     GPoint              fArrow_start,
                         fArrow_stop;
     bool                fArrow = false;
 
 public:
-    ViewerWindow(int w, int h) : GWindow(w, h) {
+    ViewerWindow(int w, int h, int extraShapes = 0, bool fullRedraw = false)
+        : GWindow(w, h), fFullRedraw(fullRedraw) {
         fShapes.push_back({ {w*0.5f, h*0.5f}, {w/30.f, h/20.f}, 30, 30, { 1, 0, 0, 0 }});
+        for (int i = 0; i < extraShapes; ++i) {
+            GPoint loc = { fRand.nextF() * w, fRand.nextF() * h };
+            GVector vec = { (fRand.nextF() - 0.5f) * w/15, (fRand.nextF() - 0.5f) * h/10 };
+            fShapes.push_back({ loc, vec, 20, 20, rand_color(fRand) });
+        }
+    }
+
+    /**
+     *  Step the animation for frameCount frames without waiting for events, and print the
+     *  frame rate. Meant for SDL's dummy/offscreen video drivers.
+     */
+    int timeFrames(int frameCount) {
+        this->requestDraw();
+        if (!this->presentFrame()) {
+            return -1;
+        }
+
+        const GNSec start = GTime::GetNSec();
+        for (int i = 0; i < frameCount; ++i) {
+            // drop the wake-up events invalidate() posts, nobody is waiting on them
+            SDL_Event e;
+            while (SDL_PollEvent(&e)) {}
+            this->presentFrame();
+        }
+        const double ms = std::max<GNSec>(GTime::GetNSec() - start, 1) * 1e-6;
+
+        printf("bounce: %d frames %s redraw, %zu shapes left, %.2f ms, %.1f fps\n",
+               frameCount, fFullRedraw ? "full" : "damaged", fShapes.size(), ms,
+               frameCount * 1000.0 / ms);
+        return 0;
     }
 
     static GColor rand_color(GRandom& r) {
@@ -120,17 +167,16 @@ protected:
                 fShapes[0].fColor = fShapes[i].fColor;
                 fShapes[0].fWidth += 1;
                 fShapes[0].fHeight += 1;
+                this->invalidate(fShapes[0].bounds());
                 fShapes.erase(fShapes.begin() + i);
                 this->updateTitle();
             }
         }
 
+        // the canvas is clipped to what changed, so this only repaints behind the moved shapes
         const GRect r = GRect::MakeWH(this->width(), this->height());
         canvas->fillRect(r, {1,1,1,1});
         for (auto& s : fShapes) {
-            if (fDoAnim) {
-                s.bounce(r, fSpeed);
-            }
             s.draw(canvas);
         }
 
@@ -138,7 +184,19 @@ protected:
             draw_line(canvas, fArrow_start, fArrow_stop);
         }
         if (fDoAnim) {
-            this->requestDraw();
+            // move for the next frame, damaging where each shape was and where it lands
+            for (auto& s : fShapes) {
+                if (!fFullRedraw) {
+                    this->invalidate(s.bounds());
+                }
+                s.bounce(r, fSpeed);
+                if (!fFullRedraw) {
+                    this->invalidate(s.bounds());
+                }
+            }
+            if (fFullRedraw) {
+                this->requestDraw();
+            }
         }
     }
 
@@ -173,7 +231,7 @@ protected:
 private:
     void updateTitle() {
         char buffer[100];
-        sprintf(buffer, "%lu", fShapes.size() - 1);
+        sprintf(buffer, "%zu", fShapes.size() - 1);
         this->setTitle(buffer);
     }
 
@@ -181,6 +239,27 @@ private:
 };
 
 int main(int argc, char const* const* argv) {
-    return ViewerWindow(640, 480).run();
+    int frames = 0;
+    int shapes = 0;
+    bool full = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--shapes") && i + 1 < argc) {
+            shapes = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--full")) {
+            full = true;
+        } else {
+            printf("usage: bounce [--frames n] [--shapes n] [--full]\n");
+            return -1;
+        }
+    }
+
+    if (frames > 0) {
+        // headless frame loop: present to the dummy driver unless the caller picked one
+        setenv("SDL_VIDEODRIVER", "dummy", 0);
+        return ViewerWindow(640, 480, shapes, full).timeFrames(frames);
+    }
+    return ViewerWindow(640, 480, shapes, full).run();
 }
 
@@ -0,0 +1,73 @@
+/**
+ *  Differential testing: draws random scenes with the optimized and the reference backends
+ *  (GBackend) and reports any whose pixels differ, so fast paths can be checked against the
+ *  general code before they ship.
+ *
+ *  Prints "differential: seed maxdiff" for each mismatching scene, with the first op that
+ *  went over the tolerance, and a summary. Exits with 1 if any scene mismatched. Options:
+ *
+ *      --seed n        first seed (default 1); scene i uses seed + i
+ *      --scenes n      scenes to draw (default 200)
+ *      --ops n         ops per scene (default 40)
+ *      --size n        scenes are n x n (default 96)
+ *      --tolerance n   largest per-channel difference that still matches (default 0: exact)
+ *      --write dir     write each mismatching scene's two images into dir
+ *
+ *  --help prints the usage line; any other unknown argument prints it and exits with -1.
+ */
+
+#include "GBitmap.h"
+#include "GDifferential.h"
+#include <string>
+#include <string.h>
+
+int main(int argc, char** argv) {
+    uint32_t seed = 1;
+    int scenes = 200, ops = 40, size = 96, tolerance = 0;
+    const char* dir = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--scenes") && i + 1 < argc) {
+            scenes = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--ops") && i + 1 < argc) {
+            ops = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            size = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+            tolerance = std::max(0, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--write") && i + 1 < argc) {
+            dir = argv[++i];
+        } else {
+            const bool help = !strcmp(argv[i], "--help") || !strcmp(argv[i], "-h");
+            fprintf(help ? stdout : stderr,
+                    "usage: differential [--seed n] [--scenes n] [--ops n] [--size n]"
+                    " [--tolerance n] [--write dir]\n");
+            return help ? 0 : -1;
+        }
+    }
+
+    GDifferential differential(size, size, tolerance);
+    int mismatches = 0, maxDiff = 0;
+    for (int i = 0; i < scenes; ++i) {
+        GDifferential::Result result;
+        const bool matched = differential.run(seed + i, ops, &result);
+        maxDiff = std::max(maxDiff, result.fMaxDiff);
+        if (matched) {
+            continue;
+        }
+        mismatches += 1;
+        printf("differential: %u %d\n", seed + i, result.fMaxDiff);
+        printf("    - first at op %d (%s), pixel (%d, %d): optimized %08X, reference %08X\n",
+               result.fFirstOp, result.fFirstOpName, result.fFirstX, result.fFirstY,
+               result.fOptimized, result.fReference);
+        if (dir) {
+            const std::string base = std::string(dir) + "/" + std::to_string(seed + i);
+            differential.optimized().writeToFile((base + "_optimized.png").c_str());
+            differential.reference().writeToFile((base + "_reference.png").c_str());
+        }
+    }
+    printf("differential: %d of %d scenes mismatched (tolerance %d), max diff %d\n",
+           mismatches, scenes, tolerance, maxDiff);
+    return mismatches ? 1 : 0;
+}
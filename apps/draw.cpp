@@ -79,13 +79,7 @@ static void draw_point(GCanvas* canvas, GPoint p) {
 }
 
 static void draw_line(GCanvas* canvas, GPoint p0, GPoint p1, GColor c, float width) {
-    GVector norm = { p1.y() - p0.y(), p0.x() - p1.x() };
-    float scale = width / 2 / norm.length();
-    norm.fX *= scale;
-    norm.fY *= scale;
-
-    GPoint quad[4] = { p0 + norm, p1 + norm, p1 - norm, p0 - norm };
-    canvas->drawConvexPolygon(quad, 4, GPaint(c));
+    canvas->drawLine(p0, p1, width, GPaint(c));
 }
 
 
@@ -0,0 +1,324 @@
+/**
+ *  Kernel microbenchmarks: the per-pixel and per-edge building blocks of the canvas, each timed
+ *  in isolation so a regression (or a SIMD rewrite) can be pinned to one of them.
+ *
+ *  Prints "microbench: name ns/unit" per kernel, plus cycles and instructions per unit where
+ *  the CPU's performance counters can be read (Linux perf_event_open). Options:
+ *
+ *      --match str     only run kernels whose names contain str
+ *      --samples n     timed samples per kernel; the fastest is reported (default 9)
+ */
+
+#include "GBitmap.h"
+#include "GBlendMode.h"
+#include "GCanvas.h"
+#include "GColor.h"
+#include "GMatrix.h"
+#include "GPath.h"
+#include "GPixel.h"
+#include "GRandom.h"
+#include "GShader.h"
+#include "GTime.h"
+#include "blend.h"
+#include "Utils.h"
+#include "pathEdger.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ *  Counts cycles and instructions in user space around a region, when the kernel lets us.
+ */
+class PerfCounters {
+public:
+    PerfCounters() {
+#ifdef __linux__
+        fCycles = Open(PERF_COUNT_HW_CPU_CYCLES);
+        fInstructions = Open(PERF_COUNT_HW_INSTRUCTIONS);
+#endif
+    }
+    ~PerfCounters() {
+#ifdef __linux__
+        if (fCycles >= 0) close(fCycles);
+        if (fInstructions >= 0) close(fInstructions);
+#endif
+    }
+
+    bool available() const { return fCycles >= 0 && fInstructions >= 0; }
+
+    void start() {
+#ifdef __linux__
+        for (int fd : { fCycles, fInstructions }) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void stop(double* cycles, double* instructions) {
+        *cycles = *instructions = 0;
+#ifdef __linux__
+        long long value;
+        ioctl(fCycles, PERF_EVENT_IOC_DISABLE, 0);
+        ioctl(fInstructions, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fCycles, &value, sizeof(value)) == sizeof(value)) {
+            *cycles = (double)value;
+        }
+        if (read(fInstructions, &value, sizeof(value)) == sizeof(value)) {
+            *instructions = (double)value;
+        }
+#endif
+    }
+
+private:
+    int fCycles = -1;
+    int fInstructions = -1;
+
+#ifdef __linux__
+    static int Open(unsigned long long config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+};
+
+/*
+ *  One kernel: run() processes units of unit (pixels, edges, points) each call.
+ */
+struct Kernel {
+    std::string           fName;
+    const char*           fUnit;
+    int                   fUnits;
+    std::function<void()> fRun;
+};
+
+static volatile uint32_t gSink;     // results are folded in here so nothing is optimized away
+
+static const int N = 1024;          // pixels per row, points per batch
+
+static GPixel rand_pixel(GRandom& rand) {
+    const int a = rand.nextU() & 0xFF;
+    return GPixel_PackARGB(a, (rand.nextU() & 0xFF) * a / 255, (rand.nextU() & 0xFF) * a / 255,
+                           (rand.nextU() & 0xFF) * a / 255);
+}
+
+static const char* gBlendNames[] = {
+    "clear", "src", "dst", "srcover", "dstover", "srcin", "dstin", "srcout", "dstout",
+    "srcatop", "dstatop", "xor",
+};
+
+static void add_blend_kernels(std::vector<Kernel>* kernels) {
+    std::shared_ptr<std::vector<GPixel>> src(new std::vector<GPixel>(N));
+    std::shared_ptr<std::vector<GPixel>> dst(new std::vector<GPixel>(N));
+    GRandom rand;
+    for (int i = 0; i < N; ++i) {
+        (*src)[i] = rand_pixel(rand);
+        (*dst)[i] = rand_pixel(rand);
+    }
+    for (int m = 0; m < (int)GARRAY_COUNT(gBlendNames); ++m) {
+        const Blend proc = getBlend(static_cast<GBlendMode>(m));
+        kernels->push_back({ std::string("blend_") + gBlendNames[m], "pixel", N, [=]() {
+            const GPixel* s = src->data();
+            GPixel* d = dst->data();
+            for (int i = 0; i < N; ++i) {
+                d[i] = proc(s[i], d[i]);
+            }
+            gSink += d[N - 1];
+        }});
+    }
+}
+
+static void add_color_kernel(std::vector<Kernel>* kernels) {
+    std::shared_ptr<std::vector<GColor>> colors(new std::vector<GColor>(N));
+    std::shared_ptr<std::vector<GPixel>> pixels(new std::vector<GPixel>(N));
+    GRandom rand;
+    for (GColor& c : *colors) {
+        c = { rand.nextF(), rand.nextF(), rand.nextF(), rand.nextF() };
+    }
+    kernels->push_back({ "color_to_pixel", "pixel", N, [=]() {
+        for (int i = 0; i < N; ++i) {
+            (*pixels)[i] = colortoPixel((*colors)[i]);
+        }
+        gSink += (*pixels)[N - 1];
+    }});
+}
+
+/*
+ *  shadeRow for each shader, through a rotated and scaled CTM, over successive rows.
+ */
+static void add_shader_kernels(std::vector<Kernel>* kernels) {
+    const int S = 64;
+    std::shared_ptr<GBitmap> bitmap(new GBitmap, [](GBitmap* bm) {
+        free(bm->pixels());
+        delete bm;
+    });
+    bitmap->reset(S, S, S * sizeof(GPixel), (GPixel*)malloc(S * S * sizeof(GPixel)),
+                  GBitmap::kNo_IsOpaque);
+    GRandom rand;
+    for (int y = 0; y < S; ++y) {
+        for (int x = 0; x < S; ++x) {
+            *bitmap->getAddr(x, y) = rand_pixel(rand);
+        }
+    }
+
+    // The canvas makes the radial and triangle gradients; it draws nothing.
+    GBitmap tiny;
+    GPixel pixel;
+    tiny.reset(1, 1, sizeof(GPixel), &pixel, GBitmap::kNo_IsOpaque);
+    auto canvas = GCreateCanvas(tiny);
+
+    const GColor colors[] = { {1, 1, 0, 0}, {0.5f, 0, 1, 0}, {1, 0, 0, 1} };
+    const GPoint tri[] = { {0, 0}, {N, 100}, {200, N} };
+    const char* tiles[] = { "clamp", "repeat", "mirror" };
+    std::vector<std::pair<std::string, std::shared_ptr<GShader>>> shaders;
+    for (int t = 0; t < 3; ++t) {
+        const GShader::TileMode mode = static_cast<GShader::TileMode>(t);
+        shaders.push_back({ std::string("shade_bitmap_") + tiles[t],
+                            GCreateBitmapShader(*bitmap, GMatrix(), mode) });
+        shaders.push_back({ std::string("shade_linear_") + tiles[t],
+                            GCreateLinearGradient({100, 0}, {300, 80}, colors, 3, mode) });
+    }
+    shaders.push_back({ "shade_radial",
+                        canvas->final_createRadialGradient({N / 2, 50}, N / 3, colors, 3) });
+    shaders.push_back({ "shade_triangle", canvas->final_createTriangleGradient(tri, colors) });
+
+    const GMatrix ctm = GMatrix().postRotate(M_PI / 7).postScale(3, 3);
+    for (auto& named : shaders) {
+        std::shared_ptr<GShader> shader = named.second;
+        if (!shader || !shader->setContext(ctm)) {
+            continue;
+        }
+        std::shared_ptr<std::vector<GPixel>> row(new std::vector<GPixel>(N));
+        std::shared_ptr<int> y(new int(0));
+        kernels->push_back({ named.first, "pixel", N, [=]() {
+            shader->shadeRow(0, (*y)++ & 255, N, row->data());
+            gSink += (*row)[N - 1];
+            (void)bitmap;   // the bitmap shaders read it
+        }});
+    }
+}
+
+/*
+ *  Edge construction: clip() on random segments, a quarter of them crossing the clip bounds,
+ *  and clipPath() flattening random cubics (per edge it produces).
+ */
+static void add_edge_kernels(std::vector<Kernel>* kernels) {
+    const GRect sides = GRect::MakeWH(1000, 1000);
+    const int E = 1000;
+    std::shared_ptr<std::vector<GPoint>> pts(new std::vector<GPoint>(E + 1));
+    GRandom rand;
+    for (GPoint& p : *pts) {
+        p = { rand.nextF() * 1250 - 125, rand.nextF() * 1250 - 125 };
+    }
+    std::shared_ptr<std::deque<Edge>> edges(new std::deque<Edge>);
+    kernels->push_back({ "edge_build", "edge", E, [=]() {
+        edges->clear();
+        for (int i = 0; i < E; ++i) {
+            clip((*pts)[i], (*pts)[i + 1], sides, *edges);
+        }
+        gSink += (uint32_t)edges->size();
+    }});
+
+    std::shared_ptr<GPath> path(new GPath);
+    auto pt = [&]() { return GPoint{ rand.nextF() * 1000, rand.nextF() * 1000 }; };
+    path->moveTo(pt());
+    for (int i = 0; i < 50; ++i) {
+        path->cubicTo(pt(), pt(), pt());
+    }
+    const int count = (int)clipPath(*path, sides).size();
+    kernels->push_back({ "clip_path_cubic", "edge", count, [=]() {
+        gSink += (uint32_t)clipPath(*path, sides).size();
+    }});
+}
+
+static void add_matrix_kernel(std::vector<Kernel>* kernels) {
+    std::shared_ptr<std::vector<GPoint>> src(new std::vector<GPoint>(N));
+    std::shared_ptr<std::vector<GPoint>> dst(new std::vector<GPoint>(N));
+    GRandom rand;
+    for (GPoint& p : *src) {
+        p = { rand.nextF() * 1000, rand.nextF() * 1000 };
+    }
+    const GMatrix m(0.8f, -0.6f, 20, 0.6f, 0.8f, -15);
+    kernels->push_back({ "map_points", "point", N, [=]() {
+        m.mapPoints(dst->data(), src->data(), N);
+        gSink += (uint32_t)(*dst)[N - 1].x();
+    }});
+}
+
+/*
+ *  Calibrate calls per sample to at least 2ms, warm up, then keep the fastest sample of
+ *  samples: the kernel's cost with the least interference.
+ */
+static void run_kernel(const Kernel& k, int samples, PerfCounters* counters) {
+    auto time_calls = [&](int calls) {
+        const GNSec start = GTime::GetNSec();
+        for (int i = 0; i < calls; ++i) {
+            k.fRun();
+        }
+        return (double)(GTime::GetNSec() - start);
+    };
+    int calls = 1;
+    while (time_calls(calls) < 2e6 && calls < (1 << 24)) {
+        calls *= 2;
+    }
+    time_calls(calls);
+
+    double best = 1e300;
+    for (int i = 0; i < samples; ++i) {
+        best = std::min(best, time_calls(calls));
+    }
+    const double units = (double)calls * k.fUnits;
+    printf("microbench: %-22s %9.3f ns/%s", k.fName.c_str(), best / units, k.fUnit);
+    if (counters->available()) {
+        double cycles, instructions;
+        counters->start();
+        time_calls(calls);
+        counters->stop(&cycles, &instructions);
+        printf("  %8.2f cycles  %8.2f instructions", cycles / units, instructions / units);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    const char* match = nullptr;
+    int samples = 9;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--match") && i + 1 < argc) {
+            match = argv[++i];
+        } else if (!strcmp(argv[i], "--samples") && i + 1 < argc) {
+            samples = std::max(1, atoi(argv[++i]));
+        }
+    }
+
+    std::vector<Kernel> kernels;
+    add_blend_kernels(&kernels);
+    add_color_kernel(&kernels);
+    add_shader_kernels(&kernels);
+    add_edge_kernels(&kernels);
+    add_matrix_kernel(&kernels);
+
+    PerfCounters counters;
+    for (const Kernel& k : kernels) {
+        if (!match || strstr(k.fName.c_str(), match)) {
+            run_kernel(k, samples, &counters);
+        }
+    }
+    return 0;
+}
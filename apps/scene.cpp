@@ -0,0 +1,80 @@
+/**
+ *  Convert a .475 text scene into a binary GScene file, or render either kind to a png.
+ *
+ *      scene input.475 output.gscene
+ *      scene input.475|input.gscene output.png [width height]
+ */
+
+#include "GBitmap.h"
+#include "GCanvas.h"
+#include "GPicture.h"
+#include "GScene.h"
+#include "GSceneParser.h"
+#include <string>
+
+static bool has_suffix(const char str[], const char suffix[]) {
+    size_t n = strlen(str), m = strlen(suffix);
+    return n >= m && !strcmp(str + n - m, suffix);
+}
+
+static bool parse_text(const char path[], GCanvas* canvas) {
+    GSceneParser parser(canvas);
+    if (!parser.parseFile(path)) {
+        fprintf(stderr, "%s:%d: %s\n", path, parser.errorLine(), parser.errorMessage());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3 && argc != 5) {
+        fprintf(stderr, "usage: %s input.475 output.gscene\n"
+                        "       %s input.475|input.gscene output.png [width height]\n",
+                argv[0], argv[0]);
+        return -1;
+    }
+    const char* input = argv[1];
+    const char* output = argv[2];
+
+    if (!has_suffix(output, ".png")) {
+        GRecordingCanvas recorder;
+        if (!parse_text(input, &recorder)) {
+            return -1;
+        }
+        if (!GScene::WriteFile(*recorder.finishRecording(), output)) {
+            fprintf(stderr, "failed to write %s\n", output);
+            return -1;
+        }
+        return 0;
+    }
+
+    const int width = argc == 5 ? atoi(argv[3]) : 512;
+    const int height = argc == 5 ? atoi(argv[4]) : 512;
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "bad size %d x %d\n", width, height);
+        return -1;
+    }
+
+    GBitmap bitmap;
+    size_t rb = width * sizeof(GPixel);
+    bitmap.reset(width, height, rb, (GPixel*)calloc(height, rb), GBitmap::kNo_IsOpaque);
+    auto canvas = GCreateCanvas(bitmap);
+
+    if (has_suffix(input, ".gscene")) {
+        auto scene = GScene::MakeFromFile(input);
+        if (!scene) {
+            fprintf(stderr, "%s is not a valid scene\n", input);
+            return -1;
+        }
+        scene->playback(canvas.get());
+    } else if (!parse_text(input, canvas.get())) {
+        return -1;
+    }
+
+    if (!bitmap.writeToFile(output)) {
+        fprintf(stderr, "failed to write %s\n", output);
+        return -1;
+    }
+    free(bitmap.pixels());
+    return 0;
+}
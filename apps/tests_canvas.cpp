@@ -0,0 +1,947 @@
+#include "GCanvas.h"
+#include "GBitmap.h"
+#include "GMatrix.h"
+#include "GPath.h"
+#include "GPicture.h"
+#include "GStroker.h"
+#include "GRandom.h"
+#include "GStats.h"
+#include "GOverdrawCanvas.h"
+#include "GDifferential.h"
+#include "GTrace.h"
+#include <string>
+#include <vector>
+#include "tests.h"
+
+/*
+ *  Every pixel inside r is in, every pixel outside is out.
+ */
+static bool only_inside(const GBitmap& bitmap, const GIRect& r, GPixel in, GPixel out) {
+    for (int y = 0; y < bitmap.height(); ++y) {
+        for (int x = 0; x < bitmap.width(); ++x) {
+            if (*bitmap.getAddr(x, y) != (r.contains(x, y) ? in : out)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void test_clip_rect(GTestStats* stats) {
+    const GPixel red = GPixel_PackARGB(0xFF, 0xFF, 0, 0);
+    GBitmap bitmap;
+    setup_bitmap(&bitmap, 10, 10);
+    auto canvas = GCreateCanvas(bitmap);
+
+    canvas->save();
+    canvas->clipRect(GRect::MakeLTRB(2, 3, 7, 8));
+    canvas->drawPaint(GPaint({1, 1, 0, 0}));
+    stats->expectTrue(only_inside(bitmap, GIRect::MakeLTRB(2, 3, 7, 8), red, 0), "clip_rect");
+
+    // Clips only ever shrink, and follow the CTM.
+    clear(bitmap);
+    canvas->translate(3, 0);
+    canvas->clipRect(GRect::MakeLTRB(0, 0, 10, 5));
+    canvas->drawRect(GRect::MakeLTRB(-10, -10, 20, 20), GPaint({1, 1, 0, 0}));
+    stats->expectTrue(only_inside(bitmap, GIRect::MakeLTRB(3, 3, 7, 5), red, 0),
+                      "clip_rect_nested");
+    canvas->restore();
+
+    // restore() puts back the whole canvas.
+    clear(bitmap);
+    canvas->drawPaint(GPaint({1, 1, 0, 0}));
+    stats->expectTrue(only_inside(bitmap, GIRect::MakeWH(10, 10), red, 0), "clip_restore");
+
+    // A clip inside a layer is undone when the layer is, and the layer is composited through
+    // the clip that was in effect when it was made.
+    clear(bitmap);
+    canvas->save();
+    canvas->clipRect(GRect::MakeLTRB(0, 0, 6, 10));
+    canvas->saveLayer(GPaint());
+    canvas->clipRect(GRect::MakeLTRB(4, 0, 10, 10));
+    canvas->drawPaint(GPaint({1, 1, 0, 0}));
+    canvas->restore();
+    canvas->restore();
+    stats->expectTrue(only_inside(bitmap, GIRect::MakeLTRB(4, 0, 6, 10), red, 0), "clip_layer");
+
+    free(bitmap.pixels());
+}
+
+static void test_clip_path(GTestStats* stats) {
+    const int W = 40, H = 30;
+    GBitmap clipped, drawn;
+    setup_bitmap(&clipped, W, H);
+    setup_bitmap(&drawn, W, H);
+
+    GPath path;
+    path.moveTo(3, 2).lineTo(35, 8).quadTo(20, 35, 6, 26).cubicTo(0, 20, 14, 12, 3, 2);
+
+    // Clipping to a path keeps exactly the pixels drawing it would fill.
+    {
+        auto canvas = GCreateCanvas(clipped);
+        canvas->clipPath(path);
+        canvas->drawPaint(GPaint({1, 0, 1, 0}));
+        GCreateCanvas(drawn)->drawPath(path, GPaint({1, 0, 1, 0}));
+        stats->expectTrue(bitmaps_eq(clipped, drawn), "clip_path");
+    }
+
+    // ... and intersects with what was already there.
+    clear(clipped);
+    clear(drawn);
+    {
+        auto canvas = GCreateCanvas(clipped);
+        canvas->clipRect(GRect::MakeLTRB(10, 0, 30, 20));
+        canvas->clipPath(path);
+        canvas->drawRect(GRect::MakeWH(W, H), GPaint({1, 0, 1, 0}));
+
+        GBitmap full;
+        setup_bitmap(&full, W, H);
+        GCreateCanvas(full)->drawPath(path, GPaint({1, 0, 1, 0}));
+        for (int y = 0; y < H; ++y) {
+            for (int x = 10; x < 30 && y < 20; ++x) {
+                *drawn.getAddr(x, y) = *full.getAddr(x, y);
+            }
+        }
+        free(full.pixels());
+        stats->expectTrue(bitmaps_eq(clipped, drawn), "clip_path_rect");
+    }
+
+    // A rotated rect clip behaves like clipping to the same rect as a path.
+    clear(clipped);
+    clear(drawn);
+    {
+        auto a = GCreateCanvas(clipped);
+        auto b = GCreateCanvas(drawn);
+        GMatrix m;
+        m.setConcat(GMatrix::MakeTranslate(20, 4), GMatrix::MakeRotate(0.6f));
+        a->concat(m);
+        b->concat(m);
+        a->clipRect(GRect::MakeLTRB(0, 0, 18, 12));
+        b->clipPath(GPath().addRect(GRect::MakeLTRB(0, 0, 18, 12)));
+        a->drawPaint(GPaint({1, 0, 0, 1}));
+        b->drawPaint(GPaint({1, 0, 0, 1}));
+        stats->expectTrue(bitmaps_eq(clipped, drawn), "clip_rect_rotated");
+    }
+
+    free(clipped.pixels());
+    free(drawn.pixels());
+}
+
+static void test_quick_reject(GTestStats* stats) {
+    GBitmap bitmap;
+    setup_bitmap(&bitmap, 20, 20);
+    auto canvas = GCreateCanvas(bitmap);
+
+    stats->expectFalse(canvas->quickReject(GRect::MakeLTRB(5, 5, 8, 8)), "reject_inside");
+    stats->expectTrue(canvas->quickReject(GRect::MakeLTRB(25, 5, 28, 8)), "reject_outside");
+    stats->expectFalse(canvas->quickReject(GRect::MakeLTRB(-5, -5, 1, 1)), "reject_straddle");
+
+    canvas->save();
+    canvas->clipRect(GRect::MakeLTRB(0, 0, 10, 10));
+    stats->expectTrue(canvas->quickReject(GRect::MakeLTRB(12, 2, 15, 5)), "reject_clipped");
+    canvas->translate(-10, 0);
+    stats->expectFalse(canvas->quickReject(GRect::MakeLTRB(12, 2, 15, 5)), "reject_ctm");
+    canvas->clipRect(GRect::MakeLTRB(100, 100, 110, 110));
+    stats->expectTrue(canvas->quickReject(GRect::MakeLTRB(12, 2, 15, 5)), "reject_empty");
+    canvas->restore();
+    stats->expectFalse(canvas->quickReject(GRect::MakeLTRB(12, 2, 15, 5)), "reject_restore");
+
+    free(bitmap.pixels());
+}
+
+/*
+ *  Batched draws must match the same items drawn one call at a time, through any CTM, clip
+ *  and layer.
+ */
+static void test_batched_draws(GTestStats* stats) {
+    const int W = 64, H = 48, N = 60;
+    GRandom rand;
+    std::vector<GRect> rects;
+    std::vector<GColor> colors;
+    std::vector<GPoint> pts;
+    std::vector<int> counts;
+    for (int i = 0; i < N; ++i) {
+        const float x = rand.nextF() * W, y = rand.nextF() * H;
+        rects.push_back(GRect::MakeXYWH(x - 8, y - 6, rand.nextF() * 20, rand.nextF() * 15));
+        colors.push_back({0.25f + rand.nextF() * 0.75f, rand.nextF(), rand.nextF(), rand.nextF()});
+        counts.push_back(3 + i % 3);
+        for (int k = 0; k < counts.back(); ++k) {
+            const float angle = k * 2 * M_PI / counts.back();
+            pts.push_back({ x + cosf(angle) * 7, y + sinf(angle) * 5 });
+        }
+    }
+
+    GBitmap batched, single;
+    setup_bitmap(&batched, W, H);
+    setup_bitmap(&single, W, H);
+
+    const char* names[] = { "batch_identity", "batch_scaled", "batch_rotated" };
+    for (int pass = 0; pass < 3; ++pass) {
+        auto a = GCreateCanvas(batched);
+        auto b = GCreateCanvas(single);
+        for (GCanvas* c : { a.get(), b.get() }) {
+            c->clear({1, 1, 1, 1});
+            if (pass == 1) {
+                c->translate(3.5f, -2.25f);
+                c->scale(1.25f, 0.8f);
+            } else if (pass == 2) {
+                c->translate(W / 2, H / 2);
+                c->rotate(0.4f);
+                c->translate(-W / 2, -H / 2);
+            }
+            c->clipRect(GRect::MakeLTRB(4, 2, W - 6, H - 3));
+            const GRect layerBounds = GRect::MakeLTRB(5, 4, W - 10, H - 2);
+            c->saveLayer(&layerBounds, GPaint({0.75f, 0, 0, 0}));
+        }
+        const GPaint paint({0.5f, 0, 0, 1});
+
+        a->drawRects(rects.data(), N, paint);
+        a->drawRects(rects.data(), N, paint, colors.data());
+        a->drawConvexPolygons(pts.data(), counts.data(), N, paint, colors.data());
+        a->drawPoints(pts.data(), N, 2.5f, paint, colors.data());
+
+        GPaint itemPaint(paint);
+        for (int i = 0; i < N; ++i) {
+            b->drawRect(rects[i], paint);
+        }
+        for (int i = 0; i < N; ++i) {
+            b->drawRect(rects[i], itemPaint.setColor(colors[i]));
+        }
+        const GPoint* poly = pts.data();
+        for (int i = 0; i < N; ++i) {
+            b->drawConvexPolygon(poly, counts[i], itemPaint.setColor(colors[i]));
+            poly += counts[i];
+        }
+        for (int i = 0; i < N; ++i) {
+            const GPoint p = pts[i];
+            b->drawRect(GRect::MakeLTRB(p.x() - 1.25f, p.y() - 1.25f, p.x() + 1.25f,
+                                        p.y() + 1.25f), itemPaint.setColor(colors[i]));
+        }
+        a->restore();
+        b->restore();
+        stats->expectTrue(bitmaps_eq(batched, single), names[pass]);
+    }
+
+    free(batched.pixels());
+    free(single.pixels());
+}
+
+/*
+ *  A grid of cells over r, each split into two triangles, with the inner vertices jittered.
+ */
+static void make_grid_mesh(const GIRect& r, int cols, int rows, GRandom* rand,
+                           std::vector<GPoint>* verts, std::vector<int>* indices) {
+    for (int j = 0; j <= rows; ++j) {
+        for (int i = 0; i <= cols; ++i) {
+            float x = r.left() + (float)r.width() * i / cols;
+            float y = r.top() + (float)r.height() * j / rows;
+            if (i > 0 && i < cols && j > 0 && j < rows) {
+                x += rand->nextF() * 0.8f - 0.4f;
+                y += rand->nextF() * 0.8f - 0.4f;
+            }
+            verts->push_back({ x, y });
+        }
+    }
+    for (int j = 0; j < rows; ++j) {
+        for (int i = 0; i < cols; ++i) {
+            const int v = j * (cols + 1) + i;
+            // alternate the winding, and the diagonal, from cell to cell
+            if ((i + j) & 1) {
+                indices->insert(indices->end(), { v, v + 1, v + cols + 2, v, v + cols + 1,
+                                                  v + cols + 2 });
+            } else {
+                indices->insert(indices->end(), { v, v + cols + 1, v + 1, v + 1, v + cols + 1,
+                                                  v + cols + 2 });
+            }
+        }
+    }
+}
+
+static void test_mesh(GTestStats* stats) {
+    const int W = 40, H = 30;
+    const GIRect r = GIRect::MakeLTRB(4, 3, 36, 27);
+    GRandom rand;
+    std::vector<GPoint> verts;
+    std::vector<int> indices;
+    make_grid_mesh(r, 7, 5, &rand, &verts, &indices);
+    const int triCount = (int)indices.size() / 3;
+
+    GBitmap meshed, drawn;
+    setup_bitmap(&meshed, W, H);
+    setup_bitmap(&drawn, W, H);
+    auto a = GCreateCanvas(meshed);
+    auto b = GCreateCanvas(drawn);
+
+    // Every pixel is blended exactly once: no cracks, and no doubled alpha on shared edges.
+    const GPaint paint({0.5f, 0, 0, 1});
+    a->clear({1, 1, 1, 1});
+    b->clear({1, 1, 1, 1});
+    a->drawMesh(verts.data(), nullptr, nullptr, indices.data(), triCount, paint);
+    b->drawRect(GRect::Make(r), paint);
+    stats->expectTrue(bitmaps_eq(meshed, drawn), "mesh_shared_edges");
+
+    // Indices are only a way of sharing vertices.
+    std::vector<GPoint> unindexed;
+    for (int index : indices) {
+        unindexed.push_back(verts[index]);
+    }
+    b->clear({1, 1, 1, 1});
+    b->drawMesh(unindexed.data(), nullptr, nullptr, nullptr, triCount, paint);
+    stats->expectTrue(bitmaps_eq(meshed, drawn), "mesh_indices");
+
+    // Colors are interpolated: red on the left fading to blue on the right.
+    std::vector<GColor> colors;
+    for (const GPoint& p : verts) {
+        const float t = (p.x() - r.left()) / r.width();
+        colors.push_back({1, 1 - t, 0, t});
+    }
+    a->clear({1, 1, 1, 1});
+    a->drawMesh(verts.data(), colors.data(), nullptr, indices.data(), triCount, paint);
+    bool ramp = GPixel_GetR(*meshed.getAddr(r.left(), 10)) > 0xF0 &&
+                GPixel_GetB(*meshed.getAddr(r.right() - 1, 10)) > 0xF0;
+    for (int x = r.left() + 1; x < r.right(); ++x) {
+        ramp &= GPixel_GetR(*meshed.getAddr(x, 10)) <= GPixel_GetR(*meshed.getAddr(x - 1, 10));
+    }
+    stats->expectTrue(ramp, "mesh_colors");
+
+    // Texture coordinates equal to the vertices leave the shader where it was, and white
+    // colors leave its pixels alone.
+    GBitmap checker;
+    setup_bitmap(&checker, 4, 4);
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            *checker.getAddr(x, y) = ((x + y) & 1) ? GPixel_PackARGB(0xFF, 0, 0x80, 0)
+                                                   : GPixel_PackARGB(0x80, 0x80, 0, 0);
+        }
+    }
+    auto shader = GCreateBitmapShader(checker, GMatrix::MakeScale(0.25f, 0.25f),
+                                      GShader::kRepeat);
+    GPaint shaded(shader.get());
+    std::vector<GColor> white(verts.size(), {1, 1, 1, 1});
+    for (GCanvas* c : { a.get(), b.get() }) {
+        c->clear({1, 1, 1, 1});
+        c->save();
+        c->rotate(0.1f);
+    }
+    a->drawMesh(verts.data(), nullptr, verts.data(), indices.data(), triCount, shaded);
+    b->drawMesh(verts.data(), nullptr, nullptr, indices.data(), triCount, shaded);
+    stats->expectTrue(bitmaps_eq(meshed, drawn), "mesh_texs");
+
+    a->clear({1, 1, 1, 1});
+    a->drawMesh(verts.data(), white.data(), verts.data(), indices.data(), triCount, shaded);
+    stats->expectTrue(bitmaps_eq(meshed, drawn), "mesh_modulate");
+
+    // Recorded meshes play back the same.
+    GRecordingCanvas recorder;
+    recorder.rotate(0.1f);
+    recorder.drawMesh(verts.data(), white.data(), verts.data(), indices.data(), triCount, shaded);
+    recorder.drawMesh(unindexed.data(), nullptr, nullptr, nullptr, triCount, paint);
+    a->drawMesh(unindexed.data(), nullptr, nullptr, nullptr, triCount, paint);
+    b->restore();
+    b->clear({1, 1, 1, 1});
+    recorder.finishRecording()->playback(b.get());
+    stats->expectTrue(bitmaps_eq(meshed, drawn), "mesh_picture");
+
+    free(checker.pixels());
+    free(meshed.pixels());
+    free(drawn.pixels());
+}
+
+static void test_convex_path(GTestStats* stats) {
+    GPath path;
+    path.addRect(GRect::MakeLTRB(1, 2, 9, 7));
+    stats->expectTrue(path.isConvex(), "convex_rect");
+
+    const GPoint tri[] = { {2, 2}, {18, 5}, {6, 17} };
+    path.reset();
+    path.addPolygon(tri, 3);
+    stats->expectTrue(path.isConvex(), "convex_triangle");
+
+    // Appending a point that dents the outline must drop the cached answer.
+    path.lineTo(8, 6);
+    stats->expectTrue(!path.isConvex(), "convex_invalidate");
+
+    const GPoint arrow[] = { {2, 2}, {18, 10}, {2, 18}, {8, 10} };
+    path.reset();
+    path.addPolygon(arrow, 4);
+    stats->expectTrue(!path.isConvex(), "convex_arrow");
+
+    path.reset();
+    path.addRect(GRect::MakeLTRB(1, 1, 4, 4)).addRect(GRect::MakeLTRB(6, 6, 9, 9));
+    stats->expectTrue(!path.isConvex(), "convex_contours");
+
+    // Turns the same way at every corner, but winds around twice.
+    GPoint star[5];
+    for (int i = 0; i < 5; ++i) {
+        const float angle = i * 2 * 2 * 3.14159265f / 5;
+        star[i] = { 10 + 8 * cosf(angle), 10 + 8 * sinf(angle) };
+    }
+    path.reset();
+    path.addPolygon(star, 5);
+    stats->expectTrue(!path.isConvex(), "convex_pentagram");
+
+    path.reset();
+    path.moveTo(2, 10).quadTo(2, 2, 10, 2).quadTo(18, 2, 18, 10).quadTo(18, 18, 10, 18)
+        .quadTo(2, 18, 2, 10);
+    stats->expectTrue(path.isConvex(), "convex_quads");
+
+    // A convex path inside the canvas fills exactly the pixels the general winding scan would.
+    // An empty second contour makes the path concave without adding coverage.
+    const int W = 30, H = 30;
+    GBitmap fast, general;
+    setup_bitmap(&fast, W, H);
+    setup_bitmap(&general, W, H);
+    auto a = GCreateCanvas(fast);
+    auto b = GCreateCanvas(general);
+    GRandom rand;
+    bool same = true;
+    for (int pass = 0; pass < 20 && same; ++pass) {
+        GPoint pts[12];
+        const int count = 3 + pass % 10;
+        const float cx = 10 + rand.nextF() * 10, cy = 10 + rand.nextF() * 10;
+        const float rx = 2 + rand.nextF() * 7, ry = 2 + rand.nextF() * 7;
+        const float start = rand.nextF() * 6.2831853f;
+        for (int i = 0; i < count; ++i) {
+            const float angle = start + i * 6.2831853f / count;
+            pts[i] = { cx + rx * cosf(angle), cy + ry * sinf(angle) };
+        }
+        GPath convex;
+        convex.addPolygon(pts, count);
+        GPath concave(convex);
+        concave.moveTo(0, 0).lineTo(0, 0).lineTo(0, 0);
+        if (!convex.isConvex() || concave.isConvex()) {
+            same = false;
+            break;
+        }
+        a->clear({1, 1, 1, 1});
+        b->clear({1, 1, 1, 1});
+        a->drawPath(convex, GPaint({0.5f, 0, 0, 1}));
+        b->drawPath(concave, GPaint({0.5f, 0, 0, 1}));
+        same = bitmaps_eq(fast, general);
+    }
+    stats->expectTrue(same, "convex_fill");
+
+    free(fast.pixels());
+    free(general.pixels());
+}
+
+/*
+ *  drawRect skips edge building when the CTM keeps rects axis-aligned. It must still fill the
+ *  pixels drawConvexPolygon does, for every blend of an opaque, translucent or Src paint.
+ */
+static void test_rect_fast_path(GTestStats* stats) {
+    const int W = 40, H = 30;
+    GBitmap rects, polys;
+    setup_bitmap(&rects, W, H);
+    setup_bitmap(&polys, W, H);
+    auto a = GCreateCanvas(rects);
+    auto b = GCreateCanvas(polys);
+
+    const char* names[] = { "rect_fast_identity", "rect_fast_scaled", "rect_fast_swapped",
+                            "rect_fast_clipped" };
+    GRandom rand;
+    for (int pass = 0; pass < 4; ++pass) {
+        for (GCanvas* c : { a.get(), b.get() }) {
+            c->clear({1, 1, 1, 1});
+            c->save();
+            if (pass == 1) {
+                c->translate(3.25f, -1.5f);
+                c->scale(1.5f, -0.75f);
+                c->translate(0, -30);
+            } else if (pass == 2) {
+                c->concat(GMatrix(0, -1.25f, W + 0.5f, 1, 0, 0.25f));
+            } else if (pass == 3) {
+                const GPoint tri[] = { {2, 1}, {38, 12}, {9, 29} };
+                GPath path;
+                path.addPolygon(tri, 3);
+                c->clipPath(path);
+                const GRect layerBounds = GRect::MakeLTRB(3.5f, 2.5f, W - 5, H - 1);
+                c->saveLayer(&layerBounds, GPaint());
+            }
+        }
+        for (int i = 0; i < 60; ++i) {
+            const float x = rand.nextF() * 50 - 5, y = rand.nextF() * 40 - 5;
+            const GRect r = GRect::MakeXYWH(x, y, rand.nextF() * 20 - 2, rand.nextF() * 20 - 2);
+            GPaint paint({ i % 3 ? 1 : 0.5f, rand.nextF(), rand.nextF(), rand.nextF() });
+            if (i % 5 == 0) {
+                paint.setBlendMode(GBlendMode::kSrc);
+            }
+            const GPoint quad[] = { {r.left(), r.top()}, {r.right(), r.top()},
+                                    {r.right(), r.bottom()}, {r.left(), r.bottom()} };
+            a->drawRect(r, paint);
+            b->drawConvexPolygon(quad, 4, paint);
+        }
+        a->restore();
+        b->restore();
+        if (pass == 3) {
+            a->restore();
+            b->restore();
+        }
+        stats->expectTrue(bitmaps_eq(rects, polys), names[pass]);
+    }
+
+    free(rects.pixels());
+    free(polys.pixels());
+}
+
+static void test_round_rect(GTestStats* stats) {
+    const int W = 40, H = 30;
+    const GPixel white = GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF);
+    const GPixel black = GPixel_PackARGB(0xFF, 0, 0, 0);
+    GBitmap round, plain;
+    setup_bitmap(&round, W, H);
+    setup_bitmap(&plain, W, H);
+    auto a = GCreateCanvas(round);
+    auto b = GCreateCanvas(plain);
+
+    // With no radii it is just a rect.
+    GRandom rand;
+    a->clear({1, 1, 1, 1});
+    b->clear({1, 1, 1, 1});
+    for (int i = 0; i < 40; ++i) {
+        const GRect r = GRect::MakeXYWH(rand.nextF() * 50 - 5, rand.nextF() * 40 - 5,
+                                        rand.nextF() * 20 - 2, rand.nextF() * 20 - 2);
+        const GPaint paint({0.5f, rand.nextF(), rand.nextF(), rand.nextF()});
+        a->drawRoundRect(r, 0, rand.nextF() * 4, paint);
+        b->drawRect(r, paint);
+    }
+    stats->expectTrue(bitmaps_eq(round, plain), "round_rect_zero_radii");
+
+    // Pixels whose centers are clearly inside the oval are filled, and clearly outside are not.
+    const float cx = 19.3f, cy = 13.6f, rx = 16.2f, ry = 10.9f;
+    const GRect oval = GRect::MakeLTRB(cx - rx, cy - ry, cx + rx, cy + ry);
+    a->clear({1, 1, 1, 1});
+    a->drawOval(oval, GPaint({1, 0, 0, 0}));
+    bool inside = true;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const float dx = (x + 0.5f - cx) / rx, dy = (y + 0.5f - cy) / ry;
+            const float d = dx * dx + dy * dy;
+            const GPixel p = *round.getAddr(x, y);
+            inside &= !(d < 0.98f && p != black) && !(d > 1.02f && p != white);
+        }
+    }
+    stats->expectTrue(inside, "oval_centers");
+
+    // Scales, translates and x/y swaps are scanned in device space to the same pixels.
+    a->clear({1, 1, 1, 1});
+    b->clear({1, 1, 1, 1});
+    a->save();
+    a->concat(GMatrix(0, 2, 1, 2, 0, 3));
+    a->drawRoundRect(GRect::MakeLTRB(1.25f, 2.5f, 12.75f, 14), 3, 4.5f, GPaint({1, 0, 0, 1}));
+    a->restore();
+    b->drawRoundRect(GRect::MakeLTRB(6, 5.5f, 29, 28.5f), 9, 6, GPaint({1, 0, 0, 1}));
+    stats->expectTrue(bitmaps_eq(round, plain), "round_rect_swapped");
+
+    // Anti-aliased: the interior is solid, the outside untouched, and the partly covered edge
+    // pixels add up to the oval's area.
+    a->clear({1, 1, 1, 1});
+    a->drawOval(oval, GPaint({1, 0, 0, 0}).setAntiAlias(true));
+    bool solid = true;
+    int partial = 0;
+    float covered = 0;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const float dx = (x + 0.5f - cx) / rx, dy = (y + 0.5f - cy) / ry;
+            const float d = sqrtf(dx * dx + dy * dy);
+            const GPixel p = *round.getAddr(x, y);
+            solid &= !(d < 0.9f && p != black) && !(d > 1.1f && p != white);
+            partial += p != black && p != white;
+            covered += (255 - GPixel_GetR(p)) / 255.0f;
+        }
+    }
+    const float area = 3.14159265f * rx * ry;
+    stats->expectTrue(solid && partial > 0 && fabsf(covered - area) < area * 0.01f, "oval_aa");
+
+    free(round.pixels());
+    free(plain.pixels());
+}
+
+static void test_stats(GTestStats* stats) {
+    GBitmap bitmap;
+    setup_bitmap(&bitmap, 20, 20);
+    auto canvas = GCreateCanvas(bitmap);
+    GStats frame, draw;
+#ifdef G_STATS
+    // A rect is blitted row by row, with no edges.
+    canvas->drawRect(GRect::MakeLTRB(2, 3, 12, 8), GPaint({1, 1, 0, 0}));
+    canvas->getStats(&frame, &draw);
+    stats->expectTrue(draw.fDraws == 1 && draw.fSpans == 5 && draw.fPixelsBlended == 50 &&
+                      draw.fEdges == 0 && draw.fPixelsShaded == 0, "stats_rect");
+
+    // A wide line draws its quad through drawConvexPolygon, but is one draw.
+    canvas->drawLine({2, 2}, {18, 18}, 4, GPaint({1, 0, 1, 0}));
+    canvas->getStats(&frame, &draw);
+    stats->expectTrue(draw.fDraws == 1 && draw.fEdges >= 2 && draw.fSpans > 0 &&
+                      frame.fDraws == 2 && frame.fSpans > 5, "stats_nested");
+
+    canvas->saveLayer(GRect::MakeWH(10, 10));
+    canvas->restore();
+    canvas->getStats(&frame, nullptr);
+    stats->expectTrue(frame.fLayers == 1 && frame.fLayerBytes == 10 * 10 * 4, "stats_layer");
+
+    canvas->resetStats();
+    canvas->getStats(&frame, &draw);
+    stats->expectTrue(frame.fDraws == 0 && frame.fSpans == 0 && draw.fDraws == 0,
+                      "stats_reset");
+#else
+    // Without G_STATS nothing is counted.
+    canvas->drawRect(GRect::MakeLTRB(2, 3, 12, 8), GPaint({1, 1, 0, 0}));
+    stats->expectTrue(!canvas->getStats(&frame, &draw) && frame.fDraws == 0, "stats_off");
+#endif
+    free(bitmap.pixels());
+}
+
+#ifdef G_TRACE
+static std::string read_text_file(const char path[]) {
+    std::string text;
+    if (FILE* f = fopen(path, "r")) {
+        char buffer[256];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+            text.append(buffer, n);
+        }
+        fclose(f);
+    }
+    return text;
+}
+#endif
+
+static void test_trace(GTestStats* stats) {
+    GBitmap bitmap;
+    setup_bitmap(&bitmap, 20, 20);
+    auto canvas = GCreateCanvas(bitmap);
+    const char* file = "trace_test.json";
+    GTrace::Reset();
+    GPath path;
+    path.moveTo(2, 2).lineTo(18, 4).lineTo(8, 16);
+    canvas->drawPath(path, GPaint({1, 0, 0, 1}));
+    canvas->saveLayer(nullptr, GPaint());
+    canvas->restore();
+#ifdef G_TRACE
+    stats->expectTrue(GTrace::WriteJSON(file), "trace_write");
+    std::string json = read_text_file(file);
+    stats->expectTrue(json.find("{\"traceEvents\":[") == 0 &&
+                      json.find("\"name\":\"drawPath\",\"cat\":\"canvas\",\"ph\":\"X\"") !=
+                      std::string::npos && json.find("\"onSaveLayer\"") != std::string::npos &&
+                      json.find("\"restore\"") != std::string::npos, "trace_events");
+
+    // Reset forgets what was recorded.
+    GTrace::Reset();
+    GTrace::WriteJSON(file);
+    json = read_text_file(file);
+    stats->expectTrue(!json.empty() && json.find("\"name\"") == std::string::npos,
+                      "trace_reset");
+#else
+    // Without G_TRACE nothing is recorded, and there is nothing to write.
+    stats->expectTrue(!GTrace::WriteJSON(file), "trace_off");
+#endif
+    remove(file);
+    free(bitmap.pixels());
+}
+
+static void test_overdraw(GTestStats* stats) {
+    GBitmap bitmap;
+    setup_bitmap(&bitmap, 20, 20);
+    auto canvas = GCreateCanvas(bitmap);
+    GOverdrawCanvas overdraw(canvas.get(), 20, 20);
+
+    // An opaque background, an opaque square over part of it, then a translucent rect over both.
+    overdraw.drawPaint(GPaint({1, 1, 1, 1}));
+    overdraw.drawRect(GRect::MakeLTRB(0, 0, 5, 5), GPaint({1, 1, 0, 0}));
+    overdraw.drawRect(GRect::MakeLTRB(0, 0, 10, 10), GPaint({0.5f, 0, 0, 1}));
+
+    // The proxy still draws.
+    stats->expectTrue(abs(GPixel_GetR(*bitmap.getAddr(2, 2)) - 0x80) <= 1 &&
+                      *bitmap.getAddr(15, 15) == GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF),
+                      "overdraw_proxy");
+
+    GOverdrawCanvas::Report report;
+    overdraw.getReport(&report);
+    stats->expectTrue(report.fPixels == 400 && report.fVisible == 400 &&
+                      report.fWrites == 400 + 25 + 100 && report.fMaxOverdraw == 3 &&
+                      fabsf(report.fAverageOverdraw - 525 / 400.0f) < 1e-6f &&
+                      fabsf(report.fWritesPerVisible - 525 / 400.0f) < 1e-6f, "overdraw_counts");
+
+    // Only the square replaced anything: the 25 background pixels under it.
+    stats->expectTrue(report.fHidden == 25 && report.fWorst.size() == 1 &&
+                      report.fWorst[0].fIndex == 0 && report.fWorst[0].fHidden == 25 &&
+                      !strcmp(report.fWorst[0].fName, "drawPaint") &&
+                      report.fWorst[0].fPixels == 400, "overdraw_worst");
+
+    GBitmap heatmap;
+    overdraw.makeHeatmap(&heatmap);
+    stats->expectTrue(heatmap.width() == 20 && heatmap.height() == 20 &&
+                      *heatmap.getAddr(2, 2) != *heatmap.getAddr(7, 7) &&
+                      *heatmap.getAddr(7, 7) != *heatmap.getAddr(15, 15) &&
+                      *heatmap.getAddr(15, 2) == *heatmap.getAddr(15, 15), "overdraw_heatmap");
+    free(heatmap.pixels());
+
+    // A layer's draws reach the device only through its composite, and don't hide anything.
+    overdraw.reset();
+    GRect bounds = GRect::MakeLTRB(0, 0, 10, 20);
+    overdraw.saveLayer(&bounds, GPaint());
+    overdraw.translate(5, 0);
+    overdraw.drawPaint(GPaint({1, 0, 1, 0}));
+    overdraw.restore();
+    overdraw.drawRect(GRect::MakeLTRB(0, 0, 20, 20), GPaint({1, 0, 0, 0}));
+    overdraw.getReport(&report);
+    stats->expectTrue(report.fWrites == 200 + 400 && report.fVisible == 400 &&
+                      report.fHidden == 200 && report.fWorst.size() == 1 &&
+                      !strcmp(report.fWorst[0].fName, "saveLayer"), "overdraw_layer");
+
+    free(bitmap.pixels());
+}
+
+static void test_differential(GTestStats* stats) {
+    // The fast paths draw exactly what the reference backend does.
+    GDifferential differential(64, 64);
+    bool exact = true;
+    int maxDiff = 0;
+    for (uint32_t seed = 1; seed <= 40; ++seed) {
+        GDifferential::Result result;
+        exact &= differential.run(seed, 30, &result);
+        maxDiff = std::max(maxDiff, result.fMaxDiff);
+    }
+    stats->expectTrue(exact && maxDiff == 0, "differential_exact");
+
+    // Translucent content each backend draws by its own code: the optimized canvas batches the
+    // rects and points and scans the convex path with two edges, while the reference loops over
+    // single draws and uses the general edge scanner. A clip mask covers all of it.
+    const int W = 32, H = 32;
+    GBitmap optimized, reference;
+    setup_bitmap(&optimized, W, H);
+    setup_bitmap(&reference, W, H);
+    auto fast = GCreateCanvas(optimized);
+    auto slow = GCreateCanvas(reference, GBackend::kReference);
+    GPath clip, tri;
+    clip.moveTo(2, 1).lineTo(30, 6).lineTo(21, 31).lineTo(4, 24).lineTo(12, 14);
+    tri.moveTo(3, 29).lineTo(16, 2.5f).lineTo(29.5f, 27);
+    const GRect rects[] = { GRect::MakeLTRB(0, 0, 20, 18), GRect::MakeLTRB(8, 6, 32, 26),
+                            GRect::MakeLTRB(4.5f, 12.5f, 26.5f, 30.5f) };
+    const GColor rectColors[] = { {0.5f, 1, 0, 0}, {0.75f, 0, 1, 0}, {0.25f, 0, 0, 1} };
+    const GPoint points[] = { {6, 6}, {25, 9}, {14, 22} };
+    for (GCanvas* c : { fast.get(), slow.get() }) {
+        c->clear({1, 1, 1, 1});
+        c->clipPath(clip);
+        c->drawRects(rects, 3, GPaint(), rectColors);
+        c->drawPath(tri, GPaint({0.6f, 1, 1, 0}));
+        c->drawPoints(points, 3, 5, GPaint({0.5f, 0, 0, 0}));
+    }
+    stats->expectTrue(fast && slow && bitmaps_eq(optimized, reference) &&
+                      *reference.getAddr(0, 0) == GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF) &&
+                      *reference.getAddr(16, 14) != *reference.getAddr(0, 0),
+                      "differential_reference");
+    free(optimized.pixels());
+    free(reference.pixels());
+}
+
+static float segment_distance(GPoint p, GPoint a, GPoint b) {
+    const GVector ab = b - a, ap = p - a;
+    const float len2 = ab.fX * ab.fX + ab.fY * ab.fY;
+    float t = len2 > 0 ? (ap.fX * ab.fX + ap.fY * ab.fY) / len2 : 0;
+    t = std::max(0.0f, std::min(1.0f, t));
+    return (p - (a + ab * t)).length();
+}
+
+static void test_stroker(GTestStats* stats) {
+    const int W = 60, H = 50;
+    const GPixel white = GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF);
+    GBitmap bitmap;
+    setup_bitmap(&bitmap, W, H);
+    auto canvas = GCreateCanvas(bitmap);
+    auto drawn = [&](int x, int y) { return *bitmap.getAddr(x, y) != white; };
+    auto stroke = [&](const GPath& src, const GStroker& proto) {
+        GStroker stroker = proto;
+        GPath dst;
+        stroker.strokePath(src, &dst);
+        canvas->clear({1, 1, 1, 1});
+        canvas->drawPath(dst, GPaint({0.5f, 0, 0, 1}));
+    };
+    // With round joins and caps, a stroke covers the points within width/2 of its polyline,
+    // each pixel blended once. drawPath() places sloped edges up to half a pixel off, so pixel
+    // centers within a pixel of the stroke's edge are not checked.
+    auto matches = [&](const std::vector<GPoint>& poly, float width) {
+        GPixel color = 0;
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                const GPoint center = { x + 0.5f, y + 0.5f };
+                float d = 1e9f;
+                for (size_t i = 0; i + 1 < poly.size(); ++i) {
+                    d = std::min(d, segment_distance(center, poly[i], poly[i + 1]));
+                }
+                const GPixel p = *bitmap.getAddr(x, y);
+                if (p != white && color == 0) {
+                    color = p;
+                }
+                if ((d < width / 2 - 1 && p == white) || (d > width / 2 + 1 && p != white) ||
+                    (p != white && p != color)) {
+                    return false;
+                }
+            }
+        }
+        return color != 0;
+    };
+
+    GPath path;
+    path.moveTo(5, 8).lineTo(40, 30).lineTo(12, 40).lineTo(50, 12);
+    stroke(path, GStroker(7, GStroker::kRound_Join, GStroker::kRound_Cap));
+    stats->expectTrue(matches({ {5, 8}, {40, 30}, {12, 40}, {50, 12} }, 7), "stroker_round");
+
+    // Curves are offset to within the tolerance.
+    const GPoint cubic[] = { {6, 40}, {10, -10}, {55, 60}, {54, 6} };
+    path = GPath();
+    path.moveTo(cubic[0]).cubicTo(cubic[1], cubic[2], cubic[3]);
+    stroke(path, GStroker(6, GStroker::kRound_Join, GStroker::kRound_Cap));
+    std::vector<GPoint> flat;
+    for (int i = 0; i <= 200; ++i) {
+        const float t = i / 200.0f, u = 1 - t;
+        flat.push_back(cubic[0] * (u * u * u) + cubic[1] * (3 * u * u * t) +
+                       cubic[2] * (3 * u * t * t) + cubic[3] * (t * t * t));
+    }
+    stats->expectTrue(matches(flat, 6), "stroker_cubic");
+
+    // A closed contour is hollow, and butt caps end at the end points while square caps
+    // reach width/2 past them.
+    path = GPath();
+    path.moveTo(10, 10).lineTo(40, 10).lineTo(40, 40).lineTo(10, 40).lineTo(10, 10);
+    stroke(path, GStroker(4));
+    stats->expectTrue(drawn(10, 10) && drawn(8, 8) && drawn(39, 25) && !drawn(25, 25) &&
+                      !drawn(6, 25), "stroker_closed");
+    path = GPath();
+    path.moveTo(10, 20).lineTo(40, 20);
+    stroke(path, GStroker(6));
+    const bool butt = drawn(10, 20) && !drawn(9, 20) && drawn(39, 20) && !drawn(40, 20);
+    stroke(path, GStroker(6, GStroker::kMiter_Join, GStroker::kSquare_Cap));
+    stats->expectTrue(butt && drawn(7, 20) && !drawn(6, 20) && drawn(42, 20) &&
+                      !drawn(43, 20), "stroker_caps");
+
+    // A right angle's miter fills the outer corner, which a bevel cuts off. Sharper corners than
+    // the miter limit are beveled too.
+    path = GPath();
+    path.moveTo(10, 30).lineTo(30, 30).lineTo(30, 45);
+    stroke(path, GStroker(8));
+    const bool miter = drawn(33, 26);
+    stroke(path, GStroker(8, GStroker::kBevel_Join));
+    const bool bevel = !drawn(33, 26) && drawn(30, 27);
+    stroke(path, GStroker(8, GStroker::kMiter_Join, GStroker::kButt_Cap, 1.2f));
+    stats->expectTrue(miter && bevel && !drawn(33, 26), "stroker_joins");
+
+    free(bitmap.pixels());
+}
+
+static void test_lines(GTestStats* stats) {
+    const int W = 40, H = 30;
+    const GPixel white = GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF);
+    GBitmap bitmap;
+    setup_bitmap(&bitmap, W, H);
+    auto canvas = GCreateCanvas(bitmap);
+    // Count the pixels drawn, and check they were all blended the same number of times.
+    auto count_drawn = [&](bool* uniform) {
+        int drawn = 0;
+        GPixel color = white;
+        *uniform = true;
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                const GPixel p = *bitmap.getAddr(x, y);
+                if (p != white) {
+                    *uniform &= drawn == 0 || p == color;
+                    color = p;
+                    drawn += 1;
+                }
+            }
+        }
+        return drawn;
+    };
+
+    // A hairline steps from pixel center to pixel center, leaving out its end.
+    canvas->clear({1, 1, 1, 1});
+    canvas->drawLine({2.5f, 4.3f}, {12.5f, 4.3f}, 0, GPaint({1, 0, 0, 0}));
+    stats->expectTrue(only_inside(bitmap, GIRect::MakeLTRB(2, 4, 12, 5),
+                                  GPixel_PackARGB(0xFF, 0, 0, 0), white), "hairline");
+
+    // Hairlines stay one pixel wide when scaled, and a translucent polyline blends each pixel
+    // once, joints included.
+    canvas->clear({1, 1, 1, 1});
+    canvas->save();
+    canvas->scale(2, 2);
+    const GPoint zigzag[] = { {1, 1}, {10, 1}, {10, 7.5f}, {3, 13}, {18, 13} };
+    canvas->drawPolyline(zigzag, 5, 0, GPaint({0.5f, 0, 0, 1}));
+    canvas->restore();
+    bool once;
+    const int drawn = count_drawn(&once);
+    // 18 columns, 13 rows, then 14 columns and 30 columns
+    stats->expectTrue(once && drawn == 18 + 13 + 14 + 30, "hairline_polyline");
+
+    // Anti-aliased hairlines share each step's coverage between two pixels.
+    canvas->clear({1, 1, 1, 1});
+    canvas->drawLine({3, 2.2f}, {37, 19.6f}, 0, GPaint({1, 0, 0, 0}).setAntiAlias(true));
+    bool shared = true;
+    int partial = 0;
+    for (int x = 3; x < 37; ++x) {
+        int column = 0;
+        for (int y = 0; y < H; ++y) {
+            const int v = 255 - GPixel_GetR(*bitmap.getAddr(x, y));
+            column += v;
+            partial += v > 0 && v < 255;
+        }
+        shared &= abs(column - 255) <= 1;
+    }
+    stats->expectTrue(shared && partial > 20, "hairline_aa");
+
+    // Thin lines fill the pixels whose centers are inside their quad, each once.
+    canvas->clear({1, 1, 1, 1});
+    const GPoint p0 = {4.2f, 25.1f}, p1 = {35.7f, 3.4f};
+    const float width = 1.5f;
+    canvas->drawLine(p0, p1, width, GPaint({0.5f, 0, 0, 1}));
+    const GVector dir = { p1.x() - p0.x(), p1.y() - p0.y() };
+    const float length = dir.length();
+    bool inside = true;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            const GVector v = { x + 0.5f - p0.x(), y + 0.5f - p0.y() };
+            const float along = (v.fX * dir.fX + v.fY * dir.fY) / length;
+            const float across = fabsf(v.fX * dir.fY - v.fY * dir.fX) / length;
+            const bool in = along > 0.05f && along < length - 0.05f && across < width / 2 - 0.05f;
+            const bool out = along < -0.05f || along > length + 0.05f ||
+                             across > width / 2 + 0.05f;
+            const GPixel p = *bitmap.getAddr(x, y);
+            inside &= !(in && p == white) && !(out && p != white);
+        }
+    }
+    stats->expectTrue(inside && count_drawn(&once) > 0 && once, "thin_line");
+
+    // A line under a pixel wide plays back from a picture as it draws directly.
+    GBitmap played;
+    setup_bitmap(&played, W, H);
+    auto player = GCreateCanvas(played);
+    GRecordingCanvas recorder;
+    for (GCanvas* c : { canvas.get(), (GCanvas*)&recorder }) {
+        c->clear({1, 1, 1, 1});
+        c->drawLine(p0, p1, 0.5f, GPaint({1, 0, 0, 1}));
+        c->drawLine({3, 30}, {36, 29.5f}, 0.5f, GPaint({1, 1, 0, 0}));
+    }
+    recorder.finishRecording()->playback(player.get());
+    stats->expectTrue(bitmaps_eq(bitmap, played) && count_drawn(&once) > 0, "thin_line_picture");
+    free(played.pixels());
+
+    // Wide lines are their quads.
+    const GPoint wide[] = { {3, 3}, {30, 8}, {12, 26} };
+    canvas->clear({1, 1, 1, 1});
+    canvas->drawPolyline(wide, 3, 3.5f, GPaint({1, 0, 0, 1}));
+    GBitmap quads;
+    setup_bitmap(&quads, W, H);
+    auto expected = GCreateCanvas(quads);
+    expected->clear({1, 1, 1, 1});
+    for (int i = 0; i < 2; ++i) {
+        GVector norm = { wide[i + 1].y() - wide[i].y(), wide[i].x() - wide[i + 1].x() };
+        norm = norm * (1.75f / norm.length());
+        const GPoint quad[] = { wide[i] + norm, wide[i + 1] + norm, wide[i + 1] - norm,
+                                wide[i] - norm };
+        expected->drawConvexPolygon(quad, 4, GPaint({1, 0, 0, 1}));
+    }
+    stats->expectTrue(bitmaps_eq(bitmap, quads), "wide_polyline");
+    free(quads.pixels());
+
+    free(bitmap.pixels());
+}
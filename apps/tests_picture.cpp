@@ -0,0 +1,514 @@
+#include "GCanvas.h"
+#include "GBitmap.h"
+#include "GPath.h"
+#include "GPicture.h"
+#include "GPictureIndex.h"
+#include "GPicturePlayer.h"
+#include "GProxyCanvas.h"
+#include "GScene.h"
+#include "GSceneParser.h"
+#include "GShader.h"
+#include "GRandom.h"
+#include "tests.h"
+
+static void draw_picture_scene(GCanvas* canvas) {
+    GPaint paint({1, 1, 0, 0});
+    canvas->drawRect(GRect::MakeLTRB(2, 2, 30, 20), paint);
+    canvas->save();
+    canvas->translate(5, 7);
+    canvas->scale(1.5f, 0.75f);
+    const GPoint tri[] = { {0, 0}, {20, 4}, {6, 24} };
+    canvas->drawConvexPolygon(tri, 3, GPaint({0.5f, 0, 1, 0}));
+    GPath path;
+    path.moveTo(1, 1).lineTo(25, 3).quadTo(30, 20, 10, 28).cubicTo(5, 20, 0, 10, 1, 1);
+    canvas->drawPath(path, paint);
+    canvas->restore();
+    canvas->saveLayer(GPaint({1, 0, 0, 0}).setBlendMode(GBlendMode::kSrcOver));
+    canvas->drawRect(GRect::MakeLTRB(10, 10, 40, 40), GPaint({0.25f, 0, 0, 1}));
+    canvas->restore();
+}
+
+static bool bitmaps_eq(const GBitmap& a, const GBitmap& b) {
+    for (int y = 0; y < a.height(); ++y) {
+        if (memcmp(a.getAddr(0, y), b.getAddr(0, y), a.width() * sizeof(GPixel))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_picture_playback(GTestStats* stats) {
+    const int W = 48, H = 48;
+    GBitmap direct, replay;
+    setup_bitmap(&direct, W, H);
+    setup_bitmap(&replay, W, H);
+
+    draw_picture_scene(GCreateCanvas(direct).get());
+
+    GRecordingCanvas recorder;
+    draw_picture_scene(&recorder);
+    auto picture = recorder.finishRecording();
+    stats->expectEQ(picture->countOps(), 10, "picture_op_count");
+    stats->expectEQ(picture->countPaints(), 4, "picture_paint_dedup");
+
+    picture->playback(GCreateCanvas(replay).get());
+    stats->expectTrue(bitmaps_eq(direct, replay), "picture_playback");
+
+    // Replaying a prefix, then the rest, must match replaying everything at once.
+    clear(replay);
+    auto canvas = GCreateCanvas(replay);
+    picture->playback(canvas.get(), 0, 5);
+    picture->playback(canvas.get(), 5, picture->countOps());
+    stats->expectTrue(bitmaps_eq(direct, replay), "picture_playback_split");
+
+    stats->expectEQ(recorder.finishRecording()->countOps(), 0, "picture_reset");
+
+    free(direct.pixels());
+    free(replay.pixels());
+}
+
+static void test_picture_optimize(GTestStats* stats) {
+    const int W = 40, H = 40;
+    GRecordingCanvas recorder;
+    recorder.drawRect(GRect::MakeLTRB(4, 4, 20, 20), GPaint({0.5f, 1, 0, 0}));    // occluded
+    recorder.save();
+    recorder.concat(GMatrix());                                                 // identity
+    recorder.restore();
+    recorder.drawRect(GRect::MakeLTRB(50, 50, 60, 60), GPaint({1, 0, 1, 0}));     // offscreen
+    recorder.save();
+    recorder.translate(2, 2);
+    recorder.fillRect(GRect::MakeLTRB(0, 0, 30, 30), {1, 0, 0, 1});              // occluder
+    recorder.restore();
+    recorder.save();
+    recorder.translate(2, 2);
+    recorder.fillRect(GRect::MakeLTRB(10, 10, 36, 20), {0.5f, 0, 1, 1});
+    recorder.scale(3, 3);                                                       // never used
+    recorder.restore();
+    auto picture = recorder.finishRecording();
+
+    GPictureOptimizeStats optStats;
+    auto optimized = GOptimizePicture(*picture, {W, H}, &optStats);
+    stats->expectEQ(optStats.fDrawsRejected, 1, "optimize_rejected");
+    stats->expectEQ(optStats.fDrawsOccluded, 1, "optimize_occluded");
+    stats->expectEQ(optStats.fPixelsRemoved, (int64_t)16*16, "optimize_pixels");
+    stats->expectEQ(optimized->countOps(), 5, "optimize_op_count");
+
+    GBitmap a, b;
+    setup_bitmap(&a, W, H);
+    setup_bitmap(&b, W, H);
+    picture->playback(GCreateCanvas(a).get());
+    optimized->playback(GCreateCanvas(b).get());
+    stats->expectTrue(bitmaps_eq(a, b), "optimize_playback");
+    free(a.pixels());
+    free(b.pixels());
+}
+
+static void test_picture_player(GTestStats* stats) {
+    const int W = 32, H = 32;
+    GRecordingCanvas recorder;
+    GRandom rand;
+    for (int i = 0; i < 300; ++i) {
+        if (i % 50 == 10) {
+            recorder.saveLayer(GPaint({0.5f, 0, 0, 0}));
+        } else if (i % 50 == 20) {
+            recorder.restore();
+        }
+        if (i % 7 == 0) {
+            recorder.save();
+            recorder.translate(rand.nextF() * 4, rand.nextF() * 4);
+        }
+        GRect r = GRect::MakeXYWH(rand.nextF() * W, rand.nextF() * H, 8, 8);
+        recorder.fillRect(r, {0.5f + rand.nextF() * 0.5f, rand.nextF(), rand.nextF(), 1});
+        if (i % 7 == 3) {
+            recorder.restore();
+        }
+    }
+    auto picture = recorder.finishRecording();
+
+    GBitmap expected, actual;
+    setup_bitmap(&expected, W, H);
+    setup_bitmap(&actual, W, H);
+
+    // A budget of a few snapshots forces the player to thin them out as it goes.
+    GPicturePlayer player(picture.get(), 16, 6 * W * H * sizeof(GPixel));
+    player.reset(actual);
+
+    bool match = true;
+    const int counts[] = { 0, 100, 37, 400, 250, 251, 17, picture->countOps(), 399, 1 };
+    for (int n : counts) {
+        clear(expected);
+        picture->playback(GCreateCanvas(expected).get(), 0, n);
+        player.draw(actual, n);
+        match &= bitmaps_eq(expected, actual);
+    }
+    stats->expectTrue(match, "player_prefix");
+    stats->expectTrue(player.bytesUsed() <= 6 * W * H * sizeof(GPixel), "player_budget");
+    stats->expectTrue(player.countSnapshots() > 1, "player_snapshots");
+
+    free(expected.pixels());
+    free(actual.pixels());
+}
+
+static void test_scene_roundtrip(GTestStats* stats) {
+    const int W = 48, H = 48;
+    GRecordingCanvas recorder;
+    draw_picture_scene(&recorder);
+    recorder.drawPaint(GPaint({0.25f, 1, 1, 0}).setBlendMode(GBlendMode::kDstOver));
+    auto picture = recorder.finishRecording();
+
+    std::vector<uint8_t> data;
+    stats->expectTrue(GScene::Encode(*picture, &data), "scene_encode");
+    auto scene = GScene::MakeFromData(data.data(), data.size());
+    stats->expectTrue(scene != nullptr, "scene_load");
+    if (!scene) {
+        return;
+    }
+    stats->expectEQ(scene->countOps(), picture->countOps(), "scene_op_count");
+
+    GBitmap expected, actual;
+    setup_bitmap(&expected, W, H);
+    setup_bitmap(&actual, W, H);
+    picture->playback(GCreateCanvas(expected).get());
+    scene->playback(GCreateCanvas(actual).get());
+    stats->expectTrue(bitmaps_eq(expected, actual), "scene_playback");
+    free(expected.pixels());
+    free(actual.pixels());
+
+    // Truncated or mismatched data must be rejected, not played back.
+    stats->expectTrue(!GScene::MakeFromData(data.data(), data.size() - 4), "scene_truncated");
+    std::vector<uint8_t> bad(data);
+    reinterpret_cast<GScene::Header*>(bad.data())->fVersion += 1;
+    stats->expectTrue(!GScene::MakeFromData(bad.data(), bad.size()), "scene_version");
+    bad = data;
+    const uint32_t opOffset = reinterpret_cast<GScene::Header*>(bad.data())->fOpOffset;
+    reinterpret_cast<GScene::Op*>(bad.data() + opOffset)->fPointCount = 1000000;
+    stats->expectTrue(!GScene::MakeFromData(bad.data(), bad.size()), "scene_bad_range");
+
+    GBitmap shaded;
+    setup_bitmap(&shaded, 4, 4);
+    auto shader = GCreateBitmapShader(shaded, GMatrix());
+    recorder.drawPaint(GPaint(shader.get()));
+    stats->expectTrue(!GScene::Encode(*recorder.finishRecording(), &data), "scene_no_shaders");
+    free(shaded.pixels());
+}
+
+static void draw_parser_scene(GCanvas* canvas) {
+    GPath path;
+    GPaint paint;
+    canvas->scale(0.5, 0.5);
+    canvas->save();
+    canvas->concat(GMatrix(1.15385, 0, 3, 0, 0.840206, -2.5e-1));
+    paint.setColor({1, 0.486275, 0.305882, 0.196078});
+    path.reset().moveTo(14, 85).lineTo(17, 94).lineTo(89, 94).cubicTo(89, 94, 94, 85, 93, 84);
+    canvas->drawPath(path, paint);
+    paint.setColor({0.5, 0, 0, 1}).setBlendMode(GBlendMode::kDstOver);
+    path.reset().moveTo(54, 35).quadTo(54.0262, 29.6109, 58.2982, 27.8423).lineTo(54, 35);
+    canvas->drawPath(path, paint);
+    canvas->restore();
+    canvas->fillRect(GRect::MakeXYWH(4, 4, 20.5, 10), {1, 0, 1, 0});
+}
+
+static const char gParserSceneText[] =
+    "// the same calls as draw_parser_scene()\n"
+    "canvas->scale(0.5, 0.5);\n"
+    "canvas->save();\n"
+    "canvas->concat(GMatrix(1.15385,0,3,0,0.840206,-2.5e-1));\n"
+    "paint.setColor({1,0.486275,0.305882,0.196078});\n"
+    "path.reset().moveTo(14,85).lineTo(17,94).lineTo(89,94)\n"
+    "    .cubicTo(89,94,94,85,93,84);   /* split; across lines */\n"
+    "canvas->drawPath(path, paint);\n"
+    "paint.setColor({0.5f, 0, 0, 1}).setBlendMode(GBlendMode::kDstOver);\n"
+    "path.reset().moveTo(54,35).quadTo(54.0262,29.6109,58.2982,27.8423).lineTo(54,35);\n"
+    "canvas->drawPath(path, paint);\n"
+    "canvas->restore();\n"
+    "canvas->fillRect(GRect::MakeXYWH(4, 4, 20.5, 10), {1, 0, 1, 0});\n";
+
+// Keeps the last matrix concatenated onto it, so tests can see the floats a parser produced.
+class ConcatCanvas : public GProxyCanvas {
+public:
+    ConcatCanvas() : GProxyCanvas(nullptr) {}
+
+    void concat(const GMatrix& m) override { fMatrix = m; }
+
+    GMatrix fMatrix;
+};
+
+static void test_scene_parser(GTestStats* stats) {
+    const int W = 64, H = 64;
+    GBitmap expected, actual;
+    setup_bitmap(&expected, W, H);
+    setup_bitmap(&actual, W, H);
+    draw_parser_scene(GCreateCanvas(expected).get());
+
+    auto canvas = GCreateCanvas(actual);
+    GSceneParser parser(canvas.get());
+    stats->expectTrue(parser.parse(gParserSceneText, sizeof(gParserSceneText) - 1),
+                      "parser_parse");
+    stats->expectTrue(bitmaps_eq(expected, actual), "parser_pixels");
+
+    // Feeding one byte at a time must give the same result as the whole text at once.
+    clear(actual);
+    canvas = GCreateCanvas(actual);
+    parser.reset(canvas.get());
+    bool ok = true;
+    for (const char* p = gParserSceneText; *p; ++p) {
+        ok &= parser.write(p, 1);
+    }
+    ok &= parser.finish();
+    stats->expectTrue(ok, "parser_stream");
+    stats->expectTrue(bitmaps_eq(expected, actual), "parser_stream_pixels");
+
+    // Saves left open by the text are restored by finish().
+    clear(expected);
+    clear(actual);
+    GCreateCanvas(expected)->fillRect(GRect::MakeXYWH(0, 0, 8, 8), {1, 1, 0, 0});
+    canvas = GCreateCanvas(actual);
+    const char open[] = "canvas->save(); canvas->translate(20, 20);";
+    parser.reset(canvas.get());
+    stats->expectTrue(parser.parse(open, sizeof(open) - 1), "parser_open_save");
+    canvas->fillRect(GRect::MakeXYWH(0, 0, 8, 8), {1, 1, 0, 0});
+    stats->expectTrue(bitmaps_eq(expected, actual), "parser_restores");
+
+    const char bad[] = "canvas->save();\ncanvas->restore();\n\npath.moveTo(1, 2).lineTo(3);\n";
+    parser.reset(canvas.get());
+    stats->expectTrue(!parser.parse(bad, sizeof(bad) - 1), "parser_error");
+    stats->expectEQ(parser.errorLine(), 4, "parser_error_line");
+    stats->expectTrue(!parser.write("canvas->save();", 15), "parser_error_sticky");
+
+    parser.reset(canvas.get());
+    stats->expectTrue(!parser.parse("canvas->save()", 14), "parser_missing_semicolon");
+
+    // Just above the halfway point between 1 and the next float: rounding to a double first
+    // lands exactly on it, so only an 'f' literal rounded once straight to float rounds up.
+    ConcatCanvas concat;
+    const char halfway[] = "canvas->translate(1.0000000596046448f, 1.0000000596046448);";
+    parser.reset(&concat);
+    stats->expectTrue(parser.parse(halfway, sizeof(halfway) - 1) &&
+                      concat.fMatrix[GMatrix::TX] == 1.0000000596046448f &&
+                      concat.fMatrix[GMatrix::TY] == (float)1.0000000596046448 &&
+                      concat.fMatrix[GMatrix::TX] != concat.fMatrix[GMatrix::TY],
+                      "parser_float_rounding");
+
+    free(expected.pixels());
+    free(actual.pixels());
+}
+
+static void test_picture_tiled(GTestStats* stats) {
+    const int W = 100, H = 77;
+    GRecordingCanvas recorder;
+    GRandom rand;
+    recorder.drawPaint(GPaint({1, 0.9f, 0.9f, 0.9f}));
+    for (int i = 0; i < 200; ++i) {
+        if (i % 40 == 5) {
+            recorder.saveLayer(GPaint({0.75f, 0, 0, 0}));
+        } else if (i % 40 == 25) {
+            recorder.restore();
+        }
+        recorder.save();
+        recorder.translate(rand.nextF() * W, rand.nextF() * H);
+        recorder.rotate(rand.nextF() * 3);
+        const GColor color = {0.25f + rand.nextF() * 0.75f, rand.nextF(), rand.nextF(),
+                              rand.nextF()};
+        if (i % 3 == 0) {
+            recorder.fillRect(GRect::MakeXYWH(-5, -5, rand.nextF() * 30, rand.nextF() * 20),
+                              color);
+        } else {
+            GPath path;
+            path.moveTo(0, 0).lineTo(rand.nextF() * 20, 3).quadTo(15, 15, 2, rand.nextF() * 25)
+                .cubicTo(-10, 5, 8, -12, 0, 0);
+            recorder.drawPath(path, GPaint(color));
+        }
+        recorder.restore();
+    }
+    auto picture = recorder.finishRecording();
+
+    GBitmap serial, tiled;
+    setup_bitmap(&serial, W, H);
+    setup_bitmap(&tiled, W, H);
+    picture->playback(GCreateCanvas(serial).get());
+
+    GPictureIndex index(*picture, {W, H}, 8);
+    GPlaybackTiled(index, tiled, 16, 4);
+    stats->expectTrue(bitmaps_eq(serial, tiled), "tiled_playback");
+
+    // Everything outside the clip stays untouched.
+    clear(tiled);
+    std::vector<int> ops;
+    const GIRect area = GIRect::MakeLTRB(10, 20, 30, 25);
+    index.query(area, &ops);
+    index.playback(GCreateClippedCanvas(tiled, area).get(), ops);
+    bool inside = true, outside = true;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            if (area.contains(x, y)) {
+                inside &= *tiled.getAddr(x, y) == *serial.getAddr(x, y);
+            } else {
+                outside &= *tiled.getAddr(x, y) == 0;
+            }
+        }
+    }
+    stats->expectTrue(inside && outside, "tiled_clip");
+    stats->expectTrue(ops.size() < 150, "tiled_query");
+
+    // Each thread shades with its own copy, so draws with different CTMs don't race.
+    auto shader = GCreateLinearGradient({0, 0}, {12, 0}, {1, 1, 0, 0}, {1, 0, 0, 1},
+                                        GShader::kMirror);
+    GRecordingCanvas shaded;
+    for (int i = 0; i < 60; ++i) {
+        shaded.save();
+        shaded.translate(rand.nextF() * W, rand.nextF() * H);
+        shaded.rotate(rand.nextF() * 3);
+        shaded.drawRect(GRect::MakeXYWH(-10, -10, 20 + rand.nextF() * 40, 20),
+                        GPaint(shader.get()));
+        shaded.restore();
+    }
+    picture = shaded.finishRecording();
+    clear(serial);
+    clear(tiled);
+    picture->playback(GCreateCanvas(serial).get());
+    GPictureIndex shadedIndex(*picture, {W, H}, 8);
+    GPlaybackTiled(shadedIndex, tiled, 16, 4);
+    stats->expectTrue(bitmaps_eq(serial, tiled), "tiled_shader");
+
+    free(serial.pixels());
+    free(tiled.pixels());
+}
+
+static void test_picture_area(GTestStats* stats) {
+    const int W = 120, H = 90;
+    GRecordingCanvas recorder;
+    GRandom rand;
+    for (int i = 0; i < 2000; ++i) {
+        if (i % 500 == 100) {
+            recorder.saveLayer(GPaint({1, 0, 0, 0}).setBlendMode(GBlendMode::kDstIn));
+        } else if (i % 500 == 120) {
+            recorder.restore();
+        }
+        recorder.save();
+        recorder.translate(rand.nextF() * W, rand.nextF() * H);
+        recorder.save();
+        recorder.scale(0.5f + rand.nextF(), 0.5f + rand.nextF());
+        GColor color = {0.5f + rand.nextF() * 0.5f, rand.nextF(), rand.nextF(), rand.nextF()};
+        recorder.fillRect(GRect::MakeWH(6, 4), color);
+        recorder.restore();
+        if (i % 5 == 0) {
+            const GPoint tri[] = { {0, 0}, {8, 2}, {3, 9} };
+            recorder.drawConvexPolygon(tri, 3, GPaint(color));
+        }
+        recorder.restore();
+    }
+    auto picture = recorder.finishRecording();
+    GPictureIndex index(*picture, {W, H});
+
+    GBitmap full, partial;
+    setup_bitmap(&full, W, H);
+    setup_bitmap(&partial, W, H);
+    GCreateCanvas(full)->clear({1, 1, 1, 1});
+    picture->playback(GCreateCanvas(full).get());
+
+    // Start from different content, then repaint only the dirty area.
+    GCreateCanvas(partial)->clear({1, 0, 0, 1});
+    const GIRect dirty = GIRect::MakeLTRB(30, 40, 45, 52);
+    GPlaybackArea(index, partial, dirty, {1, 1, 1, 1});
+
+    bool inside = true, outside = true;
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            if (dirty.contains(x, y)) {
+                inside &= *partial.getAddr(x, y) == *full.getAddr(x, y);
+            } else {
+                outside &= *partial.getAddr(x, y) == GPixel_PackARGB(0xFF, 0, 0, 0xFF);
+            }
+        }
+    }
+    stats->expectTrue(inside, "area_pixels");
+    stats->expectTrue(outside, "area_clip");
+
+    // Only a small fraction of the picture (including its state ops) is needed.
+    std::vector<int> draws, ops;
+    index.query(dirty, &draws);
+    index.resolve(draws, &ops);
+    stats->expectTrue(ops.size() * 10 < (size_t)picture->countOps(), "area_minimal");
+
+    free(full.pixels());
+    free(partial.pixels());
+}
+
+/*
+ *  Random clipped draws: rect clips (some rotated), path clips, clips inside layers.
+ */
+static void draw_clipped_scene(GCanvas* canvas, int W, int H) {
+    GRandom rand;
+    canvas->drawPaint(GPaint({1, 0.9f, 0.9f, 0.9f}));
+    for (int i = 0; i < 120; ++i) {
+        if (i % 30 == 10) {
+            canvas->saveLayer(GPaint({0.5f, 0, 0, 0}));
+            canvas->clipRect(GRect::MakeXYWH(rand.nextF() * W / 2, 0, W / 2, H));
+        } else if (i % 30 == 25) {
+            canvas->restore();
+        }
+        canvas->save();
+        canvas->translate(rand.nextF() * W, rand.nextF() * H);
+        if (i % 4 == 1) {
+            canvas->rotate(rand.nextF() * 3);
+        }
+        if (i % 4 < 2) {
+            canvas->clipRect(GRect::MakeXYWH(-4, -4, 8 + rand.nextF() * 20, 8 + rand.nextF() * 20));
+        } else if (i % 4 == 2) {
+            GPath path;
+            path.moveTo(0, -12).lineTo(14, 10).lineTo(-14, 10).moveTo(0, 14).lineTo(10, -6)
+                .lineTo(-10, -6);
+            canvas->clipPath(path);
+        }
+        const GColor color = {0.5f + rand.nextF() * 0.5f, rand.nextF(), rand.nextF(),
+                              rand.nextF()};
+        canvas->scale(0.5f + rand.nextF(), 0.5f + rand.nextF());
+        canvas->drawRect(GRect::MakeLTRB(-20, -15, 20, 15), GPaint(color));
+        canvas->restore();
+    }
+}
+
+static void test_picture_clip(GTestStats* stats) {
+    const int W = 90, H = 70;
+    GRecordingCanvas recorder;
+    draw_clipped_scene(&recorder, W, H);
+    auto picture = recorder.finishRecording();
+
+    GBitmap expected, actual;
+    setup_bitmap(&expected, W, H);
+    setup_bitmap(&actual, W, H);
+    draw_clipped_scene(GCreateCanvas(expected).get(), W, H);
+
+    picture->playback(GCreateCanvas(actual).get());
+    stats->expectTrue(bitmaps_eq(expected, actual), "clip_playback");
+
+    clear(actual);
+    GPictureOptimizeStats optStats;
+    GOptimizePicture(*picture, {W, H}, &optStats)->playback(GCreateCanvas(actual).get());
+    stats->expectTrue(bitmaps_eq(expected, actual), "clip_optimized");
+
+    // Draws outside the clip are dropped, and then the clip and its save/restore.
+    recorder.save();
+    recorder.clipRect(GRect::MakeLTRB(0, 0, 10, 10));
+    recorder.fillRect(GRect::MakeLTRB(20, 20, 30, 30), {1, 0, 0, 0});
+    recorder.restore();
+    stats->expectEQ(GOptimizePicture(*recorder.finishRecording(), {W, H})->countOps(), 0,
+                    "clip_rejected");
+
+    clear(actual);
+    GPictureIndex index(*picture, {W, H}, 8);
+    GPlaybackTiled(index, actual, 16, 4);
+    stats->expectTrue(bitmaps_eq(expected, actual), "clip_tiled");
+
+    clear(actual);
+    std::vector<uint8_t> data;
+    GScene::Encode(*picture, &data);
+    auto scene = GScene::MakeFromData(data.data(), data.size());
+    if (scene) {
+        scene->playback(GCreateCanvas(actual).get());
+    }
+    stats->expectTrue(scene && bitmaps_eq(expected, actual), "clip_scene");
+
+    free(expected.pixels());
+    free(actual.pixels());
+}
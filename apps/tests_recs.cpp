@@ -298,6 +298,8 @@ static void test_matrix_map(GTestStats* stats) {
 #include "tests_pa4.cpp"
 #include "tests_pa5.cpp"
 #include "tests_pa6.cpp"
+#include "tests_picture.cpp"
+#include "tests_canvas.cpp"
 
 const GTestRec gTestRecs[] = {
     { test_clear,       "clear"         },
@@ -321,6 +323,30 @@ const GTestRec gTestRecs[] = {
     { test_edger_quads, "test_edger_quads"  },
     { test_path_circle, "test_path_circle"  },
 
+    { test_picture_playback, "picture_playback" },
+    { test_picture_optimize, "picture_optimize" },
+    { test_picture_player,   "picture_player"   },
+    { test_scene_roundtrip,  "scene_roundtrip"  },
+    { test_scene_parser,     "scene_parser"     },
+    { test_picture_tiled,    "picture_tiled"    },
+    { test_picture_area,     "picture_area"     },
+    { test_picture_clip,     "picture_clip"     },
+
+    { test_clip_rect,        "clip_rect"        },
+    { test_clip_path,        "clip_path"        },
+    { test_quick_reject,     "quick_reject"     },
+    { test_batched_draws,    "batched_draws"    },
+    { test_mesh,             "mesh"             },
+    { test_convex_path,      "convex_path"      },
+    { test_rect_fast_path,   "rect_fast_path"   },
+    { test_round_rect,       "round_rect"       },
+    { test_lines,            "lines"            },
+    { test_stroker,          "stroker"          },
+    { test_stats,            "stats"            },
+    { test_trace,            "trace"            },
+    { test_overdraw,         "overdraw"         },
+    { test_differential,     "differential"     },
+
     { nullptr, nullptr },
 };
 
@@ -6,6 +6,8 @@
 #include "GBitmap.h"
 #include "GCanvas.h"
 #include "GColor.h"
+#include "GPicture.h"
+#include "GPicturePlayer.h"
 #include "GRandom.h"
 #include "GRect.h"
 #include "image.h"
@@ -48,10 +50,15 @@ class ViewerWindow : public GWindow {
     GRect fSlider;
     int fRecIndex = 0;
     int fRecCount;
-    int fOpCount = -1;
+    int fDrawCount = -1;
     float fOpPercent = 1;
     bool fZoomer = false;
 
+    // Scenes are recorded once, then draw-limited prefixes are replayed from the nearest snapshot.
+    std::unique_ptr<GPicture>       fPicture;
+    std::unique_ptr<GPicturePlayer> fPlayer;
+    std::vector<int>                fDrawOps;   // index of each draw op in fPicture
+
 public:
     ViewerWindow(int w, int h) : GWindow(w, h) {
         this->onResize(w, h);
@@ -67,21 +74,28 @@ public:
 protected:
     void onResize(int w, int h) override {
         fSlider.setLTRB(w - SLIDER_W, SLIDER_MARGIN, w, h - SLIDER_MARGIN);
+        fPlayer.reset();    // the window's bitmap is reallocated
     }
 
-    void onDraw(GCanvas* canvas) override {
-        canvas->fillRect(GRect::MakeXYWH(0, 0, 10000, 10000), {1,1,1,1});
-
-        if (fOpCount < 0) {
-            CounterCanvas counter;
-            gDrawRecs[fRecIndex].fDraw(&counter);
-            fOpCount = counter.getCount();
+    void onUpdate(const GBitmap& bitmap, GCanvas* canvas) override {
+        if (fDrawCount < 0) {
+            this->prepareRec();
         }
 
-        canvas->save();
-        LimitCanvas limit(canvas, GRoundToInt(fOpPercent * fOpCount));
-        gDrawRecs[fRecIndex].fDraw(&limit);
-        canvas->restore();
+        if (fPicture) {
+            if (!fPlayer) {
+                canvas->fillRect(GRect::MakeXYWH(0, 0, 10000, 10000), {1,1,1,1});
+                fPlayer.reset(new GPicturePlayer(fPicture.get()));
+                fPlayer->reset(bitmap);
+            }
+            fPlayer->draw(bitmap, this->opsForDraws(GRoundToInt(fOpPercent * fDrawCount)));
+        } else {
+            canvas->fillRect(GRect::MakeXYWH(0, 0, 10000, 10000), {1,1,1,1});
+            canvas->save();
+            LimitCanvas limit(canvas, GRoundToInt(fOpPercent * fDrawCount));
+            gDrawRecs[fRecIndex].fDraw(&limit);
+            canvas->restore();
+        }
 
         GRect r = fSlider;
         r.fBottom = r.fTop + fOpPercent * fSlider.height();
@@ -113,7 +127,7 @@ protected:
                 if (fRecIndex < 0) {
                     fRecIndex = fRecCount - 1;
                 }
-                fOpCount = -1;  // signal need to recompute
+                fDrawCount = -1;  // signal need to recompute
                 fOpPercent = 1;
                 this->updateTitle();
                 this->requestDraw();
@@ -123,7 +137,7 @@ protected:
                 if (fRecIndex >= fRecCount) {
                     fRecIndex = 0;
                 }
-                fOpCount = -1;  // signal need to recompute
+                fDrawCount = -1;  // signal need to recompute
                 fOpPercent = 1;
                 this->updateTitle();
                 this->requestDraw();
@@ -148,6 +162,39 @@ protected:
     }
 
 private:
+    void prepareRec() {
+        GRecordingCanvas recorder;
+        gDrawRecs[fRecIndex].fDraw(&recorder);
+        fPicture = recorder.finishRecording();
+        fPlayer.reset();
+
+        if (fPicture->hasExternalRefs()) {
+            // The shaders/filters it refers to were freed when the draw function returned, so
+            // this scene has to keep being drawn directly.
+            fPicture.reset();
+            CounterCanvas counter;
+            gDrawRecs[fRecIndex].fDraw(&counter);
+            fDrawCount = counter.getCount();
+        } else {
+            fDrawOps.clear();
+            for (int i = 0; i < fPicture->countOps(); ++i) {
+                if (fPicture->op(i).isDraw()) {
+                    fDrawOps.push_back(i);
+                }
+            }
+            fDrawCount = (int)fDrawOps.size();
+        }
+    }
+
+    // How many ops of fPicture to play so that only its first [draws] draws land, as LimitCanvas
+    // would allow: every op before the next draw, so the state ops in between still apply.
+    int opsForDraws(int draws) const {
+        if (draws >= (int)fDrawOps.size()) {
+            return fPicture->countOps();
+        }
+        return fDrawOps[draws];
+    }
+
     void updateTitle() {
         char buffer[1000];
         sprintf(buffer, "%2d: %s", fRecIndex, gDrawRecs[fRecIndex].fName);
@@ -0,0 +1,179 @@
+#include "GBitmap.h"
+#include "GColor.h"
+#include "GFilter.h"
+#include "GMatrix.h"
+#include "GPaint.h"
+#include "GShader.h"
+#include "blend.h"
+#include "deviceClip.h"
+#include "stats.h"
+#include "GTrace.h"
+#include "Utils.h"
+
+#ifndef BLITTER_H
+#define BLITTER_H
+/*
+ * Everything needed to fill spans of one layer with one paint, resolved once per draw (or
+ * once per batch of draws) instead of once per row.
+ */
+struct Blitter {
+    GBitmap bitmap;             // the layer being drawn into
+    int originX, originY;       // device position of the layer's top-left pixel
+    const DeviceClip* clip;
+    Blend blend;
+    GShader* shader;
+    GFilter* filter;
+    GPixel src;                 // filtered paint color, when there is no shader
+    bool overwrite;             // blending src just stores it (Src, or opaque SrcOver)
+    bool skip;                  // nothing can be drawn (e.g. the shader can't be used)
+    bool fastFill;              // overwrite is allowed (off for the reference backend)
+    G_STATS_CODE(GStats* stats = nullptr;)  // counts the spans and pixels, if not null
+
+    Blitter(const GBitmap& layer, GPoint origin, const DeviceClip& clip, const GPaint& paint,
+            const GMatrix& ctm, bool fastFill = true);
+
+    /*
+     * Switch to a new color, keeping the rest of the paint (for batches with per-item colors).
+     */
+    void setColor(const GColor& color);
+
+    /*
+     * Fill pixels [leftX, rightX) of row y of the layer, as far as the layer and clip allow.
+     * If pixels is not null, it holds the source for each pixel of the span (e.g. a mesh's
+     * interpolated colors) in place of the paint's color or shader. The filter still applies.
+     */
+    void blitRow(int leftX, int rightX, int y, GPixel pixels[] = nullptr);
+
+    /*
+     * Blend into pixel (x, y) of the layer as blitRow would, then keep only coverage/255 of the
+     * change (for anti-aliased edges). Pixels outside the layer or the clip are left alone.
+     */
+    void blitPixel(int x, int y, int coverage);
+};
+
+/*
+ * Move each component coverage/255 of the way from dst to result.
+ */
+static inline GPixel lerpPixel(GPixel dst, GPixel result, int coverage) {
+    const int keep = 255 - coverage;
+    return GPixel_PackARGB(
+        (GPixel_GetA(dst) * keep + GPixel_GetA(result) * coverage + 127) / 255,
+        (GPixel_GetR(dst) * keep + GPixel_GetR(result) * coverage + 127) / 255,
+        (GPixel_GetG(dst) * keep + GPixel_GetG(result) * coverage + 127) / 255,
+        (GPixel_GetB(dst) * keep + GPixel_GetB(result) * coverage + 127) / 255);
+}
+
+Blitter::Blitter(const GBitmap& layer, GPoint origin, const DeviceClip& clip, const GPaint& paint,
+                 const GMatrix& ctm, bool fastFill)
+    : bitmap(layer), originX(GRoundToInt(origin.x())), originY(GRoundToInt(origin.y())),
+      clip(&clip), blend(getBlend(paint.getBlendMode())), shader(paint.getShader()),
+      filter(paint.getFilter()), skip(clip.isEmpty()), fastFill(fastFill) {
+    if (shader) {
+        G_TRACE_EVENT("shader", "setContext");
+        if (!shader->setContext(ctm)) {
+            skip = true;
+        }
+    }
+    this->setColor(paint.getColor());
+}
+
+void Blitter::setColor(const GColor& color) {
+    src = colortoPixel(color);
+    if (filter && !shader) {
+        filter->filter(&src, &src, 1);
+    }
+    overwrite = fastFill && !shader &&
+                (blend == ::src || (blend == srcOver && GPixel_GetA(src) == 0xFF));
+}
+
+void Blitter::blitRow(int leftX, int rightX, int y, GPixel pixels[]) {
+    if(leftX == rightX || skip){return;}
+    const int firstX = leftX;
+    leftX = std::max(0, leftX);
+    rightX = std::min(bitmap.width(), rightX);
+    y = std::min(bitmap.height() - 1, y);
+    int count = rightX - leftX;
+
+    //Only touch the part of the row inside the device clip
+    int deviceY = y + originY;
+    if (deviceY < clip->fBounds.top() || deviceY >= clip->fBounds.bottom()) {
+        return;
+    }
+    int clipL = std::max(leftX, clip->fBounds.left() - originX);
+    int clipR = std::min(rightX, clip->fBounds.right() - originX);
+    if (clipL >= clipR) {
+        return;
+    }
+    //Complex clips also skip the pixels their mask leaves out
+    const uint8_t* coverage = clip->row(deviceY);
+    int maskX = originX - clip->fMaskBounds.left();
+    GPixel* row = bitmap.getAddr(0, y);
+    G_STATS_ADD(stats, fSpans, 1);
+    G_STATS_ADD(stats, fPixelsBlended, clipR - clipL);
+
+    if(shader || pixels){
+        //Shade the whole row, since shaders may step across it, then keep the clipped part
+        GPixel shaded[pixels ? 1 : count];
+        GPixel* thisRow = shaded;
+        {
+            G_STATS_TIME(stats, fShadeNS);
+            if(pixels){
+                thisRow = pixels + (leftX - firstX);
+            }else{
+                shader->shadeRow(leftX, y, count, thisRow);
+                G_STATS_ADD(stats, fPixelsShaded, count);
+            }
+
+            if(filter){
+              filter->filter(thisRow, thisRow, count);
+            }
+        }
+
+        //Blend and fill row memory with shaded pixels
+        G_STATS_TIME(stats, fBlendNS);
+        for (int x = clipL; x < clipR; ++x) {
+            if (coverage && !coverage[x + maskX]) {
+                continue;
+            }
+            row[x] = blend(thisRow[x - leftX], row[x]);
+        }
+    }else if(overwrite && !coverage){
+        G_STATS_TIME(stats, fBlendNS);
+        std::fill(row + clipL, row + clipR, src);
+    }else{
+        G_STATS_TIME(stats, fBlendNS);
+        for (int x = clipL; x < clipR; ++x) {
+            if (coverage && !coverage[x + maskX]) {
+                continue;
+            }
+            row[x] = blend(src, row[x]);
+        }
+    }
+}
+
+void Blitter::blitPixel(int x, int y, int coverage) {
+    if (skip || x < 0 || y < 0 || x >= bitmap.width() || y >= bitmap.height()) {
+        return;
+    }
+    const int deviceX = x + originX, deviceY = y + originY;
+    if (!clip->fBounds.contains(deviceX, deviceY)) {
+        return;
+    }
+    const uint8_t* mask = clip->row(deviceY);
+    if (mask && !mask[deviceX - clip->fMaskBounds.left()]) {
+        return;
+    }
+    G_STATS_ADD(stats, fPixelsBlended, 1);
+    GPixel source = src;
+    if (shader) {
+        G_STATS_ADD(stats, fPixelsShaded, 1);
+        shader->shadeRow(x, y, 1, &source);
+        if (filter) {
+            filter->filter(&source, &source, 1);
+        }
+    }
+    GPixel* dst = bitmap.getAddr(x, y);
+    *dst = lerpPixel(*dst, blend(source, *dst), coverage);
+}
+
+#endif
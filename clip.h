@@ -19,18 +19,19 @@ struct Edge {
     bool operator==(const Edge& other) const;
 };
 
-Edge::Edge(GPoint p0, GPoint p1, int winding) {
+inline Edge::Edge(GPoint p0, GPoint p1, int winding) {
   //Switch p0 and p1 if in wrong order
   if (p0.fY > p1.fY) {
       std::swap(p0, p1);
       winding = winding * -1;
   }
 
-  //Set values and return
-  this->curX = p0.fX;
+  //Set values and return. curX is sampled at the center of the first row, so each row's x
+  //stays between the end points' x
   this->botY = GRoundToInt(p1.fY);
   this->topY = GRoundToInt(p0.fY);
   this->slope = (p1.fX - p0.fX) / (p1.fY - p0.fY);
+  this->curX = p0.fX + this->slope * (this->topY + 0.5f - p0.fY);
   this->winding = winding;
 }
 
@@ -115,10 +116,10 @@ static void clip(GPoint p0, GPoint p1, const GRect& sides,  std::deque<Edge>& ed
  * Compares edges for sorting
  * Sorted by bot y, bot x, and then slope
  */
-bool compareEdge(const Edge e1, const Edge e2) {
+static bool compareEdge(const Edge e1, const Edge e2) {
     if (e1.topY == e2.topY) {
       if (e1.curX == e2.curX) {
-        return e1.slope <= e2.slope;
+        return e1.slope < e2.slope;
       }else{
         return e1.curX < e2.curX;
       }
@@ -127,11 +128,11 @@ bool compareEdge(const Edge e1, const Edge e2) {
     }
 }
 
-bool resortCompare(const Edge e1, const Edge e2) {
+static bool resortCompare(const Edge e1, const Edge e2) {
     return e1.curX < e2.curX;
 }
 
-bool Edge::operator==(const Edge& other) const{
+inline bool Edge::operator==(const Edge& other) const{
     if(this->topY == other.topY &&
        this->botY == other.botY &&
        this->slope == other.slope &&
@@ -0,0 +1,99 @@
+#include "GRect.h"
+#include <memory>
+#include <vector>
+
+#ifndef DEVICECLIP_H
+#define DEVICECLIP_H
+/*
+ * The device pixels that draws may touch. A rect clip is just its bounds; anything else also
+ * keeps a coverage mask (one byte per pixel of fMaskBounds, nonzero = inside). The mask is
+ * shared between saved copies and never modified, so save() only copies a pointer.
+ */
+struct DeviceClip {
+    GIRect fBounds;                 // every pixel in the clip is inside this
+    GIRect fMaskBounds;             // contains fBounds
+    std::shared_ptr<const std::vector<uint8_t>> fMask;
+
+    DeviceClip(const GIRect& bounds);
+
+    bool isEmpty() const { return fBounds.isEmpty(); }
+    bool isRect() const { return !fMask; }
+
+    /*
+     * Coverage for device row y (inside fBounds), indexed by device x - fMaskBounds.left(),
+     * or null if every pixel of the row inside fBounds is in the clip.
+     */
+    const uint8_t* row(int y) const {
+        if (!fMask) {
+            return nullptr;
+        }
+        return fMask->data() + (y - fMaskBounds.top()) * fMaskBounds.width();
+    }
+
+    void setEmpty();
+    void intersectRect(const GIRect& r);
+    void intersectMask(const GIRect& bounds, std::vector<uint8_t>* mask);
+};
+
+DeviceClip::DeviceClip(const GIRect& bounds)
+    : fBounds(bounds), fMaskBounds(bounds) {
+    if (fBounds.isEmpty()) {
+        this->setEmpty();
+    }
+}
+
+void DeviceClip::setEmpty() {
+    fBounds = fMaskBounds = GIRect::MakeWH(0, 0);
+    fMask.reset();
+}
+
+/*
+ * Narrowing the bounds is enough: the mask (if any) is still valid over the smaller area.
+ */
+void DeviceClip::intersectRect(const GIRect& r) {
+    if (!fBounds.intersect(r)) {
+        this->setEmpty();
+    }
+}
+
+/*
+ * Intersect with a coverage mask over bounds (which must be inside fBounds). mask is consumed.
+ */
+void DeviceClip::intersectMask(const GIRect& bounds, std::vector<uint8_t>* mask) {
+    const int w = bounds.width();
+    int l = bounds.right(), t = bounds.bottom(), r = bounds.left(), b = bounds.top();
+    int64_t covered = 0;
+    for (int y = bounds.top(); y < bounds.bottom(); ++y) {
+        uint8_t* dst = mask->data() + (y - bounds.top()) * w;
+        const uint8_t* src = this->row(y);
+        for (int x = 0; x < w; ++x) {
+            if (src && !src[x + bounds.left() - fMaskBounds.left()]) {
+                dst[x] = 0;
+            }
+            if (dst[x]) {
+                covered += 1;
+                l = std::min(l, x + bounds.left());
+                r = std::max(r, x + bounds.left() + 1);
+                t = std::min(t, y);
+                b = std::max(b, y + 1);
+            }
+        }
+    }
+    if (covered == 0) {
+        this->setEmpty();
+        return;
+    }
+    fBounds = GIRect::MakeLTRB(l, t, r, b);
+    if (covered == (int64_t)fBounds.width() * fBounds.height()) {
+        // e.g. a path that is just an axis-aligned rect: no mask needed
+        fMaskBounds = fBounds;
+        fMask.reset();
+        return;
+    }
+    auto shared = std::make_shared<std::vector<uint8_t>>();
+    shared->swap(*mask);
+    fMask = shared;
+    fMaskBounds = bounds;
+}
+
+#endif
@@ -8,17 +8,25 @@
 #include "GPaint.h"
 #include "GShader.h"
 #include "GFilter.h"
+#include "GStroker.h"
 #include <stack>
 #include <tuple>
 #include <deque>
 #include "matrix.h"
 #include "clip.h"
 #include "layer.h"
+#include "deviceClip.h"
+#include "blitter.h"
 #include "path.h"
+#include "mesh.h"
+#include "rrect.h"
+#include "line.h"
 #include "blend.h"
 #include "Utils.h"
 #include "math.h"
 #include "pathEdger.h"
+#include "stats.h"
+#include "GTrace.h"
 #include "RadialGradientShader.h"
 #include "TriangleGradientShader.h"
 
@@ -26,17 +34,18 @@ using namespace std;
 
 class EmptyCanvas : public GCanvas {
   public:
-    EmptyCanvas(const GBitmap& device) : fDevice(device), fCTMStack(), fLayerStack() {
+    EmptyCanvas(const GBitmap& device, const GIRect& clip, GBackend backend = GBackend::kOptimized)
+        : fDevice(device), fReference(backend == GBackend::kReference), fCTMStack(),
+          fLayerStack() {
       GPoint trans = GPoint::Make(0, 0);
-      GPaint* paint = new GPaint();
-      Layer* layer = new Layer(device, trans, *paint);
-      fLayerStack.push(*layer);
+      fLayerStack.push(Layer(device, trans, GPaint()));
       fLayerBool.push(true);
 
       GMatrix I;
       I.setIdentity();
       fCTMStack.push(I);
       fLayerBool.push(false);
+      fClipStack.push(DeviceClip(clip));
     }
 
 ////////////////// Final Methods /////////////////////////////
@@ -48,6 +57,11 @@ std::unique_ptr<GShader> final_createRadialGradient(
       return std::unique_ptr<GShader>(r);
 }
 
+void final_addStrokedLine(GPath* path, GPoint p0, GPoint p1, float width,
+                          bool roundCap) override {
+      GStroker::StrokeLine(p0, p1, width, roundCap, path);
+}
+
 virtual std::unique_ptr<GShader> final_createTriangleGradient(const GPoint pts[3],
                                                                       const GColor colors[3]) override {
       TriangleGradientShader* t = new TriangleGradientShader(pts, colors);
@@ -59,8 +73,16 @@ virtual std::unique_ptr<GShader> final_createTriangleGradient(const GPoint pts[3
      * Fill canvas with a single color
      */
     void drawPaint(const GPaint& paint) override {
-      for(int y = 0; y < fLayerStack.top().bitmap.height(); ++y){
-          drawRow(0, fLayerStack.top().bitmap.width(), y, paint);
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawPaint");
+      Blitter blitter = makeBlitter(paint);
+      //Only visit the rows inside the clip
+      const GIRect& clip = fClipStack.top().fBounds;
+      int top = std::max(0, clip.top() - blitter.originY);
+      int bottom = std::min(blitter.bitmap.height(), clip.bottom() - blitter.originY);
+      G_TRACE_EVENT("blit", "spans");
+      for(int y = top; y < bottom; ++y){
+          blitter.blitRow(0, blitter.bitmap.width(), y);
       }
     }
 
@@ -68,144 +90,368 @@ virtual std::unique_ptr<GShader> final_createTriangleGradient(const GPoint pts[3
      * Fill a rectangle with given locations. Blend with canvas color.
      */
     void drawRect(const GRect& rect, const GPaint& paint) override {
-        GPoint points[4] = {
-               GPoint::Make(rect.left(), rect.top()),
-               GPoint::Make(rect.right(), rect.top()),
-               GPoint::Make(rect.right(), rect.bottom()),
-               GPoint::Make(rect.left(), rect.bottom())
-        };
-        drawConvexPolygon(points, 4, paint);
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawRect");
+        Blitter blitter = makeBlitter(paint);
+        if (!blitter.skip) {
+            fillRect(rect, blitter);
+        }
     }
 
     /*
      * Clip and draw arbitrary convex polygon
      */
     virtual void drawConvexPolygon(const GPoint points[], int count, const GPaint& paint) override {
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawConvexPolygon");
         //Map point locations from CTM. Must use auxillary array due to method signature.
         GPoint CTMpoints[count];
         fCTMStack.top().mapPoints(CTMpoints, points, count);
+        Blitter blitter = makeBlitter(paint);
+        fillConvex(CTMpoints, count, blitter);
+    }
 
+    /*
+     * When the CTM keeps the rect axis-aligned, rows are scanned straight from the corner
+     * ellipses (see rrect.h). Other CTMs fill the path GCanvas builds.
+     */
+    virtual void drawRoundRect(const GRect& rect, float rx, float ry,
+                               const GPaint& paint) override {
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawRoundRect");
+        const GMatrix& ctm = fCTMStack.top();
+        const bool scaled = ctm[GMatrix::KX] == 0 && ctm[GMatrix::KY] == 0;
+        const bool swapped = ctm[GMatrix::SX] == 0 && ctm[GMatrix::SY] == 0;
+        if (!scaled && !swapped) {
+            GCanvas::drawRoundRect(rect, rx, ry, paint);
+            return;
+        }
+        Blitter blitter = makeBlitter(paint);
+        const GIRect area = drawArea(blitter);
+        if (blitter.skip || area.isEmpty()) {
+            return;
+        }
 
-        GBitmap layer = fLayerStack.top().bitmap;
-
-        //Correct for translation of current layer. (I should do this in CTM but not right now)
+        GRect local = pinRoundRect(rect, &rx, &ry);
+        GPoint corners[2] = { { local.left(), local.top() }, { local.right(), local.bottom() } };
+        ctm.mapPoints(corners, corners, 2);
         GPoint translation = fLayerStack.top().translation;
-        for(int i = 0; i < count; ++i){
-            CTMpoints[i].fX += -translation.x();
-            CTMpoints[i].fY += -translation.y();
+        GRect device = GRect::MakeLTRB(corners[0].x() - translation.x(),
+                                       corners[0].y() - translation.y(),
+                                       corners[1].x() - translation.x(),
+                                       corners[1].y() - translation.y());
+        float deviceRX = rx * fabsf(ctm[GMatrix::SX]), deviceRY = ry * fabsf(ctm[GMatrix::SY]);
+        if (swapped) {
+            deviceRX = ry * fabsf(ctm[GMatrix::KX]);
+            deviceRY = rx * fabsf(ctm[GMatrix::KY]);
         }
-        //Start by building edge deque and ordering them correctly
-        GRect sides = GRect::MakeWH(layer.width(), layer.height());
-
-        //Clip edges and place in deque - for autosizing, front&back access
-        std::deque<Edge> edges;
-        for (int i = 0; i < count; ++i) {
-          GPoint p0 = CTMpoints[i];
-          GPoint p1 = CTMpoints[(i + 1) % count];
-          clip(p0, p1, sides, edges);
+        device = pinRoundRect(device, &deviceRX, &deviceRY);
+
+        auto span = [&](int l, int r, int y) { blitter.blitRow(l, r, y); };
+        G_TRACE_EVENT("blit", "spans");
+        if (paint.isAntiAlias()) {
+            scanRoundRectAA(device, deviceRX, deviceRY, area, span,
+                            [&](int x, int y, int coverage) { blitter.blitPixel(x, y, coverage); });
+        } else {
+            scanRoundRect(device, deviceRX, deviceRY, area, span);
         }
+    }
 
-        // We only draw between edges: 0 or 1 has no result
-        if(edges.size() < 2){
-          return;
-        }
+    void drawLine(GPoint p0, GPoint p1, float width, const GPaint& paint) override {
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawLine");
+        const GPoint pts[2] = { p0, p1 };
+        drawPolyline(pts, 2, width, paint);
+    }
 
-        //Sort using predicate function defined in clip.cpp
-        std::sort(edges.begin(), edges.end(), compareEdge);
+    /*
+     * Hairlines, and lines less than 2 pixels wide after the CTM, are scanned straight from
+     * their points (see line.h) with one blitter for the whole polyline. Wider lines fill their
+     * quads as GCanvas does.
+     */
+    void drawPolyline(const GPoint pts[], int count, float width, const GPaint& paint) override {
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawPolyline");
+        const GMatrix& ctm = fCTMStack.top();
+        const float scale = sqrtf(fabsf(ctm[GMatrix::SX] * ctm[GMatrix::SY] -
+                                        ctm[GMatrix::KX] * ctm[GMatrix::KY]));
+        if (!(width * scale < 2)) {
+            for (int i = 0; i + 1 < count; ++i) {
+                GCanvas::drawLine(pts[i], pts[i + 1], width, paint);
+            }
+            return;
+        }
+        Blitter blitter = makeBlitter(paint);
+        const GIRect area = drawArea(blitter);
+        if (blitter.skip || area.isEmpty() || count < 2) {
+            return;
+        }
+        GPoint translation = fLayerStack.top().translation;
+        auto toLayer = [&](GPoint p) {
+            p = ctm.mapPt(p);
+            return GPoint::Make(p.x() - translation.x(), p.y() - translation.y());
+        };
+        auto run = [&](int l, int r, int y) { blitter.blitRow(l, r, y); };
+
+        G_TRACE_EVENT("blit", "spans");
+        for (int i = 0; i + 1 < count; ++i) {
+            if (width == 0) {
+                const GPoint p0 = toLayer(pts[i]), p1 = toLayer(pts[i + 1]);
+                if (paint.isAntiAlias()) {
+                    scanHairlineAA(p0, p1, area, [&](int x, int y, int coverage) {
+                        blitter.blitPixel(x, y, coverage);
+                    });
+                } else {
+                    scanHairline(p0, p1, area, run);
+                }
+                continue;
+            }
+            GVector norm = { pts[i + 1].y() - pts[i].y(), pts[i].x() - pts[i + 1].x() };
+            const float length = norm.length();
+            if (!(length > 0)) {
+                continue;
+            }
+            norm = norm * (width / 2 / length);
+            const GPoint q0 = toLayer(pts[i] + norm), q1 = toLayer(pts[i + 1] + norm);
+            const GPoint q3 = toLayer(pts[i] - norm);
+            scanParallelogram(q0, q1 - q0, q3 - q0, area, run);
+        }
+    }
 
-        // Set up boundary conditions
-        Edge left = edges.front();
-        edges.pop_front();
-        Edge right = edges.front();
-        edges.pop_front();
+////////////////// BATCHED DRAW METHODS ///////////////////////////
 
-        int y = GRoundToInt(left.topY);
-        float leftX = left.curX;
-        float rightX = right.curX;
-        int bottom =  GRoundToInt(edges.back().botY);
-        // Draw 1-Pixel high rectangles for each row
-        for(y; y < bottom; ++y) {
-            int l = GRoundToInt(std::min(leftX, rightX));
-            int r = GRoundToInt(std::max(leftX, rightX));
-            drawRow(l, r, y, paint);
+    /*
+     * Every item shares one blitter, so the paint is only resolved once.
+     */
+    virtual void drawRects(const GRect rects[], int count, const GPaint& paint,
+                           const GColor colors[]) override {
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawRects");
+        if (fReference) {
+            GCanvas::drawRects(rects, count, paint, colors);
+            return;
+        }
+        Blitter blitter = makeBlitter(paint);
+        for (int i = 0; i < count && !blitter.skip; ++i) {
+            if (colors) {
+                blitter.setColor(colors[i]);
+            }
+            fillRect(rects[i], blitter);
+        }
+    }
 
-            //Check to see if completed left or right edge
-            //If so, replace with next edge
-            if (y >= left.botY) {
-                left = edges.front();
-                edges.pop_front();
-                leftX = left.curX;
-            } else {
-                leftX += left.slope;
+    virtual void drawConvexPolygons(const GPoint points[], const int counts[], int polyCount,
+                                    const GPaint& paint, const GColor colors[]) override {
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawConvexPolygons");
+        if (fReference) {
+            GCanvas::drawConvexPolygons(points, counts, polyCount, paint, colors);
+            return;
+        }
+        Blitter blitter = makeBlitter(paint);
+        for (int i = 0; i < polyCount && !blitter.skip; ++i) {
+            if (colors) {
+                blitter.setColor(colors[i]);
             }
+            int count = std::max(counts[i], 0);
+            fPointScratch.resize(count);
+            fCTMStack.top().mapPoints(fPointScratch.data(), points, count);
+            fillConvex(fPointScratch.data(), count, blitter);
+            points += count;
+        }
+    }
 
-            if (y >= right.botY) {
-                right = edges.front();
-                edges.pop_front();
-                rightX = right.curX;
-            } else {
-                rightX += right.slope;
+    virtual void drawPoints(const GPoint points[], int count, float size, const GPaint& paint,
+                            const GColor colors[]) override {
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawPoints");
+        if (fReference) {
+            GCanvas::drawPoints(points, count, size, paint, colors);
+            return;
+        }
+        Blitter blitter = makeBlitter(paint);
+        float half = size * 0.5f;
+        for (int i = 0; i < count && !blitter.skip; ++i) {
+            if (colors) {
+                blitter.setColor(colors[i]);
             }
+            fillRect(GRect::MakeLTRB(points[i].x() - half, points[i].y() - half,
+                                     points[i].x() + half, points[i].y() + half), blitter);
         }
     }
 
     virtual void drawPath(const GPath& path, const GPaint& paint) override {
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawPath");
+        if (quickReject(path.bounds())) {
+            return;
+        }
+        //Convexity is cached on the caller's path, and the transformed copy inherits it
+        const bool convex = path.isConvex() && !fReference;
+        //Map into the current layer, which sits at its translation on the device
+        GPoint translation = fLayerStack.top().translation;
+        GMatrix toLayer;
+        toLayer.setTranslate(-translation.x(), -translation.y());
+        toLayer.preConcat(fCTMStack.top());
         GPath nPath = path;
-        nPath.transform(fCTMStack.top());
+        nPath.transform(toLayer);
         GBitmap layer = fLayerStack.top().bitmap;
         GRect sides = GRect::MakeWH(layer.width(), layer.height());
 
-        std::deque<Edge> edges;
-        edges = clipPath(nPath, sides);
-        // We only draw between edges: 0 or 1 has no result
-        if(edges.size() < 2){
-          return;
+        Blitter blitter = makeBlitter(paint);
+        auto blit = [&](int l, int r, int y) { blitter.blitRow(l, r, y); };
+        if (convex) {
+            scanConvex(nPath, sides, blit);
+        } else {
+            scanPath(nPath, sides, blit);
         }
+    }
 
-        //Sort using predicate function defined in clip.cpp
-        std::sort(edges.begin(), edges.end(), compareEdge);
+    /*
+     * Triangles are scanned one at a time into a single blitter. Colors are interpolated by
+     * stepping the barycentric weights across each span. Texture coordinates are handled by the
+     * shader itself: its CTM is set so that it maps each triangle onto its texs.
+     */
+    virtual void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                          const int indices[], int triangleCount, const GPaint& paint) override {
+        G_STATS_CODE(DrawScope draw(this);)
+        G_TRACE_EVENT("canvas", "drawMesh");
+        Blitter blitter = makeBlitter(paint);
+        if (blitter.skip) {
+            return;
+        }
+        GShader* shader = blitter.shader;
+        const GMatrix& ctm = fCTMStack.top();
+        GPoint translation = fLayerStack.top().translation;
 
-        int y = edges.front().topY;
-        float x0;
-        float x1;
-        int winding = 0;
-        std::deque<Edge>::iterator edge;
-        while(y < GRoundToInt(sides.bottom())){
-            edge = edges.begin();
-            winding = 0;
-            while (edge != edges.end() && edge->topY <= y){
-                if (winding == 0){
-                    x0 = edge->curX;
+        //Only spans inside the layer and the clip bounds are ever produced
+        const GIRect area = drawArea(blitter);
+        if (area.isEmpty()) {
+            return;
+        }
+        fPixelScratch.resize(area.width());
+        GPixel* pixels = fPixelScratch.data();
+
+        G_TRACE_EVENT("blit", "spans");
+        for (int i = 0; i < triangleCount; ++i) {
+            int v[3] = { 3 * i, 3 * i + 1, 3 * i + 2 };
+            if (indices) {
+                v[0] = indices[3 * i];
+                v[1] = indices[3 * i + 1];
+                v[2] = indices[3 * i + 2];
+            }
+            GPoint pts[3];
+            for (int k = 0; k < 3; ++k) {
+                pts[k] = ctm.mapPt(verts[v[k]]);
+                pts[k].fX -= translation.x();
+                pts[k].fY -= translation.y();
+            }
+            if (shader && texs && !setMeshShader(shader, verts, texs, v)) {
+                continue;
+            }
+            GColor c[3];
+            if (colors) {
+                for (int k = 0; k < 3; ++k) {
+                    c[k] = colors[v[k]].pinToUnit();
                 }
-                winding += edge->winding;
-                if (winding == 0){
-                    x1 = edge->curX;
-                    if(x0 > x1){
-                        std::swap(x0, x1);
-                    }
-                    drawRow(GRoundToInt(x0), GRoundToInt(x1), y, paint);
+            }
+
+            scanTriangle(pts, area, [&](int left, int right, int y, const float w[3],
+                                        const float dw[3]) {
+                if (!colors) {
+                    blitter.blitRow(left, right, y);
+                    return;
                 }
-                if (edge->botY <= y + 1) {	// we’re done with edge
-                    Edge toErase = *edge;
-                    if(toErase == edges.back()){
-                        edges.pop_back();
-                        edge = edges.begin();
-                    }else{
-                        edges.erase(std::remove(edges.begin(), edges.end(), toErase), edges.end());
-                    }
-                    if(edges.empty()){return;}
-                } else {
-                    float newCurX = edge->curX + edge->slope;
-                    edge->curX = newCurX;
-                    std::sort(edges.begin(), ++edge, resortCompare);
+                const int count = right - left;
+                if (shader) {
+                    shader->shadeRow(left, y, count, pixels);
                 }
+                float w0 = w[0], w1 = w[1], w2 = w[2];
+                for (int x = 0; x < count; ++x) {
+                    GColor color = GColor::MakeARGB(
+                        w0 * c[0].fA + w1 * c[1].fA + w2 * c[2].fA,
+                        w0 * c[0].fR + w1 * c[1].fR + w2 * c[2].fR,
+                        w0 * c[0].fG + w1 * c[1].fG + w2 * c[2].fG,
+                        w0 * c[0].fB + w1 * c[1].fB + w2 * c[2].fB);
+                    GPixel p = colortoPixel(color);
+                    pixels[x] = shader ? modulate(pixels[x], p) : p;
+                    w0 += dw[0];
+                    w1 += dw[1];
+                    w2 += dw[2];
+                }
+                blitter.blitRow(left, right, y, pixels);
+            });
+        }
+    }
+
+////////////////// CLIP METHODS ///////////////////////////
+
+    /*
+     * Axis-aligned rects just narrow the clip bounds. Anything else goes through clipPath.
+     */
+    virtual void clipRect(const GRect& rect) override {
+        const GMatrix& ctm = fCTMStack.top();
+        if (ctm[GMatrix::KX] != 0 || ctm[GMatrix::KY] != 0) {
+            GPath path;
+            path.addRect(rect);
+            clipPath(path);
+            return;
+        }
+        GPoint p0 = ctm.mapPt(GPoint::Make(rect.left(), rect.top()));
+        GPoint p1 = ctm.mapPt(GPoint::Make(rect.right(), rect.bottom()));
+        //Keep the pixels whose centers are inside, just as drawRect fills
+        GRect mapped = GRect::MakeLTRB(std::min(p0.x(), p1.x()), std::min(p0.y(), p1.y()),
+                                       std::max(p0.x(), p1.x()), std::max(p0.y(), p1.y()));
+        fClipStack.top().intersectRect(mapped.round());
+    }
+
+    /*
+     * Rasterize the path into a coverage mask over the current clip bounds, with the same
+     * spans drawPath would fill, and intersect the clip with it.
+     */
+    virtual void clipPath(const GPath& path) override {
+        DeviceClip& clip = fClipStack.top();
+        if (clip.isEmpty()) {
+            return;
+        }
+        const bool convex = path.isConvex() && !fReference;
+        GPath nPath = path;
+        nPath.transform(fCTMStack.top());
+
+        const GIRect bounds = clip.fBounds;
+        const int w = bounds.width();
+        std::vector<uint8_t> mask(w * bounds.height(), 0);
+        //Scan against the whole device, as drawPath does: edges clipped to a smaller rect are
+        //sampled differently, which would move the edges of the mask
+        GRect sides = GRect::MakeWH(fDevice.width(), fDevice.height());
+        auto blit = [&](int l, int r, int y) {
+            l = std::max(l, bounds.left());
+            r = std::min(r, bounds.right());
+            if (l < r && y >= bounds.top() && y < bounds.bottom()) {
+                memset(&mask[(y - bounds.top()) * w + l - bounds.left()], 0xFF, r - l);
             }
-            ++y;
-            while (edge != edges.end() && edge->topY == y) { // pick up new edges for the next line
-                std::sort(edges.begin(), ++edge, resortCompare);
-            }
+        };
+        if (convex) {
+            scanConvex(nPath, sides, blit);
+        } else {
+            scanPath(nPath, sides, blit);
+        }
+        clip.intersectMask(bounds, &mask);
+    }
+
+    virtual bool quickReject(const GRect& bounds) const override {
+        const DeviceClip& clip = fClipStack.top();
+        if (clip.isEmpty()) {
+            return true;
         }
-        return;
+        GPoint corners[4] = {
+               GPoint::Make(bounds.left(), bounds.top()),
+               GPoint::Make(bounds.right(), bounds.top()),
+               GPoint::Make(bounds.right(), bounds.bottom()),
+               GPoint::Make(bounds.left(), bounds.bottom())
+        };
+        fCTMStack.top().mapPoints(corners, corners, 4);
+        return !deviceBounds(corners, 4).roundOut().intersects(clip.fBounds);
     }
 
 ////////////////// MATRIX METHODS ///////////////////////////
@@ -215,13 +461,17 @@ virtual std::unique_ptr<GShader> final_createTriangleGradient(const GPoint pts[3
     }
 
     virtual void restore() override {
+        G_TRACE_EVENT("canvas", "restore");
         if(fLayerBool.top()){
           //do layer stuff
           Layer layer = fLayerStack.top();
           fLayerStack.pop();
-          layer.drawLayer(fLayerStack.top());
+          fClipStack.pop();
+          G_STATS_TIME(&fFrameStats, fCompositeNS);
+          layer.drawLayer(fLayerStack.top(), fClipStack.top());
         }else{
           fCTMStack.pop();
+          fClipStack.pop();
         }
         fLayerBool.pop();
     }
@@ -234,23 +484,23 @@ virtual std::unique_ptr<GShader> final_createTriangleGradient(const GPoint pts[3
 
         fCTMStack.push(deepCopy);
         fLayerBool.push(false);
+        fClipStack.push(fClipStack.top());
     }
 
   protected:
     virtual void onSaveLayer(const GRect* bounds, const GPaint& GPaint) {
+        G_TRACE_EVENT("canvas", "onSaveLayer");
         GBitmap bitmap =  fLayerStack.top().bitmap;
         GPoint bitmapTranslation = fLayerStack.top().translation;
         GMatrix ctm =  fCTMStack.top();
         fLayerBool.push(true);
-        if (bounds == nullptr){
-            int width  = bitmap.width();
-            int height = bitmap.height();
-            GBitmap* bmap = new GBitmap();
-            bmap->alloc(width, height);
-
-            Layer* layer = new Layer(*bmap, bitmapTranslation, GPaint);
-            fLayerStack.push(*layer);
-        }else{
+        fClipStack.push(fClipStack.top());
+        //Device area the layer covers: its mapped bounds, or all of the current layer
+        float left   = bitmapTranslation.x();
+        float right  = bitmapTranslation.x() + bitmap.width();
+        float top    = bitmapTranslation.y();
+        float bottom = bitmapTranslation.y() + bitmap.height();
+        if (bounds != nullptr){
             //Convert bounds to mapped points
             GPoint CTMpoints[4] = {
                  GPoint::Make(bounds->left(), bounds->top()),
@@ -259,91 +509,417 @@ virtual std::unique_ptr<GShader> final_createTriangleGradient(const GPoint pts[3
                  GPoint::Make(bounds->left(), bounds->bottom())
             };
             ctm.mapPoints(CTMpoints, CTMpoints, 4);
-
-            //Find bounds. Ugly but should work. Modularize later.
-            float left   = CTMpoints[0].x();
-            float right  = CTMpoints[0].x();
-            float top    = CTMpoints[0].y();
-            float bottom = CTMpoints[0].y();
-            for(int i = 1; i < 4; ++i){
-                  if(CTMpoints[i].x() < left){
-                    left = CTMpoints[i].x();
-                  }
-                  if(CTMpoints[i].x() > right){
-                    right = CTMpoints[i].x();
-                  }
-                  if(CTMpoints[i].y() < top){
-                    top = CTMpoints[i].y();
-                  }
-                  if(CTMpoints[i].y() > bottom){
-                    bottom = CTMpoints[i].y();
-                  }
-            }
-            left  = max(left, (float) bitmapTranslation.x());
-            right = min(right, (float) bitmap.width() + bitmapTranslation.x());
-            top = max(top, (float) bitmapTranslation.y());
-            bottom = min(bottom, (float) bitmap.height() + bitmapTranslation.y());
-
-            int width = GRoundToInt(right - left);
-            int height = GRoundToInt(bottom - top);
-            if(width <= 0 || height <= 0){
-              fLayerStack.push(fLayerStack.top());
-              return;
-            }
-            GBitmap* newBitmap = new GBitmap();
-            newBitmap->alloc(width, height);
-
-            GPoint translation = GPoint::Make(GRoundToInt(left), GRoundToInt(top));
-            Layer* layer = new Layer(*newBitmap, translation, GPaint);
-            fLayerStack.push(*layer);
+            const GRect mapped = deviceBounds(CTMpoints, 4);
+            left   = max(left, mapped.left());
+            right  = min(right, mapped.right());
+            top    = max(top, mapped.top());
+            bottom = min(bottom, mapped.bottom());
+        }
+        //restore() only composites the pixels inside the clip, so the layer needn't cover more
+        const GIRect& clip = fClipStack.top().fBounds;
+        left   = max(left, (float) clip.left());
+        right  = min(right, (float) clip.right());
+        top    = max(top, (float) clip.top());
+        bottom = min(bottom, (float) clip.bottom());
+
+        int width = GRoundToInt(right - left);
+        int height = GRoundToInt(bottom - top);
+        GPoint translation = GPoint::Make(GRoundToInt(left), GRoundToInt(top));
+        if(width <= 0 || height <= 0){
+          //Nothing drawn inside can land anywhere
+          fClipStack.top().setEmpty();
+          fLayerStack.push(Layer(GBitmap(), translation, GPaint));
+          return;
         }
+        GBitmap* newBitmap = new GBitmap();
+        newBitmap->alloc(width, height);
+        G_STATS_ADD(&fFrameStats, fLayers, 1);
+        G_STATS_ADD(&fFrameStats, fLayerBytes, (int64_t)width * height * sizeof(GPixel));
+
+        fLayerStack.push(Layer(*newBitmap, translation, GPaint));
     }
 
   private:
     const GBitmap fDevice;
+    const bool fReference;      // skip the fast paths for the general code (GBackend)
     std::stack<GMatrix> fCTMStack;
     std::stack<bool> fLayerBool;
     std::stack<Layer> fLayerStack;
+    std::stack<DeviceClip> fClipStack;    // device pixels we may touch
+    std::deque<Edge> fEdgeScratch;
+    std::vector<GPoint> fPointScratch;
+    std::vector<GPixel> fPixelScratch;
+
+#ifdef G_STATS
+    GStats fFrameStats;         // since the canvas was made, or resetStats()
+    GStats fDrawStats;          // of the current (or last) draw call
+    int fDrawDepth = 0;
+
+    /*
+     * Lives for the length of a draw call. The outermost call (draws call one another) starts
+     * fDrawStats afresh, and adds it to the frame's when it returns.
+     */
+    struct DrawScope {
+        EmptyCanvas* canvas;
 
-    void drawRow(int leftX, int rightX, int y, const GPaint& paint){
-        if(leftX == rightX){return;}
-        GBitmap bitmap = fLayerStack.top().bitmap;
-        leftX = std::max(0, leftX);
-        rightX = std::min(bitmap.width(), rightX);
-        y = std::min(bitmap.height() - 1, y);
-        int count = rightX - leftX;
-
-        //Get paint info
-        Blend blend = getBlend(paint.getBlendMode());
-        GShader* shader = paint.getShader();
-        GFilter* filter = paint.getFilter();
-
-        if(shader){
-            if (!shader->setContext(fCTMStack.top())) {
-                return;
+        DrawScope(EmptyCanvas* canvas) : canvas(canvas) {
+            if (canvas->fDrawDepth++ == 0) {
+                canvas->fDrawStats = GStats();
+                canvas->fDrawStats.fDraws = 1;
             }
-            GPixel thisRow[count];
-            shader->shadeRow(leftX, y, count, thisRow);
+        }
+        ~DrawScope() {
+            if (--canvas->fDrawDepth == 0) {
+                canvas->fFrameStats += canvas->fDrawStats;
+            }
+        }
+    };
+
+  public:
+    bool getStats(GStats* frame, GStats* lastDraw) const override {
+        if (frame) {
+            *frame = fFrameStats;
+        }
+        if (lastDraw) {
+            *lastDraw = fDrawStats;
+        }
+        return true;
+    }
+
+    void resetStats() override {
+        fFrameStats = GStats();
+        fDrawStats = GStats();
+    }
 
-            if(filter){
-              filter->filter(thisRow, thisRow, count);
+  private:
+#endif
+
+    static GRect deviceBounds(const GPoint points[], int count) {
+        GRect bounds = GRect::MakeLTRB(points[0].x(), points[0].y(), points[0].x(), points[0].y());
+        for (int i = 1; i < count; ++i) {
+            bounds.fLeft   = std::min(bounds.fLeft, points[i].x());
+            bounds.fTop    = std::min(bounds.fTop, points[i].y());
+            bounds.fRight  = std::max(bounds.fRight, points[i].x());
+            bounds.fBottom = std::max(bounds.fBottom, points[i].y());
+        }
+        return bounds;
+    }
+
+    /*
+     * True if the convex polygon (device points) can't touch the clip. Edges are sampled at row
+     * centers inside their own extent, so spans never leave the points' bounds.
+     */
+    bool rejectConvex(const GPoint points[], int count) const {
+        const DeviceClip& clip = fClipStack.top();
+        if (clip.isEmpty() || count <= 0) {
+            return true;
+        }
+        return !deviceBounds(points, count).roundOut().intersects(clip.fBounds);
+    }
+
+    /*
+     * Walk the spans of a (device space) path with non-zero winding, clipped to sides, calling
+     * blit(left, right, y) for each.
+     */
+    template <typename Blit> void scanPath(const GPath& path, const GRect& sides, Blit blit) {
+        std::deque<Edge> edges;
+        {
+            G_STATS_TIME(&fDrawStats, fEdgeNS);
+            edges = ::clipPath(path, sides);
+            //Clipping can leave pieces that cover no rows, whose winding must not count
+            edges.erase(std::remove_if(edges.begin(), edges.end(),
+                                       [](const Edge& e) { return e.botY <= e.topY; }),
+                        edges.end());
+        }
+        G_STATS_ADD(&fDrawStats, fEdges, edges.size());
+        // We only draw between edges: 0 or 1 has no result
+        if(edges.size() < 2){
+          return;
+        }
+
+        //Sort using predicate function defined in clip.cpp
+        {
+            G_STATS_TIME(&fDrawStats, fSortNS);
+            std::sort(edges.begin(), edges.end(), compareEdge);
+        }
+
+        int y = edges.front().topY;
+        float x0;
+        float x1;
+        int winding = 0;
+        std::deque<Edge>::iterator edge;
+        G_TRACE_EVENT("blit", "spans");
+        while(y < GRoundToInt(sides.bottom())){
+            edge = edges.begin();
+            winding = 0;
+            while (edge != edges.end() && edge->topY <= y){
+                if (winding == 0){
+                    x0 = edge->curX;
+                }
+                winding += edge->winding;
+                if (winding == 0){
+                    x1 = edge->curX;
+                    if(x0 > x1){
+                        std::swap(x0, x1);
+                    }
+                    blit(GRoundToInt(x0), GRoundToInt(x1), y);
+                }
+                if (edge->botY <= y + 1) {	// we’re done with edge
+                    //Only this one: an identical edge still adds its own winding
+                    edge = edges.erase(edge);
+                    if(edges.empty()){return;}
+                } else {
+                    float newCurX = edge->curX + edge->slope;
+                    edge->curX = newCurX;
+                    std::sort(edges.begin(), ++edge, resortCompare);
+                }
             }
+            ++y;
+            while (edge != edges.end() && edge->topY == y) { // pick up new edges for the next line
+                std::sort(edges.begin(), ++edge, resortCompare);
+            }
+        }
+    }
 
-            //Blend and fill row memory with shaded pixels
-            for (int x = leftX; x < rightX; ++x) {
-                GPixel* addr = bitmap.getAddr(x, y);
-                *addr = blend(thisRow[x - leftX], *addr);
+    /*
+     * Give the shader the CTM that maps the triangle verts[v] onto texs[v] in its coordinates:
+     * CTM * (triangle basis) * inverse(texture basis).
+     */
+    bool setMeshShader(GShader* shader, const GPoint verts[], const GPoint texs[],
+                       const int v[3]) {
+        const GPoint p0 = verts[v[0]], p1 = verts[v[1]], p2 = verts[v[2]];
+        const GPoint t0 = texs[v[0]], t1 = texs[v[1]], t2 = texs[v[2]];
+        GMatrix triangle(p1.x() - p0.x(), p2.x() - p0.x(), p0.x(),
+                         p1.y() - p0.y(), p2.y() - p0.y(), p0.y());
+        GMatrix texture(t1.x() - t0.x(), t2.x() - t0.x(), t0.x(),
+                        t1.y() - t0.y(), t2.y() - t0.y(), t0.y());
+        GMatrix inverse;
+        if (!texture.invert(&inverse)) {
+            return false;
+        }
+        GMatrix m;
+        m.setConcat(fCTMStack.top(), triangle);
+        m.preConcat(inverse);
+        return shader->setContext(m);
+    }
+
+    /*
+     * Multiply two premultiplied pixels channel by channel.
+     */
+    static GPixel modulate(GPixel a, GPixel b) {
+        return GPixel_PackARGB(
+            (GPixel_GetA(a) * GPixel_GetA(b) + 127) / 255,
+            (GPixel_GetR(a) * GPixel_GetR(b) + 127) / 255,
+            (GPixel_GetG(a) * GPixel_GetG(b) + 127) / 255,
+            (GPixel_GetB(a) * GPixel_GetB(b) + 127) / 255);
+    }
+
+    /*
+     * scanPath for a convex path (see GPath::isConvex): every row crosses exactly two edges,
+     * so they are walked as a left/right pair, as fillConvex does, with no winding counts and
+     * no re-sorting. The spans are the ones scanPath would produce.
+     */
+    template <typename Blit> void scanConvex(const GPath& path, const GRect& sides, Blit blit) {
+        std::deque<Edge>& edges = fEdgeScratch;
+        {
+            G_STATS_TIME(&fDrawStats, fEdgeNS);
+            edges = ::clipPath(path, sides);
+            //Clipping can leave pieces that cover no rows
+            edges.erase(std::remove_if(edges.begin(), edges.end(),
+                                       [](const Edge& e) { return e.botY <= e.topY; }),
+                        edges.end());
+        }
+        G_STATS_ADD(&fDrawStats, fEdges, edges.size());
+        if(edges.size() < 2){
+          return;
+        }
+        {
+            G_STATS_TIME(&fDrawStats, fSortNS);
+            std::sort(edges.begin(), edges.end(), compareEdge);
+        }
+
+        Edge left = edges.front();
+        edges.pop_front();
+        Edge right = edges.front();
+        edges.pop_front();
+        G_TRACE_EVENT("blit", "spans");
+        for(int y = left.topY; ; ++y){
+            blit(GRoundToInt(std::min(left.curX, right.curX)),
+                 GRoundToInt(std::max(left.curX, right.curX)), y);
+
+            //Edges are done after their last row; the next one in order picks up below them
+            if (left.botY <= y + 1) {
+                if (edges.empty()) {
+                    return;
+                }
+                left = edges.front();
+                edges.pop_front();
+            } else {
+                left.curX += left.slope;
             }
-        }else{
-            GPixel src[1] = {colortoPixel(paint.getColor())};
+            if (right.botY <= y + 1) {
+                if (edges.empty()) {
+                    return;
+                }
+                right = edges.front();
+                edges.pop_front();
+            } else {
+                right.curX += right.slope;
+            }
+        }
+    }
+
+    /*
+     * The part of the layer (in layer coordinates) inside the clip bounds.
+     */
+    static GIRect drawArea(const Blitter& blitter) {
+        const GIRect& clip = blitter.clip->fBounds;
+        return GIRect::MakeLTRB(
+            std::max(0, clip.left() - blitter.originX), std::max(0, clip.top() - blitter.originY),
+            std::min(blitter.bitmap.width(), clip.right() - blitter.originX),
+            std::min(blitter.bitmap.height(), clip.bottom() - blitter.originY));
+    }
+
+    Blitter makeBlitter(const GPaint& paint) {
+        const Layer& layer = fLayerStack.top();
+        Blitter blitter(layer.bitmap, layer.translation, fClipStack.top(), paint,
+                        fCTMStack.top(), !fReference);
+        G_STATS_CODE(blitter.stats = &fDrawStats;)
+        return blitter;
+    }
+
+    /*
+     * Fill a rect (local coordinates). When the CTM keeps it axis-aligned (scales and
+     * translates, possibly swapping x and y), its rows are blitted directly, covering the same
+     * pixels the convex rasterizer would, with no edges built.
+     */
+    void fillRect(const GRect& rect, Blitter& blitter) {
+        GPoint points[4] = {
+               GPoint::Make(rect.left(), rect.top()),
+               GPoint::Make(rect.right(), rect.top()),
+               GPoint::Make(rect.right(), rect.bottom()),
+               GPoint::Make(rect.left(), rect.bottom())
+        };
+        const GMatrix& ctm = fCTMStack.top();
+        ctm.mapPoints(points, points, 4);
+        const bool scaled = ctm[GMatrix::KX] == 0 && ctm[GMatrix::KY] == 0;
+        const bool swapped = ctm[GMatrix::SX] == 0 && ctm[GMatrix::SY] == 0;
+        if ((!scaled && !swapped) || fReference) {
+            fillConvex(points, 4, blitter);
+            return;
+        }
+
+        //Clamp to just outside the layer before rounding, so huge or NaN rects stay in range
+        GPoint translation = fLayerStack.top().translation;
+        const float w = blitter.bitmap.width(), h = blitter.bitmap.height();
+        auto pin = [](float v, float max) { return std::min(std::max(-1.0f, v), max + 1); };
+        const float x0 = pin(points[0].x() - translation.x(), w);
+        const float x1 = pin(points[2].x() - translation.x(), w);
+        const float y0 = pin(points[0].y() - translation.y(), h);
+        const float y1 = pin(points[2].y() - translation.y(), h);
+        int top    = GRoundToInt(std::min(y0, y1));
+        int bottom = GRoundToInt(std::max(y0, y1));
+        int left   = GRoundToInt(std::min(x0, x1));
+        int right  = GRoundToInt(std::max(x0, x1));
+
+        //Rows outside the layer or the clip are never visited
+        const GIRect& clip = blitter.clip->fBounds;
+        top = std::max(top, std::max(0, clip.top() - blitter.originY));
+        bottom = std::min(bottom, std::min(blitter.bitmap.height(),
+                                           clip.bottom() - blitter.originY));
+        G_TRACE_EVENT("blit", "spans");
+        for (int y = top; y < bottom; ++y) {
+            blitter.blitRow(left, right, y);
+        }
+    }
+
+    /*
+     * Fill a convex polygon whose points are already mapped by the CTM.
+     */
+    void fillConvex(GPoint CTMpoints[], int count, Blitter& blitter) {
+        if (blitter.skip || rejectConvex(CTMpoints, count)) {
+            return;
+        }
 
-            if(filter){
-              filter->filter(src, src, 1);
+        GBitmap layer = blitter.bitmap;
+
+        //Correct for translation of current layer. (I should do this in CTM but not right now)
+        GPoint translation = fLayerStack.top().translation;
+        for(int i = 0; i < count; ++i){
+            CTMpoints[i].fX += -translation.x();
+            CTMpoints[i].fY += -translation.y();
+        }
+        //Start by building edge deque and ordering them correctly
+        GRect sides = GRect::MakeWH(layer.width(), layer.height());
+
+        //Clip edges and place in deque - for autosizing, front&back access. The deque is kept
+        //between draws so batches don't reallocate it.
+        std::deque<Edge>& edges = fEdgeScratch;
+        edges.clear();
+        {
+            G_STATS_TIME(&fDrawStats, fEdgeNS);
+            for (int i = 0; i < count; ++i) {
+              GPoint p0 = CTMpoints[i];
+              GPoint p1 = CTMpoints[(i + 1) % count];
+              clip(p0, p1, sides, edges);
             }
+            //Clipping can leave pieces that cover no rows
+            edges.erase(std::remove_if(edges.begin(), edges.end(),
+                                       [](const Edge& e) { return e.botY <= e.topY; }),
+                        edges.end());
+        }
+        G_STATS_ADD(&fDrawStats, fEdges, edges.size());
 
-            for (int x = leftX; x < rightX; ++x) {
-                GPixel* addr = bitmap.getAddr(x, y);
-                *addr = blend(src[0], *addr);
+        // We only draw between edges: 0 or 1 has no result
+        if(edges.size() < 2){
+          return;
+        }
+
+        //Sort using predicate function defined in clip.cpp
+        {
+            G_STATS_TIME(&fDrawStats, fSortNS);
+            std::sort(edges.begin(), edges.end(), compareEdge);
+        }
+
+        // Set up boundary conditions
+        int bottom =  GRoundToInt(edges.back().botY);
+        Edge left = edges.front();
+        edges.pop_front();
+        Edge right = edges.front();
+        edges.pop_front();
+
+        int y = GRoundToInt(left.topY);
+        float leftX = left.curX;
+        float rightX = right.curX;
+        // Draw 1-Pixel high rectangles for each row
+        G_TRACE_EVENT("blit", "spans");
+        for(y; y < bottom; ++y) {
+            int l = GRoundToInt(std::min(leftX, rightX));
+            int r = GRoundToInt(std::max(leftX, rightX));
+            blitter.blitRow(l, r, y);
+
+            //Check to see if completed left or right edge (this was its last row)
+            //If so, replace with next edge (none left means a degenerate polygon)
+            if (left.botY <= y + 1) {
+                if (edges.empty()) {
+                    return;
+                }
+                left = edges.front();
+                edges.pop_front();
+                leftX = left.curX;
+            } else {
+                leftX += left.slope;
+            }
+
+            if (right.botY <= y + 1) {
+                if (edges.empty()) {
+                    return;
+                }
+                right = edges.front();
+                edges.pop_front();
+                rightX = right.curX;
+            } else {
+                rightX += right.slope;
             }
         }
     }
@@ -353,8 +929,25 @@ virtual std::unique_ptr<GShader> final_createTriangleGradient(const GPoint pts[3
  * Canvas factory
  */
 std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& device) {
+    return GCreateCanvas(device, GBackend::kOptimized);
+}
+
+std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& device, GBackend backend) {
+    if (!device.pixels()) {
+        return nullptr;
+    }
+    return std::unique_ptr<GCanvas>(new EmptyCanvas(device,
+                                                    GIRect::MakeWH(device.width(), device.height()),
+                                                    backend));
+}
+
+std::unique_ptr<GCanvas> GCreateClippedCanvas(const GBitmap& device, const GIRect& clip) {
     if (!device.pixels()) {
         return nullptr;
     }
-    return std::unique_ptr<GCanvas>(new EmptyCanvas(device));
+    GIRect bounded = clip;
+    if (!bounded.intersect(GIRect::MakeWH(device.width(), device.height()))) {
+        bounded = GIRect::MakeWH(0, 0);
+    }
+    return std::unique_ptr<GCanvas>(new EmptyCanvas(device, bounded));
 }
@@ -12,6 +12,7 @@ class GBitmap;
 class GPath;
 class GPoint;
 class GRect;
+struct GStats;
 
 class GCanvas {
 public:
@@ -111,6 +112,37 @@ public:
      */
     virtual void concat(const GMatrix& matrix) = 0;
 
+    /**
+     *  Intersect the clip with the rectangle, mapped by the CTM. Later draws only change pixels
+     *  inside the clip. The clip is part of the canvas state: save() and saveLayer() record it,
+     *  and the balancing restore() puts it back. The canvas starts out clipped to its bounds.
+     *
+     *  The pixels kept are those a drawRect() of the same rectangle would fill.
+     */
+    virtual void clipRect(const GRect&) = 0;
+
+    /**
+     *  Intersect the clip with the path, mapped by the CTM, keeping the pixels a drawPath() of
+     *  it would fill.
+     */
+    virtual void clipPath(const GPath&) = 0;
+
+    /**
+     *  Return true if no draw whose geometry lies inside bounds (in local coordinates) can change
+     *  a pixel, because bounds mapped by the CTM miss the clip. Callers can use this to skip
+     *  building and submitting draws that are off screen. false does not promise anything will
+     *  be drawn.
+     */
+    virtual bool quickReject(const GRect& bounds) const = 0;
+
+    /**
+     *  Copy the canvas's rendering counters (see GStats.h) into frame (everything since the
+     *  canvas was made or resetStats() was called) and lastDraw (the most recent draw call).
+     *  Either may be null. Returns false, leaving them alone, if the canvas doesn't count.
+     */
+    virtual bool getStats(GStats*, GStats*) const { return false; }
+    virtual void resetStats() {}
+
     /**
      *  Fill the entire canvas with the specified color, using the specified blendmode.
      */
@@ -134,6 +166,79 @@ public:
      */
     virtual void drawPath(const GPath&, const GPaint&) = 0;
 
+    /**
+     *  Fill triangleCount triangles. Triangle i is made of verts[indices[3i]], verts[indices[3i+1]]
+     *  and verts[indices[3i+2]], or of verts[3i .. 3i+2] if indices is null.
+     *
+     *  A pixel is filled if its center is inside a triangle. A center exactly on an edge shared by
+     *  two triangles is filled by only one of them, so meshes have no cracks and never blend a
+     *  pixel twice.
+     *
+     *  If colors is not null, each vertex has a color, which is interpolated across the triangle
+     *  (between GColors, then premultiplied) and used in place of the paint's color.
+     *
+     *  If texs is not null and the paint has a shader, each vertex also has a position in the
+     *  shader's coordinates, and the shader is mapped onto each triangle to match. With colors as
+     *  well, the shader's pixels are multiplied by the interpolated colors.
+     */
+    virtual void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                          const int indices[], int triangleCount, const GPaint&) = 0;
+
+    /**
+     *  Fill the rectangle with its corners rounded off by quarter ellipses of radii rx and ry.
+     *  Each radius is pinned to half the rect's size, so 0 gives a plain rect and half the size
+     *  an oval. Pixels follow the same "containment" rule as drawRect(). If the paint is
+     *  anti-aliased, pixels on the edge are instead blended by how much of them is covered.
+     *
+     *  The default fills a path of lines and cubics with drawPath().
+     */
+    virtual void drawRoundRect(const GRect&, float rx, float ry, const GPaint&);
+
+    /**
+     *  Draw a line from p0 to p1, width wide (in local coordinates), with square-cut ends at p0
+     *  and p1: it fills the pixels whose centers are inside that quad.
+     *
+     *  A width of 0 is a hairline: one pixel per row or column (whichever the line crosses more
+     *  of) however the CTM scales it, leaving out the pixel at p1. If the paint is anti-aliased,
+     *  each step instead splits its coverage between the two pixels nearest the line.
+     *
+     *  The default fills the line's quad with drawConvexPolygon(), taking hairlines as 1 wide.
+     */
+    virtual void drawLine(GPoint p0, GPoint p1, float width, const GPaint&);
+
+    /**
+     *  Draw count - 1 lines joining pts in order, as drawLine() would. Lines wider than a
+     *  hairline are not joined, so where they overlap a translucent paint blends twice.
+     */
+    virtual void drawPolyline(const GPoint pts[], int count, float width, const GPaint&);
+
+    // Batched draws
+    //
+    // Each of these draws count items exactly as that many calls to the single-item method
+    // would. If colors is not null, item i is drawn with colors[i] in place of the paint's color
+    // (the blend mode, shader and filter are shared). Canvases can override them to resolve the
+    // paint once and reuse their scan state across the batch; the defaults just loop.
+
+    /**
+     *  Fill each of the rectangles, as drawRect() would.
+     */
+    virtual void drawRects(const GRect rects[], int count, const GPaint&,
+                           const GColor colors[] = nullptr);
+
+    /**
+     *  Fill polyCount convex polygons, as drawConvexPolygon() would. Polygon i is made of the
+     *  next counts[i] points of pts[].
+     */
+    virtual void drawConvexPolygons(const GPoint pts[], const int counts[], int polyCount,
+                                    const GPaint&, const GColor colors[] = nullptr);
+
+    /**
+     *  Draw each point as a size x size square (in local coordinates) centered on it, as
+     *  drawRect() would.
+     */
+    virtual void drawPoints(const GPoint pts[], int count, float size, const GPaint&,
+                            const GColor colors[] = nullptr);
+
     // Helpers
 
     void translate(float x, float y) {
@@ -158,6 +263,13 @@ public:
         this->drawRect(rect, GPaint(color));
     }
 
+    /**
+     *  Fill the oval inscribed in the rectangle, as a round rect whose radii are half its size.
+     */
+    void drawOval(const GRect& oval, const GPaint& paint) {
+        this->drawRoundRect(oval, fabsf(oval.width()) * 0.5f, fabsf(oval.height()) * 0.5f, paint);
+    }
+
 protected:
     virtual void onSaveLayer(const GRect* bounds, const GPaint&) = 0;
 };
@@ -168,4 +280,29 @@ protected:
  */
 std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& bitmap);
 
+/**
+ *  Which implementation a canvas draws with.
+ *
+ *  kReference leaves out each fast path that promises the same pixels as more general code,
+ *  drawing with that code instead: axis-aligned rects and convex paths go through the general
+ *  edge scanner, opaque spans are blended rather than stored, and batches loop over the
+ *  single-item draws. Shapes scanned straight from their geometry (hairlines, thin lines,
+ *  axis-aligned round rects) have no such equivalent and are drawn the same way by both.
+ *  kReference is slower, and is meant for checking the fast paths against, by drawing the
+ *  same thing both ways and comparing the pixels.
+ */
+enum class GBackend {
+    kOptimized,
+    kReference,
+};
+
+std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& bitmap, GBackend backend);
+
+/**
+ *  Like GCreateCanvas, but the canvas never reads or writes device pixels outside of clip (in
+ *  device coordinates). Pixels inside clip come out exactly as GCreateCanvas(bitmap) would draw
+ *  them, so canvases with disjoint clips can draw into the same bitmap at the same time.
+ */
+std::unique_ptr<GCanvas> GCreateClippedCanvas(const GBitmap& bitmap, const GIRect& clip);
+
 #endif
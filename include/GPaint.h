@@ -36,11 +36,17 @@ public:
     GFilter* getFilter() const { return fFilter; }
     GPaint&  setFilter(GFilter* filter) { fFilter = filter; return *this; }
 
+    // Only drawRoundRect(), drawOval() and hairlines look at this for now; other draws are
+    // aliased.
+    bool    isAntiAlias() const { return fAntiAlias; }
+    GPaint& setAntiAlias(bool aa) { fAntiAlias = aa; return *this; }
+
 private:
     GColor      fColor = GColor::MakeARGB(1, 0, 0, 0);
     GShader*    fShader = nullptr;
     GFilter*    fFilter = nullptr;
     GBlendMode  fMode = GBlendMode::kSrcOver;
+    bool        fAntiAlias = false;
 };
 
 #endif
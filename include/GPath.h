@@ -1,6 +1,7 @@
 #ifndef GPath_DEFINED
 #define GPath_DEFINED
 
+#include <atomic>
 #include <vector>
 #include "GPoint.h"
 #include "GRect.h"
@@ -10,6 +11,7 @@ class GMatrix;
 class GPath {
 public:
     GPath();
+    GPath(const GPath&);
     ~GPath();
 
     GPath& operator=(const GPath&);
@@ -62,6 +64,14 @@ public:
      */
     void transform(const GMatrix&);
 
+    /**
+     *  Return true if the path is a single contour (implicitly closed) that bounds a convex
+     *  area: its points, control points included, turn the same way all the way around, once.
+     *  Such a path covers each row of pixels with at most one span. The answer is cached until
+     *  the path is next changed; transform() keeps it, since matrices preserve convexity.
+     */
+    bool isConvex() const;
+
     enum Verb {
         kMove,  // returns pts[0] from Iter
         kLine,  // returns pts[0]..pts[1] from Iter and Edger
@@ -130,8 +140,18 @@ public:
     static void ChopCubicAt(const GPoint src[4], GPoint dst[7], float t);
 
 private:
+    enum Convexity {
+        kUnknown_Convexity,
+        kConvex_Convexity,
+        kConcave_Convexity,
+    };
+
+    // Walks the points to answer isConvex(), which caches the result.
+    bool computeConvex() const;
+
     std::vector<GPoint> fPts;
     std::vector<Verb>   fVbs;
+    mutable std::atomic<Convexity> fConvexity{kUnknown_Convexity};
 };
 
 #endif
@@ -0,0 +1,268 @@
+#ifndef GPicture_DEFINED
+#define GPicture_DEFINED
+
+#include <unordered_map>
+#include <vector>
+#include "GCanvas.h"
+#include "GMatrix.h"
+#include "GPaint.h"
+#include "GPath.h"
+#include "GRect.h"
+
+/**
+ *  An immutable display list of canvas calls, created by GRecordingCanvas.
+ *
+ *  All ops live back to back in one contiguous command buffer. Paths and polygons are stored
+ *  inline in their op, and paints are deduplicated into a side table that ops refer to by index.
+ *
+ *  Shaders and filters are NOT copied: a recorded paint keeps the same GShader* / GFilter* that
+ *  was passed to the recording canvas, so those objects must outlive the picture.
+ */
+class GPicture {
+public:
+    enum Verb {
+        kSave,
+        kSaveLayer,         // payload: GRect bounds, only if (fFlags & kHasBounds_Flag)
+        kRestore,
+        kConcat,            // payload: float[6]
+        kDrawPaint,
+        kDrawRect,          // payload: GRect
+        kDrawConvexPolygon, // payload: GPoint[fPtCount]
+        kDrawPath,          // payload: GPoint[fPtCount], then fVerbCount GPath::Verbs as bytes
+        kClipRect,          // payload: GRect
+        kClipPath,          // payload: as kDrawPath
+        kDrawMesh,          // payload: GPoint verts[fPtCount], then (per the flags) GPoint
+                            //          texs[fPtCount], GColor colors[fPtCount] and
+                            //          int32_t indices[3 * fVerbCount]; fVerbCount triangles
+    };
+
+    enum {
+        kHasBounds_Flag     = 1 << 0,
+        kHasTexs_Flag       = 1 << 1,   // drawMesh
+        kHasColors_Flag     = 1 << 2,   // drawMesh
+        kHasIndices_Flag    = 1 << 3,   // drawMesh
+    };
+
+    /**
+     *  Header at the start of every op in the command buffer. fSize is the size in bytes of the
+     *  header plus its payload, and is always a multiple of 4.
+     */
+    struct Op {
+        uint8_t  fVerb;
+        uint8_t  fFlags;
+        uint16_t fReserved;
+        int32_t  fPaint;        // index into the paint table, or -1
+        uint32_t fSize;
+        uint32_t fPtCount;
+        uint32_t fVerbCount;
+
+        Verb verb() const { return (Verb)fVerb; }
+        bool isDraw() const {
+            return (fVerb >= kDrawPaint && fVerb <= kDrawPath) || fVerb == kDrawMesh;
+        }
+        bool isClip() const { return fVerb == kClipRect || fVerb == kClipPath; }
+
+        const GRect&   rect() const { return *reinterpret_cast<const GRect*>(this + 1); }
+        const GPoint*  points() const { return reinterpret_cast<const GPoint*>(this + 1); }
+        const uint8_t* verbs() const {
+            return reinterpret_cast<const uint8_t*>(this->points() + fPtCount);
+        }
+        const GPoint*  meshTexs() const {
+            return (fFlags & kHasTexs_Flag) ? this->points() + fPtCount : nullptr;
+        }
+        const GColor*  meshColors() const {
+            if (!(fFlags & kHasColors_Flag)) {
+                return nullptr;
+            }
+            return reinterpret_cast<const GColor*>(this->meshEnd(kHasTexs_Flag));
+        }
+        const int32_t* meshIndices() const {
+            if (!(fFlags & kHasIndices_Flag)) {
+                return nullptr;
+            }
+            return reinterpret_cast<const int32_t*>(this->meshEnd(kHasTexs_Flag |
+                                                                  kHasColors_Flag));
+        }
+        // end of the verts and of the per-vertex arrays in flags that this op has
+        const char* meshEnd(int flags) const {
+            const char* end = reinterpret_cast<const char*>(this->points() + fPtCount);
+            if (fFlags & flags & kHasTexs_Flag) {
+                end += fPtCount * sizeof(GPoint);
+            }
+            if (fFlags & flags & kHasColors_Flag) {
+                end += fPtCount * sizeof(GColor);
+            }
+            return end;
+        }
+        GMatrix matrix() const {
+            const float* m = reinterpret_cast<const float*>(this + 1);
+            return GMatrix(m[0], m[1], m[2], m[3], m[4], m[5]);
+        }
+    };
+
+    int countOps() const { return (int)fOffsets.size(); }
+
+    const Op& op(int index) const {
+        GASSERT(index >= 0 && index < this->countOps());
+        return *reinterpret_cast<const Op*>((const char*)fStorage.data() + fOffsets[index]);
+    }
+
+    int countPaints() const { return (int)fPaints.size(); }
+    const GPaint& paint(const Op& op) const { return fPaints[op.fPaint]; }
+
+    /**
+     *  True if any recorded paint refers to a shader or filter, i.e. the picture is only valid
+     *  while those objects are still alive.
+     */
+    bool hasExternalRefs() const;
+
+    /**
+     *  Return the device-space bounds of a draw op, given the CTM it is drawn with. The bounds
+     *  are conservative (curves use their control points, meshes all of their vertices).
+     *  drawPaint is unbounded, and non-draw ops return an empty rect.
+     */
+    static GRect DrawBounds(const Op&, const GMatrix& ctm);
+
+    /**
+     *  Return the device pixels (within device) that a draw op on the root layer may change,
+     *  given the CTM it is drawn with: DrawBounds() rounded out. The rasterizer only fills pixels
+     *  whose centers are inside the geometry, so nothing lands outside it.
+     */
+    static GIRect TouchedPixels(const Op&, const GMatrix& ctm, const GIRect& device);
+
+    /**
+     *  Return the device pixels (within device) that a clip op, given the CTM it is applied with,
+     *  may leave drawable. If isRect is not null, it is set to true when exactly those pixels
+     *  are kept (an axis-aligned clipRect), and false when they are only a bound.
+     */
+    static GIRect ClipPixels(const Op&, const GMatrix& ctm, const GIRect& device, bool* isRect);
+
+    /**
+     *  Fill bounds[] with DrawBounds() for every op, as seen by a canvas with an identity CTM.
+     */
+    void computeDeviceBounds(std::vector<GRect>* bounds) const;
+
+    /**
+     *  Return a new picture containing only the ops whose keep[] entry is true, in order.
+     */
+    std::unique_ptr<GPicture> makeSubset(const std::vector<bool>& keep) const;
+
+    /**
+     *  Bytes held by the command buffer, op index and paint table.
+     */
+    size_t approximateBytesUsed() const;
+
+    void playback(GCanvas* canvas) const { this->playback(canvas, 0, this->countOps()); }
+
+    /**
+     *  Replay the draw ops in [firstOp, lastOp) into the canvas. State ops (save, saveLayer,
+     *  restore, concat, clips) before firstOp are still replayed so that the draws see the same
+     *  CTM and layers they were recorded with. Any saves left open at lastOp are restored before
+     *  returning, so the canvas is left in the state it was passed in.
+     */
+    void playback(GCanvas*, int firstOp, int lastOp) const;
+
+    /**
+     *  Shaders to draw with in place of recorded ones, e.g. clones for another thread.
+     */
+    typedef std::unordered_map<const GShader*, GShader*> ShaderMap;
+
+    /**
+     *  Replay the single op at index into the canvas. scratch is reused to rebuild recorded
+     *  paths, so callers looping over many ops should pass the same GPath each time. Recorded
+     *  shaders found in shaders (if not null) are replaced by what they map to.
+     */
+    void playbackOp(GCanvas*, int index, GPath* scratch,
+                    const ShaderMap* shaders = nullptr) const;
+
+private:
+    GPicture() {}
+
+    std::vector<uint32_t> fStorage;     // command buffer, 4-byte aligned
+    std::vector<uint32_t> fOffsets;     // byte offset of each op in fStorage
+    std::vector<GPaint>   fPaints;
+
+    friend class GRecordingCanvas;
+};
+
+/**
+ *  A canvas that draws nothing, but records every call it receives into a GPicture. Round rects
+ *  and lines are recorded as the paths and quads GCanvas builds for them by default, so they
+ *  play back aliased (and hairlines 1 wide in local coordinates).
+ */
+class GRecordingCanvas : public GCanvas {
+public:
+    GRecordingCanvas();
+
+    std::unique_ptr<GShader> final_createRadialGradient(GPoint center, float radius,
+                                                        const GColor colors[], int count) override;
+    void final_addStrokedLine(GPath* path, GPoint p0, GPoint p1, float width,
+                              bool roundCap) override;
+    std::unique_ptr<GShader> final_createTriangleGradient(const GPoint pts[3],
+                                                          const GColor colors[3]) override;
+
+    void save() override;
+    void restore() override;
+    void concat(const GMatrix&) override;
+    void clipRect(const GRect&) override;
+    void clipPath(const GPath&) override;
+    void drawPaint(const GPaint&) override;
+    void drawRect(const GRect&, const GPaint&) override;
+    void drawConvexPolygon(const GPoint[], int count, const GPaint&) override;
+    void drawPath(const GPath&, const GPaint&) override;
+    void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                  const int indices[], int triangleCount, const GPaint&) override;
+
+    /**
+     *  The recorded picture may be played back into any canvas, so nothing is rejected.
+     */
+    bool quickReject(const GRect&) const override { return false; }
+
+    /**
+     *  Return the picture of everything recorded so far, and reset this canvas so it can record
+     *  a new one.
+     */
+    std::unique_ptr<GPicture> finishRecording();
+
+protected:
+    void onSaveLayer(const GRect* bounds, const GPaint&) override;
+
+private:
+    struct PaintHash {
+        size_t operator()(const GPaint&) const;
+    };
+    struct PaintEq {
+        bool operator()(const GPaint&, const GPaint&) const;
+    };
+
+    std::unique_ptr<GPicture> fPicture;
+    std::unordered_map<GPaint, int, PaintHash, PaintEq> fPaintIndex;
+
+    GPicture::Op* appendOp(GPicture::Verb, size_t payloadBytes, const GPaint* paint = nullptr);
+    void appendPath(GPicture::Verb, const GPath&, const GPaint* paint);
+    int addPaint(const GPaint&);
+};
+
+struct GPictureOptimizeStats {
+    int     fOpsRemoved = 0;
+    int     fDrawsRejected = 0;     // draws entirely outside the device or clip
+    int     fDrawsOccluded = 0;     // draws covered by a later opaque rect or paint
+    int     fStateOpsRemoved = 0;   // saves, saveLayers, restores, concats and clips
+    int64_t fPixelsRemoved = 0;     // device pixels the occluded draws would have touched
+};
+
+/**
+ *  Return an equivalent picture, when played back with an identity CTM into a device of the given
+ *  size, with redundant work removed:
+ *      - draws whose device bounds fall outside the device or the clip
+ *      - draws on the root layer that are fully covered by a later opaque Src/SrcOver rect
+ *        (or drawPaint), where only rect clips are in effect
+ *      - identity concats, and concats or clips that no draw sees before the next restore
+ *      - save/restore pairs that contain no draws, or that change neither the CTM nor the clip
+ *      - a restore immediately followed by a save that re-applies the same concats
+ *  If stats is not null, it is filled out with what was removed.
+ */
+std::unique_ptr<GPicture> GOptimizePicture(const GPicture&, GISize deviceSize,
+                                           GPictureOptimizeStats* stats = nullptr);
+
+#endif
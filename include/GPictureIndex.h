@@ -0,0 +1,90 @@
+#ifndef GPictureIndex_DEFINED
+#define GPictureIndex_DEFINED
+
+#include <vector>
+#include "GBitmap.h"
+#include "GPicture.h"
+#include "GRect.h"
+
+/**
+ *  A uniform grid over the device pixels each draw op of a picture may touch, when the picture is
+ *  played back with an identity CTM into a device of a given size. It answers "which ops must be
+ *  replayed to redraw this area?" in time proportional to the answer, not to the picture.
+ *
+ *  Draws that can't be bounded (drawPaint, and any draw inside a saveLayer, since the layer may
+ *  be composited anywhere) are treated as covering the whole device, less what is clipped out.
+ *  Draws that cover many cells are kept in a separate list and tested directly, so one huge
+ *  draw doesn't fill every cell.
+ */
+class GPictureIndex {
+public:
+    /**
+     *  Index the picture, which must outlive the index.
+     */
+    GPictureIndex(const GPicture& picture, GISize deviceSize, int cellSize = 64);
+
+    const GPicture& picture() const { return fPicture; }
+    GISize deviceSize() const { return fDeviceSize; }
+
+    /**
+     *  Set drawOps to the indices (in increasing order) of every draw op that may touch a pixel
+     *  inside area.
+     */
+    void query(const GIRect& area, std::vector<int>* drawOps) const;
+
+    /**
+     *  Set ops to the smallest subsequence of the picture (in increasing order) that draws the
+     *  given draw ops (increasing, e.g. from query()) exactly as the whole picture does: the
+     *  draws, the saves/saveLayers enclosing them with their restores, and the concats and clips
+     *  in effect at each of them. saveLayers whose composite can change pixels even when nothing
+     *  is drawn in them are always included.
+     */
+    void resolve(const std::vector<int>& drawOps, std::vector<int>* ops) const;
+
+    /**
+     *  Replay resolve(drawOps) into the canvas. Saves left open are restored, as in
+     *  GPicture::playback(). Pixels inside the area that drawOps came from are then exactly what
+     *  a full playback would produce there. shaders, if not null, is passed to
+     *  GPicture::playbackOp().
+     */
+    void playback(GCanvas*, const std::vector<int>& drawOps,
+                  const GPicture::ShaderMap* shaders = nullptr) const;
+
+private:
+    const GPicture&     fPicture;
+    const GISize        fDeviceSize;
+    const int           fCellSize;
+    int                 fCellsX, fCellsY;
+
+    std::vector<GIRect> fTouched;       // per op: device pixels it may touch (empty for state ops)
+    std::vector<int>    fParent;        // per op: the save/saveLayer enclosing it, or -1
+    std::vector<int>    fPrevConcat;    // per op: last earlier concat or clip at its level, or -1
+    std::vector<int>    fMatch;         // save <-> its restore, or -1
+    std::vector<int>    fForcedLayers;  // saveLayers that change pixels even when empty
+    std::vector<int>    fLargeOps;      // draws spanning too many cells to store per cell
+    std::vector<int>    fCellStart;     // fCellOps[fCellStart[c] .. fCellStart[c + 1]) for cell c
+    std::vector<int>    fCellOps;
+};
+
+/**
+ *  Play the picture back into device, split into tileSize x tileSize tiles shared out across
+ *  threadCount threads (0 means one per hardware thread). Each tile is drawn by a canvas clipped
+ *  to it, replaying only the ops the index says may touch it, so the result is bit-for-bit the
+ *  same as GPicture::playback(GCreateCanvas(device)).
+ *
+ *  The index must have been built for the device's size. Shaders keep per-draw state, so each
+ *  extra thread draws with its own GShader::clone() of every shader; if any can't be cloned,
+ *  the tiles are all drawn on the calling thread.
+ */
+void GPlaybackTiled(const GPictureIndex&, const GBitmap& device, int tileSize = 256,
+                    int threadCount = 0);
+
+/**
+ *  Redraw just the given area of device: fill it with background (replacing what was there),
+ *  then replay the ops that may touch it into a canvas clipped to it. Pixels outside the area
+ *  are not touched. The index must have been built for the device's size.
+ */
+void GPlaybackArea(const GPictureIndex&, const GBitmap& device, const GIRect& area,
+                   const GColor& background);
+
+#endif
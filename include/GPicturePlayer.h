@@ -0,0 +1,59 @@
+#ifndef GPicturePlayer_DEFINED
+#define GPicturePlayer_DEFINED
+
+#include <vector>
+#include "GBitmap.h"
+#include "GPicture.h"
+
+/**
+ *  Renders prefixes of a picture (ops [0, n)) repeatedly, e.g. while scrubbing through a scene
+ *  or re-rendering after an edit near its end.
+ *
+ *  While playing forward, the player snapshots the device pixels, plus the save/concat ops that
+ *  are still in effect, every few ops (whenever no layer is open). A later request for any prefix
+ *  resumes from the nearest snapshot at or before it, instead of replaying from op 0.
+ *
+ *  Snapshots are kept within a memory budget: when it is exceeded, every other snapshot is
+ *  dropped and the snapshot interval doubles, so coverage stays even across the picture.
+ */
+class GPicturePlayer {
+public:
+    GPicturePlayer(const GPicture* picture, int interval = 64, size_t budgetBytes = 64 << 20);
+
+    /**
+     *  Set the pixels that op 0 draws on top of, discarding all snapshots. The base must have
+     *  the same dimensions as the bitmaps later passed to draw().
+     */
+    void reset(const GBitmap& base);
+
+    /**
+     *  Set device's pixels to the base, with ops [0, opCount) of the picture played back on top,
+     *  exactly as GPicture::playback(canvas, 0, opCount) would. Does nothing if reset() has not
+     *  been called, or device's dimensions do not match the base.
+     */
+    void draw(const GBitmap& device, int opCount);
+
+    int countSnapshots() const { return (int)fSnapshots.size(); }
+    int interval() const { return fInterval; }
+    size_t bytesUsed() const { return fBytesUsed; }
+
+private:
+    struct Snapshot {
+        int                 fOp;        // ops [0, fOp) are drawn into fPixels
+        std::vector<GPixel> fPixels;
+        std::vector<int>    fStateOps;  // saves, concats and clips still in effect at fOp
+    };
+
+    const GPicture*         fPicture;
+    int                     fInterval;
+    const size_t            fBudget;
+    int                     fWidth = 0;
+    int                     fHeight = 0;
+    size_t                  fBytesUsed = 0;
+    std::vector<Snapshot>   fSnapshots;     // sorted by fOp, [0] is the base
+
+    void addSnapshot(const GBitmap& device, int op, const std::vector<int>& stateOps);
+    void thinSnapshots();
+};
+
+#endif
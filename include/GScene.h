@@ -0,0 +1,139 @@
+#ifndef GScene_DEFINED
+#define GScene_DEFINED
+
+#include <memory>
+#include <vector>
+#include "GPicture.h"
+
+/**
+ *  A recorded scene in a flat binary form that can be memory-mapped and played back in place.
+ *
+ *  Layout (host byte order, every section 4-byte aligned, offsets from file start). Values are
+ *  written as they sit in memory, so a scene only reads back on a host of the same endianness;
+ *  elsewhere the magic doesn't match and it is rejected:
+ *
+ *      Header          magic, version, section offsets and counts
+ *      Op stream       fOpCount fixed-size Op records
+ *      Point pool      fPointCount GPoints (rect corners, matrices, polygons and path points)
+ *      Color pool      fColorCount GColors (one per distinct paint color)
+ *      Verb pool       fVerbCount path verbs, one byte each
+ *
+ *  Ops only refer to ranges of the pools, so playback reads the mapped bytes directly: it never
+ *  parses or allocates per op (paths are rebuilt into a scratch GPath that keeps its storage).
+ *  Every range is validated once, when the scene is created.
+ *
+ *  Only paints made of a color and blend mode can be stored; pictures whose paints use a shader
+ *  or filter, or that draw meshes, cannot be encoded.
+ */
+class GScene {
+public:
+    enum {
+        kMagic   = 0x4E435347,  // "GSCN"
+        kVersion = 2,       // 2 added the clip verbs; version 1 scenes can still be read
+    };
+
+    enum Verb {
+        kSave,
+        kSaveLayer,         // paint; optional bounds at fPoint (2 points: left-top, right-bottom)
+        kRestore,
+        kConcat,            // matrix at fPoint (3 points: SX KX, TX KY, SY TY)
+        kDrawPaint,         // paint
+        kDrawRect,          // paint; rect at fPoint (2 points)
+        kDrawConvexPolygon, // paint; fPointCount points at fPoint
+        kDrawPath,          // paint; fPointCount points at fPoint, fVerbCount verbs at fVerbStart
+        kClipRect,          // rect at fPoint (2 points)
+        kClipPath,          // as kDrawPath, without the paint
+    };
+
+    enum {
+        kHasBounds_Flag = 1 << 0,
+    };
+
+    struct Header {
+        uint32_t fMagic;
+        uint16_t fVersion;
+        uint16_t fHeaderSize;
+        uint32_t fOpCount,    fOpOffset;
+        uint32_t fPointCount, fPointOffset;
+        uint32_t fColorCount, fColorOffset;
+        uint32_t fVerbCount,  fVerbOffset;
+    };
+
+    struct Op {
+        uint8_t  fVerb;
+        uint8_t  fBlendMode;
+        uint16_t fFlags;
+        uint32_t fColor;        // index into the color pool
+        uint32_t fPoint;        // index of the first point in the point pool
+        uint32_t fPointCount;
+        uint32_t fVerbStart;    // index of the first verb in the verb pool
+        uint32_t fVerbCount;
+
+        Verb verb() const { return (Verb)fVerb; }
+    };
+
+    /**
+     *  Wrap scene bytes that the caller owns (e.g. a mapping it made itself) and must keep alive
+     *  for the life of the scene. data must be 4-byte aligned. Returns null if the bytes are not
+     *  a valid scene of this (or an earlier) version.
+     */
+    static std::unique_ptr<GScene> MakeFromData(const void* data, size_t length);
+
+    /**
+     *  Memory-map the file at path (read-only) and wrap it. The mapping is released when the
+     *  scene is deleted. Returns null if the file can't be mapped or is not a valid scene.
+     */
+    static std::unique_ptr<GScene> MakeFromFile(const char path[]);
+
+    /**
+     *  Serialize the picture, replacing the contents of dst. Returns false (and leaves dst empty)
+     *  if any of its paints use a shader or filter, or it draws a mesh.
+     */
+    static bool Encode(const GPicture&, std::vector<uint8_t>* dst);
+
+    /**
+     *  Serialize the picture into a new file at path. Returns false if it can't be encoded or
+     *  the file can't be written.
+     */
+    static bool WriteFile(const GPicture&, const char path[]);
+
+    ~GScene();
+
+    int countOps() const { return (int)fHeader->fOpCount; }
+    const Op& op(int index) const {
+        GASSERT(index >= 0 && index < this->countOps());
+        return fOps[index];
+    }
+
+    /**
+     *  Replay every op into the canvas, leaving it in the state it was passed in.
+     */
+    void playback(GCanvas* canvas) const {
+        GPath scratch;
+        this->playback(canvas, &scratch);
+    }
+
+    /**
+     *  As above, but rebuilds paths into scratch. Callers drawing many scenes (or the same scene
+     *  many times) should pass the same GPath each time, so playback does not allocate once it
+     *  has grown to fit the largest path.
+     */
+    void playback(GCanvas*, GPath* scratch) const;
+
+private:
+    GScene(const void* data, size_t length, bool mapped);
+
+    bool validate() const;
+    void rebuildPath(const Op&, GPath*) const;
+
+    const void*     fData;
+    size_t          fLength;
+    bool            fMapped;
+    const Header*   fHeader;
+    const Op*       fOps;
+    const GPoint*   fPoints;
+    const GColor*   fColors;
+    const uint8_t*  fVerbs;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef GSceneParser_DEFINED
+#define GSceneParser_DEFINED
+
+#include <vector>
+#include "GCanvas.h"
+#include "GPaint.h"
+#include "GPath.h"
+
+/**
+ *  Streaming parser for the .475 scene language (e.g. apps/cartman.475): a sequence of
+ *  ';'-terminated statements, each one a call (or chain of calls) on one of three objects:
+ *
+ *      canvas->save()  restore()  translate(x, y)  scale(x, y)  rotate(r)
+ *              concat(GMatrix(a, b, c, d, e, f))  saveLayer(paint)  clear({a, r, g, b})
+ *              drawPaint(paint)  drawPath(path, paint)  drawRect(<rect>, paint)
+ *              fillRect(<rect>, {a, r, g, b})  clipRect(<rect>)  clipPath(path)
+ *      paint.setColor({a, r, g, b})  .setAlpha(a)  .setBlendMode(GBlendMode::kSrcOver)
+ *      path.reset()  .moveTo(x, y)  .lineTo(x, y)  .quadTo(x1, y1, x2, y2)
+ *           .cubicTo(x1, y1, x2, y2, x3, y3)
+ *
+ *  where <rect> is GRect::MakeLTRB(l, t, r, b) or GRect::MakeXYWH(x, y, w, h). Comments (// and
+ *  block) are skipped. Each statement is executed on the canvas as soon as its ';' arrives.
+ *
+ *  The parser owns the one paint and one path the language refers to, and reuses them (and its
+ *  buffer for statements split across write() calls), so once those have grown to fit the
+ *  largest path and statement, parsing does not allocate.
+ *
+ *  To convert text into the binary scene format, parse into a GRecordingCanvas and pass the
+ *  resulting picture to GScene::Encode().
+ */
+class GSceneParser {
+public:
+    explicit GSceneParser(GCanvas* canvas) { this->reset(canvas); }
+
+    /**
+     *  Start over with a new canvas: forgets any partial statement, error, and the current paint
+     *  and path (which go back to their default values).
+     */
+    void reset(GCanvas*);
+
+    /**
+     *  Feed the next length bytes of text, executing every statement they complete. Statements
+     *  may be split across calls. Returns false if the text has a syntax error (now or on an
+     *  earlier call); nothing after the error is executed.
+     */
+    bool write(const char text[], size_t length);
+
+    /**
+     *  Signal the end of the text. Fails if it ends inside a statement. Any saves the text left
+     *  open are restored, so the canvas is back in the state it was in before parsing.
+     */
+    bool finish();
+
+    /**
+     *  Parse a complete text: write() followed by finish().
+     */
+    bool parse(const char text[], size_t length) {
+        return this->write(text, length) && this->finish();
+    }
+
+    /**
+     *  Parse a complete file, streaming it through a fixed-size buffer.
+     */
+    bool parseFile(const char path[]);
+
+    /**
+     *  After a failure, the 1-based line of the offending statement and a description.
+     */
+    int errorLine() const { return fErrorLine; }
+    const char* errorMessage() const { return fError; }
+
+private:
+    enum State {
+        kCode,
+        kSlash,         // saw '/', may start a comment
+        kLineComment,
+        kBlockComment,
+        kBlockStar,     // saw '*' inside a block comment
+    };
+
+    GCanvas*            fCanvas;
+    GPaint              fPaint;
+    GPath               fPath;
+    std::vector<char>   fPending;       // start of a statement not yet terminated
+    State               fState;
+    int                 fLine;
+    int                 fStatementLine; // line of the first code in the current statement, or 0
+    int                 fSaveDepth;
+    int                 fErrorLine;
+    char                fError[96];
+
+    struct Cursor;
+
+    bool execute(const char* text, const char* end);
+    bool canvasCall(Cursor*);
+    bool paintCall(Cursor*);
+    bool pathCall(Cursor*);
+    bool fail(const char msg[]);
+};
+
+#endif
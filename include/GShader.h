@@ -38,6 +38,12 @@ public:
      *  can hold at least [count] entries.
      */
     virtual void shadeRow(int x, int y, int count, GPixel row[]) = 0;
+
+    /**
+     *  Return a copy with its own context, so it can shade on another thread while this shader
+     *  is in use. Shaders that can't be copied return nullptr.
+     */
+    virtual std::unique_ptr<GShader> clone() const { return nullptr; }
 };
 
 /**
@@ -0,0 +1,46 @@
+#ifndef GStats_DEFINED
+#define GStats_DEFINED
+
+#include <stdint.h>
+
+/**
+ *  What the raster canvas did to draw: counts, and the time spent in each stage of its pipeline
+ *  (in nanoseconds).
+ *
+ *  Counting costs time, so it is compiled in only when the library is built with G_STATS
+ *  defined (e.g. make bench CC="g++ -DG_STATS"). Otherwise the counters are compiled out and
+ *  GCanvas::getStats() returns false.
+ */
+struct GStats {
+    int64_t fDraws = 0;             // draw calls (a call made inside another isn't counted)
+    int64_t fEdges = 0;             // edges built from clipped polygons and paths
+    int64_t fSpans = 0;             // rows handed to the blitter
+    int64_t fPixelsBlended = 0;     // pixels written, in spans and anti-aliased edges
+    int64_t fPixelsShaded = 0;      // pixels computed by shaders (whole spans, before clipping)
+    int64_t fLayers = 0;            // saveLayers that allocated a layer
+    int64_t fLayerBytes = 0;        // bytes of those layers
+
+    int64_t fEdgeNS = 0;            // clipping edges and flattening curves
+    int64_t fSortNS = 0;            // sorting edges before scanning
+    int64_t fShadeNS = 0;           // shaders and paint filters
+    int64_t fBlendNS = 0;           // blending spans into the layer
+    int64_t fCompositeNS = 0;       // drawing layers down when they are restored
+
+    GStats& operator+=(const GStats& o) {
+        fDraws += o.fDraws;
+        fEdges += o.fEdges;
+        fSpans += o.fSpans;
+        fPixelsBlended += o.fPixelsBlended;
+        fPixelsShaded += o.fPixelsShaded;
+        fLayers += o.fLayers;
+        fLayerBytes += o.fLayerBytes;
+        fEdgeNS += o.fEdgeNS;
+        fSortNS += o.fSortNS;
+        fShadeNS += o.fShadeNS;
+        fBlendNS += o.fBlendNS;
+        fCompositeNS += o.fCompositeNS;
+        return *this;
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef GStroker_DEFINED
+#define GStroker_DEFINED
+
+#include <vector>
+#include "GPath.h"
+
+/**
+ *  Turns the contours of a path into the outline of their stroke: a path that, filled with
+ *  drawPath() (non-zero winding), covers every point within width/2 of them, shaped at corners
+ *  by the join and at open ends by the cap.
+ *
+ *  GPath has no close verb, so a contour whose last point equals its first is stroked closed
+ *  (joined where it meets itself); every other contour is open and gets a cap at each end.
+ *
+ *  Quads and cubics are offset directly, each as a few curves of the same kind, subdivided until
+ *  they are within kTolerance of the true offset (in the path's units, so stroke paths in about
+ *  device scale, or transform them first). Nothing is flattened.
+ *
+ *  A stroker keeps its working storage between calls, so reusing one (and the destination path)
+ *  avoids allocating per segment or per path.
+ */
+class GStroker {
+public:
+    enum Join {
+        kMiter_Join,    // extend the outer edges until they meet, up to the miter limit
+        kRound_Join,    // a circular arc of radius width/2 around the corner
+        kBevel_Join,    // cut the corner with a straight line
+    };
+
+    enum Cap {
+        kButt_Cap,      // square, at the end point
+        kRound_Cap,     // a half circle of radius width/2 past the end point
+        kSquare_Cap,    // square, width/2 past the end point
+    };
+
+    static constexpr float kTolerance = 0.1f;
+
+    /**
+     *  miterLimit bounds a miter join's length, as a multiple of width/2. Corners sharper than
+     *  that are beveled instead.
+     */
+    GStroker(float width, Join join = kMiter_Join, Cap cap = kButt_Cap, float miterLimit = 4)
+        : fRadius(width * 0.5f), fJoin(join), fCap(cap), fMiterLimit(miterLimit) {}
+
+    /**
+     *  Append the outline of src's stroke to dst (which is not reset first). A width of 0 or
+     *  less strokes nothing.
+     */
+    void strokePath(const GPath& src, GPath* dst);
+
+    /**
+     *  Append the outline of the line p0..p1 to dst, mitered, with round or butt caps. This is
+     *  the geometry GCanvas::final_addStrokedLine builds on every canvas.
+     */
+    static void StrokeLine(GPoint p0, GPoint p1, float width, bool roundCap, GPath* dst);
+
+private:
+    // One side of the stroke: a contour being built, kept as verbs and points so the right side
+    // can be appended to the destination backwards.
+    struct Side {
+        std::vector<GPath::Verb> fVerbs;    // kLine, kQuad or kCubic after the start point
+        std::vector<GPoint>      fPts;      // fPts[0] is the start point
+
+        void reset(GPoint start);
+        void lineTo(GPoint p);
+        void quadTo(GPoint p1, GPoint p2);
+        void cubicTo(GPoint p1, GPoint p2, GPoint p3);
+        GPoint last() const { return fPts.back(); }
+
+        void appendForward(GPath* dst, bool moveTo) const;
+        void appendBackward(GPath* dst, bool moveTo) const;
+    };
+
+    float fRadius;
+    Join  fJoin;
+    Cap   fCap;
+    float fMiterLimit;
+
+    Side    fLeft, fRight;          // offset by +radius and -radius along the normal
+    bool    fStarted;               // the contour has a segment that isn't a point
+    bool    fHasSegment;            // the contour has any segment at all
+    GPoint  fFirstPt, fPrevPt;
+    GVector fFirstNormal, fPrevNormal;  // unit normals where the contour starts and is now
+
+    void finishContour(GPath* dst);
+    void lineTo(GPoint p);
+    void quadTo(const GPoint pts[3]);
+    void cubicTo(const GPoint pts[4]);
+    void startSegment(GPoint p, GVector normal);
+    void join(GPoint pivot, GVector before, GVector after);
+    void offsetQuad(const GPoint pts[3], int depth);
+    void offsetCubic(const GPoint pts[4], int depth);
+};
+
+#endif
@@ -10,10 +10,17 @@
 #include "GTypes.h"
 
 typedef unsigned long GMSec;
+typedef long long GNSec;
 
 class GTime {
 public:
     static GMSec GetMSec();
+
+    /**
+     *  Nanoseconds from a monotonic clock (std::chrono::steady_clock), for timing intervals.
+     *  Only differences between two calls are meaningful.
+     */
+    static GNSec GetNSec();
 };
 
 #endif
@@ -0,0 +1,56 @@
+#ifndef GTrace_DEFINED
+#define GTrace_DEFINED
+
+#include <stdint.h>
+
+/**
+ *  Timeline tracing, for viewing a frame in chrome://tracing or Perfetto.
+ *
+ *  Scopes marked with G_TRACE_EVENT(category, name) record their start and duration (names are
+ *  string literals, kept by pointer). Each thread records into its own ring buffer of the last
+ *  kEventsPerThread events, without locks; GTrace::WriteJSON() dumps every thread's buffer.
+ *
+ *  Tracing is compiled in only when the library is built with G_TRACE defined (e.g.
+ *  make image CC="g++ -DG_TRACE"). Otherwise G_TRACE_EVENT expands to nothing and WriteJSON()
+ *  returns false.
+ */
+class GTrace {
+public:
+    static constexpr int kEventsPerThread = 1 << 16;
+
+    /**
+     *  Write the recorded events as Chrome trace JSON ("traceEvents" of complete events, times
+     *  in microseconds). Threads should not be recording while this runs.
+     */
+    static bool WriteJSON(const char path[]);
+
+    /**
+     *  Forget every thread's recorded events.
+     */
+    static void Reset();
+
+    /**
+     *  Records one event from its construction to its destruction. Use G_TRACE_EVENT.
+     */
+    class Scope {
+    public:
+        Scope(const char* category, const char* name);
+        ~Scope();
+
+    private:
+        const char* fCategory;
+        const char* fName;
+        int64_t     fStart;
+    };
+};
+
+#ifdef G_TRACE
+    #define G_TRACE_CONCAT_(a, b)           a##b
+    #define G_TRACE_CONCAT(a, b)            G_TRACE_CONCAT_(a, b)
+    #define G_TRACE_EVENT(category, name) \
+        GTrace::Scope G_TRACE_CONCAT(traceScope, __LINE__)(category, name)
+#else
+    #define G_TRACE_EVENT(category, name)
+#endif
+
+#endif
@@ -3,6 +3,7 @@
 #include "GPaint.h"
 #include "GBitmap.h"
 #include "blend.h"
+#include "deviceClip.h"
 
 /*
  * Layer for layer stack
@@ -13,7 +14,7 @@ struct Layer {
     GPaint  paint;
 
     Layer(GBitmap bitmap, GPoint translation, GPaint paint);
-    void drawLayer(Layer topLayer);
+    void drawLayer(Layer topLayer, const DeviceClip& clip);
 };
 
 Layer::Layer(GBitmap bitmap, GPoint translation, GPaint paint) {
@@ -22,7 +23,11 @@ Layer::Layer(GBitmap bitmap, GPoint translation, GPaint paint) {
   this->paint = paint;
 }
 
-void Layer::drawLayer(Layer topLayer) {
+/*
+ * Composite onto topLayer, only touching the pixels that land inside clip (device coordinates)
+ */
+void Layer::drawLayer(Layer topLayer, const DeviceClip& deviceClip) {
+    const GIRect& clip = deviceClip.fBounds;
     GBitmap dstLayer    = topLayer.bitmap;
     GBitmap bmap        = this->bitmap;
     GPoint  translation = this->translation;
@@ -31,18 +36,33 @@ void Layer::drawLayer(Layer topLayer) {
     //Get paint info
     Blend blend = getBlend(paint.getBlendMode());
     GFilter* filter = paint.getFilter();
-    int count = bmap.width();
 
-    for(int y = 0; y < bmap.height(); ++y){
+    //Translations are device positions: layer pixel (x, y) lands on device pixel
+    //(x, y) + translation, which is (x, y) + translation - topLayer.translation in topLayer
+    int dx = GRoundToInt(translation.x());
+    int dy = GRoundToInt(translation.y());
+    int toX = dx - GRoundToInt(topLayer.translation.x());
+    int toY = dy - GRoundToInt(topLayer.translation.y());
+    int left   = std::max({ 0, clip.left() - dx, -toX });
+    int right  = std::min({ bmap.width(), clip.right() - dx, dstLayer.width() - toX });
+    int top    = std::max({ 0, clip.top() - dy, -toY });
+    int bottom = std::min({ bmap.height(), clip.bottom() - dy, dstLayer.height() - toY });
+
+    for(int y = top; y < bottom; ++y){
+          const uint8_t* coverage = deviceClip.row(y + dy);
+          const int maskX = dx - deviceClip.fMaskBounds.left();
           //Blend and fill row memory using filter and blendmode
-          for (int x = 0; x < count; ++x) {
+          for (int x = left; x < right; ++x) {
+                if (coverage && !coverage[x + maskX]) {
+                    continue;
+                }
                 GPixel* addr = bmap.getAddr(x, y);
                 int r = GPixel_GetR(*addr);
                 int b = GPixel_GetB(*addr);
                 if(filter){
                     filter->filter(addr, addr, 1);
                 }
-                GPixel* otheraddr = dstLayer.getAddr(x + translation.x(), y + translation.y());
+                GPixel* otheraddr = dstLayer.getAddr(x + toX, y + toY);
                 *otheraddr = blend(*addr, *otheraddr);
           }
     }
@@ -0,0 +1,209 @@
+#include "GMath.h"
+#include "GPoint.h"
+#include "GRect.h"
+#include <algorithm>
+#include <cmath>
+
+#ifndef LINE_H
+#define LINE_H
+/*
+ * Hairlines: one pixel per step along the line's major axis, found by stepping the minor
+ * coordinate with a DDA (the floating point form of Bresenham), or two pixels per step sharing
+ * the coverage (Wu) when anti-aliased. Pixels are visited straight from the line, no edges.
+ *
+ * A step is taken at each pixel center along the major axis from p0 (included) to p1 (left
+ * out), so lines joined end to start don't visit their shared point twice.
+ */
+
+/*
+ * Clip the segment to bounds (Liang-Barsky). Returns false if none of it is inside, or it is
+ * not finite.
+ */
+static bool clipSegment(GPoint* p0, GPoint* p1, const GRect& bounds) {
+    if (!std::isfinite(p0->x()) || !std::isfinite(p0->y()) ||
+        !std::isfinite(p1->x()) || !std::isfinite(p1->y())) {
+        return false;
+    }
+    const float dx = p1->x() - p0->x(), dy = p1->y() - p0->y();
+    const float p[4] = { -dx, dx, -dy, dy };
+    const float q[4] = { p0->x() - bounds.left(), bounds.right() - p0->x(),
+                         p0->y() - bounds.top(), bounds.bottom() - p0->y() };
+    float t0 = 0, t1 = 1;
+    for (int k = 0; k < 4; ++k) {
+        if (p[k] == 0) {
+            if (q[k] < 0) {
+                return false;
+            }
+        } else if (p[k] < 0) {
+            t0 = std::max(t0, q[k] / p[k]);
+        } else {
+            t1 = std::min(t1, q[k] / p[k]);
+        }
+    }
+    if (t0 > t1) {
+        return false;
+    }
+    const GPoint start = *p0;
+    *p0 = { start.x() + t0 * dx, start.y() + t0 * dy };
+    *p1 = { start.x() + t1 * dx, start.y() + t1 * dy };
+    return true;
+}
+
+static bool isXMajor(GPoint p0, GPoint p1) {
+    return fabsf(p1.x() - p0.x()) >= fabsf(p1.y() - p0.y());
+}
+
+/*
+ * Call step(i, v) for each pixel center i + 0.5 along the major axis (x if the line is at least
+ * as wide as it is tall, else y), where v is the minor coordinate of the line there.
+ */
+template <typename Step> void walkHairline(GPoint p0, GPoint p1, const GIRect& area, Step step) {
+    const bool xMajor = isXMajor(p0, p1);
+    // Clipping just outside area moves only endpoints that are off it anyway
+    if (!clipSegment(&p0, &p1, GRect::MakeLTRB(area.left() - 1, area.top() - 1,
+                                               area.right() + 1, area.bottom() + 1))) {
+        return;
+    }
+    const float dx = p1.x() - p0.x(), dy = p1.y() - p0.y();
+    if (dx == 0 && dy == 0) {
+        return;
+    }
+    const float u0 = xMajor ? p0.x() : p0.y(), u1 = xMajor ? p1.x() : p1.y();
+    const float v0 = xMajor ? p0.y() : p0.x();
+    const float slope = xMajor ? dy / dx : dx / dy;
+    int first, end, dir;
+    if (u1 > u0) {
+        first = (int)ceilf(u0 - 0.5f);
+        end = (int)ceilf(u1 - 0.5f);
+        dir = 1;
+    } else {
+        first = (int)floorf(u0 - 0.5f);
+        end = (int)floorf(u1 - 0.5f);
+        dir = -1;
+    }
+    for (int i = first; i != end; i += dir) {
+        step(i, v0 + (i + 0.5f - u0) * slope);
+    }
+}
+
+/*
+ * Call run(left, right, y) for the pixels of the hairline inside area, merging neighbours on
+ * the same row into one run.
+ */
+template <typename Run> void scanHairline(GPoint p0, GPoint p1, const GIRect& area, Run run) {
+    int runL = 0, runR = 0, runY = 0;
+    auto flush = [&]() {
+        if (runL < runR) {
+            run(runL, runR, runY);
+        }
+        runL = runR = 0;
+    };
+    const bool xMajor = isXMajor(p0, p1);
+    walkHairline(p0, p1, area, [&](int i, float v) {
+        const int j = (int)floorf(v);
+        const int x = xMajor ? i : j, y = xMajor ? j : i;
+        if (!area.contains(x, y)) {
+            flush();
+            return;
+        }
+        if (runL < runR && y == runY && (x == runR || x == runL - 1)) {
+            runL = std::min(runL, x);
+            runR = std::max(runR, x + 1);
+            return;
+        }
+        flush();
+        runL = x;
+        runR = x + 1;
+        runY = y;
+    });
+    flush();
+}
+
+/*
+ * The anti-aliased version: each step splits its coverage between the two pixels nearest the
+ * line across it, calling pixel(x, y, coverage) with coverage in [1, 255].
+ */
+template <typename Pixel> void scanHairlineAA(GPoint p0, GPoint p1, const GIRect& area,
+                                              Pixel pixel) {
+    const bool xMajor = isXMajor(p0, p1);
+    walkHairline(p0, p1, area, [&](int i, float v) {
+        const float center = v - 0.5f;
+        const int j = (int)floorf(center);
+        const int far = GRoundToInt((center - j) * 255);
+        const int coverage[2] = { 255 - far, far };
+        for (int k = 0; k < 2; ++k) {
+            const int x = xMajor ? i : j + k, y = xMajor ? j + k : i;
+            if (coverage[k] > 0 && area.contains(x, y)) {
+                pixel(x, y, coverage[k]);
+            }
+        }
+    });
+}
+
+/*
+ * ceilf() without the library call, which matters once per row. x must fit in an int.
+ */
+static inline int ceilToInt(float x) {
+    const int i = (int)x;
+    return i + (x > i);
+}
+
+/*
+ * Call run(left, right, y) for each row of pixels [left, right) inside area whose centers are in
+ * the parallelogram q + s * a + t * b, for s and t in [0, 1): a thin line's quad. s and t are
+ * linear in x, so each row's span is where both are in range, found without any edges.
+ */
+template <typename Run> void scanParallelogram(GPoint q, GVector a, GVector b,
+                                               const GIRect& area, Run run) {
+    const float det = a.fX * b.fY - a.fY * b.fX;
+    if (!(fabsf(det) > 0) || !std::isfinite(det) || !std::isfinite(q.x()) ||
+        !std::isfinite(q.y())) {
+        return;
+    }
+    float minY = std::min({ q.y(), q.y() + a.fY, q.y() + b.fY, q.y() + a.fY + b.fY });
+    float maxY = std::max({ q.y(), q.y() + a.fY, q.y() + b.fY, q.y() + a.fY + b.fY });
+    minY = std::max(minY, area.top() - 1.0f);
+    maxY = std::min(maxY, area.bottom() + 1.0f);
+    const int top = std::max(area.top(), (int)ceilf(minY - 0.5f));
+    const int bottom = std::min(area.bottom(), (int)ceilf(maxY - 0.5f));
+
+    // s and t at (0, y), and how they change per unit of x and y
+    const float dx[2] = { b.fY / det, -a.fY / det };
+    const float dy[2] = { -b.fX / det, a.fX / det };
+    const float px = -q.x(), py = top + 0.5f - q.y();
+    float v[2] = { (px * b.fY - py * b.fX) / det, (a.fX * py - a.fY * px) / det };
+
+    // Across each row, s (and t) is in range between two x bounds that move by step per row.
+    // If it doesn't depend on x, the whole row is in or out instead.
+    float lo[2], hi[2], step[2];
+    for (int k = 0; k < 2; ++k) {
+        lo[k] = area.left() - 1.0f;
+        hi[k] = area.right() + 1.0f;
+        step[k] = 0;
+        if (dx[k] != 0) {
+            const float inv = 1 / dx[k], x0 = -v[k] * inv;
+            lo[k] = x0 + std::min(0.0f, inv);
+            hi[k] = x0 + std::max(0.0f, inv);
+            step[k] = -dy[k] * inv;
+        }
+    }
+    for (int y = top; y < bottom; ++y) {
+        const float L = std::max({ area.left() - 1.0f, lo[0], lo[1] });
+        float R = std::min({ area.right() + 1.0f, hi[0], hi[1] });
+        for (int k = 0; k < 2; ++k) {
+            if (dx[k] == 0 && !(v[k] >= 0 && v[k] < 1)) {
+                R = L;
+            }
+            v[k] += dy[k];
+            lo[k] += step[k];
+            hi[k] += step[k];
+        }
+        const int left = std::max(area.left(), ceilToInt(L - 0.5f));
+        const int right = std::min(area.right(), ceilToInt(R - 0.5f));
+        if (left < right) {
+            run(left, right, y);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,102 @@
+#include "GPoint.h"
+#include "GRect.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#ifndef MESH_H
+#define MESH_H
+/*
+ * Triangle scan conversion for drawMesh. Vertices are snapped to 1/256 of a pixel and the edge
+ * functions are evaluated exactly in 64-bit integers, so a pixel center lying on an edge shared
+ * by two triangles goes to exactly one of them (the top-left rule). A mesh therefore has no
+ * cracks between its triangles and blends no pixel twice.
+ */
+
+static const int kMeshSubpixels = 256;
+static const float kMeshMaxCoord = 1 << 21;    // keeps every edge product inside 64 bits
+
+static int64_t floorDiv(int64_t a, int64_t b) {    // b > 0
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static int64_t ceilDiv(int64_t a, int64_t b) {     // b > 0
+    return -floorDiv(-a, b);
+}
+
+/*
+ * Call span(left, right, y, w, dw) for each row of pixels [left, right) inside area whose
+ * centers are in the triangle pts (layer coordinates). w[k] is the barycentric weight of
+ * pts[k] at the center of pixel left, and dw[k] is how much it changes per pixel.
+ */
+template <typename Span> void scanTriangle(const GPoint pts[3], const GIRect& area, Span span) {
+    int64_t X[3], Y[3];
+    for (int k = 0; k < 3; ++k) {
+        // also rejects NaNs
+        if (!(fabsf(pts[k].x()) < kMeshMaxCoord && fabsf(pts[k].y()) < kMeshMaxCoord)) {
+            return;
+        }
+        X[k] = (int64_t)lrintf(pts[k].x() * kMeshSubpixels);
+        Y[k] = (int64_t)lrintf(pts[k].y() * kMeshSubpixels);
+    }
+    int64_t area2 = (X[1] - X[0]) * (Y[2] - Y[0]) - (Y[1] - Y[0]) * (X[2] - X[0]);
+    if (area2 == 0) {
+        return;
+    }
+    const int64_t sign = area2 > 0 ? 1 : -1;    // flip clockwise triangles so inside is positive
+    area2 *= sign;
+
+    // Edge k runs between the other two vertices: its function, relative to area2, is the
+    // weight of vertex k. rowE is its value at the center of pixel (0, y); it changes by stepX
+    // per pixel and stepY per row. A pixel is inside if rowE - bias >= 0 for every edge.
+    const int64_t half = kMeshSubpixels / 2;
+    int64_t rowE[3], stepX[3], stepY[3], bias[3];
+    const int top = std::max(area.top(), (int)ceilDiv(std::min({Y[0], Y[1], Y[2]}) - half,
+                                                      kMeshSubpixels));
+    const int bottom = std::min(area.bottom(), (int)floorDiv(std::max({Y[0], Y[1], Y[2]}) - half,
+                                                             kMeshSubpixels) + 1);
+    if (top >= bottom) {
+        return;
+    }
+    for (int k = 0; k < 3; ++k) {
+        const int a = (k + 1) % 3, b = (k + 2) % 3;
+        const int64_t dx = (X[b] - X[a]) * sign, dy = (Y[b] - Y[a]) * sign;
+        // pixels exactly on an edge belong to the triangle if it is a top or left edge
+        const bool topLeft = dy < 0 || (dy == 0 && dx > 0);
+        const int64_t py = (int64_t)top * kMeshSubpixels + half;
+        rowE[k] = dx * (py - Y[a]) - dy * (half - X[a]);
+        bias[k] = topLeft ? 0 : 1;
+        stepX[k] = -dy * kMeshSubpixels;
+        stepY[k] = dx * kMeshSubpixels;
+    }
+
+    float dw[3];
+    for (int k = 0; k < 3; ++k) {
+        dw[k] = (float)stepX[k] / area2;
+    }
+    for (int y = top; y < bottom; ++y) {
+        int64_t left = area.left(), right = area.right();
+        for (int k = 0; k < 3; ++k) {
+            const int64_t e = rowE[k] - bias[k];
+            if (stepX[k] > 0) {
+                left = std::max(left, ceilDiv(-e, stepX[k]));
+            } else if (stepX[k] < 0) {
+                right = std::min(right, floorDiv(e, -stepX[k]) + 1);
+            } else if (e < 0) {
+                right = left;
+            }
+        }
+        if (left < right) {
+            float w[3];
+            for (int k = 0; k < 3; ++k) {
+                w[k] = (float)(rowE[k] + stepX[k] * left) / area2;
+            }
+            span((int)left, (int)right, y, w, dw);
+        }
+        for (int k = 0; k < 3; ++k) {
+            rowE[k] += stepY[k];
+        }
+    }
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include "GMatrix.h"
 #include <vector>
 #include "math.h"
+#include <cmath>
 
 /*
  *  Adds 4 points to the path, traversing the rect in the specified direction, beginning
@@ -149,6 +150,76 @@ void GPath::ChopCubicAt(const GPoint src[4], GPoint dst[7], float t){
                         (pow(1-t, 3)*a.y() + 3*t*b.y()*pow(1-t, 2) + 3*(1-t)*c.y()*pow(t, 2) + d.y()*pow(t,3)));
 }
 
+/**
+ *  Walk the contour's points in order (control points included, then back to the start). It is
+ *  convex if every corner turns the same way, never doubling back, and the direction of travel
+ *  flips between left and right (and between up and down) only twice, so it goes around once.
+ */
+bool GPath::computeConvex() const {
+    const int count = (int)fPts.size();
+    if (count < 3 || fVbs[0] != kMove) {
+        return false;
+    }
+    for (size_t i = 1; i < fVbs.size(); ++i) {
+        if (fVbs[i] == kMove) {
+            return false;
+        }
+    }
+
+    GPoint prev = GPoint::Make(0, 0);
+    bool havePrev = false;
+    float turn = 0;
+    float lastDx = 0, lastDy = 0;   // last nonzero step in each direction
+    int xFlips = 0, yFlips = 0;
+    for (int i = 0; i <= count; ++i) {
+        GPoint p0 = fPts[i % count];
+        GPoint p1 = fPts[(i + 1) % count];
+        GPoint v = GPoint::Make(p1.fX - p0.fX, p1.fY - p0.fY);
+        if (v.fX == 0 && v.fY == 0) {
+            continue;
+        }
+        if (havePrev) {
+            float cross = prev.fX * v.fY - prev.fY * v.fX;
+            if (!std::isfinite(cross)) {
+                return false;
+            }
+            if (cross == 0) {
+                if (prev.fX * v.fX + prev.fY * v.fY < 0) {
+                    return false;
+                }
+            } else if (turn == 0) {
+                turn = cross;
+            } else if ((cross > 0) != (turn > 0)) {
+                return false;
+            }
+        }
+        if (v.fX != 0) {
+            xFlips += lastDx != 0 && (v.fX > 0) != (lastDx > 0);
+            lastDx = v.fX;
+        }
+        if (v.fY != 0) {
+            yFlips += lastDy != 0 && (v.fY > 0) != (lastDy > 0);
+            lastDy = v.fY;
+        }
+        prev = v;
+        havePrev = true;
+    }
+    return turn != 0 && xFlips <= 2 && yFlips <= 2;
+}
+
+/**
+ *  Threads drawing the same const path may race to fill in the cache, but they all compute the
+ *  same answer, so a relaxed atomic is enough.
+ */
+bool GPath::isConvex() const {
+    Convexity convexity = fConvexity.load(std::memory_order_relaxed);
+    if (convexity == kUnknown_Convexity) {
+        convexity = this->computeConvex() ? kConvex_Convexity : kConcave_Convexity;
+        fConvexity.store(convexity, std::memory_order_relaxed);
+    }
+    return convexity == kConvex_Convexity;
+}
+
 /**
  *  Transform the path in-place by the specified matrix.
  */
@@ -4,6 +4,9 @@
 #include "GPoint.h"
 #include "clip.h"
 
+#ifndef PATHEDGER_H
+#define PATHEDGER_H
+
 class GRect;
 
 static float vectorLength(float xLen, float yLen){
@@ -18,7 +21,7 @@ static float quad(float a, float b, float c, float t){
     return a*pow(1-t, 2) + 2*b*t*(1 - t) + c*pow(t, 2);
 }
 
-std::deque<Edge> clipPath(GPath path, GRect sides){
+static std::deque<Edge> clipPath(const GPath& path, const GRect& sides){
   std::deque<Edge> edges;
   GPoint pts[4];
   GPath::Edger iter = GPath::Edger(path);
@@ -63,3 +66,5 @@ std::deque<Edge> clipPath(GPath path, GRect sides){
   }
   return edges;
 }
+
+#endif
@@ -0,0 +1,18 @@
+#include "GFilter.h"
+#include "GPaint.h"
+
+#ifndef PICTURE_UTILS_H
+#define PICTURE_UTILS_H
+/*
+ * Helpers shared by the picture optimizer and the picture index.
+ */
+
+/*
+ *  Compositing an empty (transparent) layer with this paint leaves the dst unchanged.
+ */
+static inline bool empty_layer_is_noop(const GPaint& paint) {
+    return !paint.getFilter() && (paint.getBlendMode() == GBlendMode::kSrcOver ||
+                                  paint.getBlendMode() == GBlendMode::kDst);
+}
+
+#endif
@@ -0,0 +1,141 @@
+#include "GMath.h"
+#include "GRect.h"
+#include <algorithm>
+#include <cmath>
+
+#ifndef RRECT_H
+#define RRECT_H
+/*
+ * Round rects (and ovals, whose radii are half their size) scanned analytically: the span of
+ * each row comes straight from the ellipse of the corner it passes through, so no edges are
+ * ever built.
+ */
+
+static const int kRoundRectSamples = 4;     // rows sampled per pixel for anti-aliasing
+
+/*
+ * Sort rect, and pin the radii to [0, half its size] (NaN radii become 0).
+ */
+static GRect pinRoundRect(const GRect& rect, float* rx, float* ry) {
+    GRect r = GRect::MakeLTRB(std::min(rect.left(), rect.right()),
+                              std::min(rect.top(), rect.bottom()),
+                              std::max(rect.left(), rect.right()),
+                              std::max(rect.top(), rect.bottom()));
+    *rx = std::max(0.0f, std::min(*rx, r.width() * 0.5f));
+    *ry = std::max(0.0f, std::min(*ry, r.height() * 0.5f));
+    return r;
+}
+
+/*
+ * The extent [*left, *right] of the round rect along the horizontal line at y, or false if the
+ * line misses it. r and the radii must already be pinned.
+ */
+static bool roundRectSpan(const GRect& r, float rx, float ry, float y, float* left,
+                          float* right) {
+    if (!(y > r.top() && y < r.bottom())) {
+        return false;
+    }
+    float inset = 0;
+    float dy = std::max(r.top() + ry - y, y - (r.bottom() - ry));
+    if (dy > 0) {
+        dy /= ry;
+        inset = rx * (1 - sqrtf(std::max(0.0f, 1 - dy * dy)));
+    }
+    *left = r.left() + inset;
+    *right = r.right() - inset;
+    return true;
+}
+
+/*
+ * Coordinates are pinned to just outside area before rounding, so huge rects stay in range.
+ */
+static float pinToArea(float v, int min, int max) {
+    return std::min(std::max((float)min - 1, v), (float)max + 1);
+}
+
+/*
+ * Call span(left, right, y) for each row of pixels [left, right) inside area whose centers are
+ * in the round rect, which follows drawRect()'s rule: with radii of 0 it fills the same pixels.
+ */
+template <typename Span> void scanRoundRect(const GRect& r, float rx, float ry,
+                                            const GIRect& area, Span span) {
+    const int top = std::max(area.top(), GRoundToInt(pinToArea(r.top(), area.top(),
+                                                               area.bottom())));
+    const int bottom = std::min(area.bottom(), GRoundToInt(pinToArea(r.bottom(), area.top(),
+                                                                     area.bottom())));
+    for (int y = top; y < bottom; ++y) {
+        float L, R;
+        if (!roundRectSpan(r, rx, ry, y + 0.5f, &L, &R)) {
+            continue;
+        }
+        const int left = std::max(area.left(), GRoundToInt(pinToArea(L, area.left(),
+                                                                     area.right())));
+        const int right = std::min(area.right(), GRoundToInt(pinToArea(R, area.left(),
+                                                                       area.right())));
+        if (left < right) {
+            span(left, right, y);
+        }
+    }
+}
+
+/*
+ * The anti-aliased version: pixels the round rect fully covers go to span(left, right, y), and
+ * partly covered ones to pixel(x, y, coverage), coverage in [1, 255]. Coverage is exact across
+ * each row and sampled kRoundRectSamples times down it.
+ */
+template <typename Span, typename Pixel>
+void scanRoundRectAA(const GRect& r, float rx, float ry, const GIRect& area, Span span,
+                     Pixel pixel) {
+    const int top = std::max(area.top(), (int)floorf(pinToArea(r.top(), area.top(),
+                                                               area.bottom())));
+    const int bottom = std::min(area.bottom(), (int)ceilf(pinToArea(r.bottom(), area.top(),
+                                                                    area.bottom())));
+    for (int y = top; y < bottom; ++y) {
+        float L[kRoundRectSamples], R[kRoundRectSamples];
+        float minL = area.right() + 1.0f, maxL = area.left() - 1.0f;
+        float minR = area.right() + 1.0f, maxR = area.left() - 1.0f;
+        bool full = true;
+        for (int s = 0; s < kRoundRectSamples; ++s) {
+            if (!roundRectSpan(r, rx, ry, y + (s + 0.5f) / kRoundRectSamples, &L[s], &R[s])) {
+                L[s] = R[s] = 0;
+                full = false;
+                continue;
+            }
+            L[s] = pinToArea(L[s], area.left(), area.right());
+            R[s] = pinToArea(R[s], area.left(), area.right());
+            minL = std::min(minL, L[s]);
+            maxL = std::max(maxL, L[s]);
+            minR = std::min(minR, R[s]);
+            maxR = std::max(maxR, R[s]);
+        }
+        if (minL > maxR) {
+            continue;
+        }
+
+        // Pixels in [innerL, innerR) are covered in every sample
+        const int left = std::max(area.left(), (int)floorf(minL));
+        const int right = std::min(area.right(), (int)ceilf(maxR));
+        int innerL = std::max(left, (int)ceilf(maxL));
+        int innerR = std::min(right, (int)floorf(minR));
+        if (!full || innerL >= innerR) {
+            innerL = innerR = right;
+        }
+        for (int x = left; x < right; ++x) {
+            if (x == innerL) {
+                span(innerL, innerR, y);
+                x = innerR - 1;
+                continue;
+            }
+            float covered = 0;
+            for (int s = 0; s < kRoundRectSamples; ++s) {
+                covered += std::max(0.0f, std::min(R[s], x + 1.0f) - std::max(L[s], (float)x));
+            }
+            const int coverage = GRoundToInt(covered * 255 / kRoundRectSamples);
+            if (coverage > 0) {
+                pixel(x, y, std::min(coverage, 255));
+            }
+        }
+    }
+}
+
+#endif
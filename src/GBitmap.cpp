@@ -3,6 +3,7 @@
  */
 
 #include "GBitmap.h"
+#include "GTrace.h"
 #include <png.h>
 
 void GBitmap::setIsOpaque(IsOpaque io) {
@@ -97,6 +98,7 @@ static void convertToPNG(const GPixel src[], int width, char dst[]) {
 }
 
 bool GBitmap::writeToFile(const char path[]) const {
+    G_TRACE_EVENT("png", "encode");
     FILE* f = ::fopen(path, "wb");
     if (!f) {
         return false;
@@ -199,6 +201,7 @@ static bool always_false() {
 }
 
 bool GBitmap::readFromFile(const char path[]) {
+    G_TRACE_EVENT("png", "decode");
     this->reset();
 
     FILE* file = fopen(path, "rb");
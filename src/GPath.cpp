@@ -6,12 +6,18 @@
 #include "GMatrix.h"
 
 GPath::GPath() {}
+GPath::GPath(const GPath& src)
+    : fPts(src.fPts)
+    , fVbs(src.fVbs)
+    , fConvexity(src.fConvexity.load(std::memory_order_relaxed)) {}
 GPath::~GPath() {}
 
 GPath& GPath::operator=(const GPath& src) {
     if (this != &src) {
         fPts = src.fPts;
         fVbs = src.fVbs;
+        fConvexity.store(src.fConvexity.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
     }
     return *this;
 }
@@ -19,12 +25,14 @@ GPath& GPath::operator=(const GPath& src) {
 GPath& GPath::reset() {
     fPts.clear();
     fVbs.clear();
+    fConvexity.store(kUnknown_Convexity, std::memory_order_relaxed);
     return *this;
 }
 
 GPath& GPath::moveTo(GPoint p) {
     fPts.push_back(p);
     fVbs.push_back(kMove);
+    fConvexity.store(kUnknown_Convexity, std::memory_order_relaxed);
     return *this;
 }
 
@@ -32,6 +40,7 @@ GPath& GPath::lineTo(GPoint p) {
     GASSERT(fVbs.size() > 0);
     fPts.push_back(p);
     fVbs.push_back(kLine);
+    fConvexity.store(kUnknown_Convexity, std::memory_order_relaxed);
     return *this;
 }
 
@@ -40,6 +49,7 @@ GPath& GPath::quadTo(GPoint p1, GPoint p2) {
     fPts.push_back(p1);
     fPts.push_back(p2);
     fVbs.push_back(kQuad);
+    fConvexity.store(kUnknown_Convexity, std::memory_order_relaxed);
     return *this;
 }
 
@@ -49,6 +59,7 @@ GPath& GPath::cubicTo(GPoint p1, GPoint p2, GPoint p3) {
     fPts.push_back(p2);
     fPts.push_back(p3);
     fVbs.push_back(kCubic);
+    fConvexity.store(kUnknown_Convexity, std::memory_order_relaxed);
     return *this;
 }
 
@@ -0,0 +1,47 @@
+#include "GStats.h"
+#include <chrono>
+
+#ifndef STATS_H
+#define STATS_H
+/*
+ * Counting for GStats. With G_STATS undefined every macro expands to nothing, so the counters
+ * cost nothing (and the canvas carries no stats pointer).
+ *
+ *   G_STATS_CODE(code)                     code, only in stats builds
+ *   G_STATS_ADD(stats, fField, n)          stats->fField += n, if stats isn't null
+ *   G_STATS_TIME(stats, fFieldNS)          add the time until the end of the scope
+ */
+#ifdef G_STATS
+    #define G_STATS_CODE(code)              code
+    #define G_STATS_ADD(stats, field, n)    do { if (stats) (stats)->field += (n); } while (0)
+    #define G_STATS_CONCAT_(a, b)           a##b
+    #define G_STATS_CONCAT(a, b)            G_STATS_CONCAT_(a, b)
+    #define G_STATS_TIME(stats, field) \
+        StatsTimer G_STATS_CONCAT(statsTimer, __LINE__)((stats) ? &(stats)->field : nullptr)
+
+/*
+ * Adds the nanoseconds it was alive to *dst (if dst isn't null).
+ */
+struct StatsTimer {
+    int64_t* dst;
+    std::chrono::steady_clock::time_point start;
+
+    StatsTimer(int64_t* dst) : dst(dst) {
+        if (dst) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    ~StatsTimer() {
+        if (dst) {
+            *dst += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+        }
+    }
+};
+#else
+    #define G_STATS_CODE(code)
+    #define G_STATS_ADD(stats, field, n)
+    #define G_STATS_TIME(stats, field)
+#endif
+
+#endif